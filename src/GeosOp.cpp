@@ -15,6 +15,7 @@
 
 #include "GeosOp.h"
 
+#include <cmath>
 #include <cstdio>
 #include <string>
 #include <memory>
@@ -166,6 +167,56 @@ static std::vector<QPolygonF> geosToPolygons(const GEOSGeometry* input)
     return result;
 }
 
+//-----------------------------------------------------------------------------
+// Linear Referencing
+//-----------------------------------------------------------------------------
+
+// Returns count points at distances 0, spacing, 2 * spacing, ... along the
+// line, clamped to the last vertex. This is equivalent to calling
+// GEOSInterpolate for each distance, but walks the vertices once instead of
+// from the start of the line for every point.
+static QPolygonF interpolatePoints(const QPolygonF& line, double spacing, int count)
+{
+    QPolygonF result;
+    if (line.isEmpty() || count <= 0)
+        return result;
+
+    result.reserve(count);
+
+    int seg = 0;
+    const int nseg = line.size() - 1;
+    double segStart = 0;
+    double segLength = nseg > 0 ? std::hypot(line[1].x() - line[0].x(), line[1].y() - line[0].y()) : 0;
+
+    for (int i = 0; i < count; ++i)
+    {
+        const double d = static_cast<double>(i) * spacing;
+
+        // Advance to the segment containing d.
+        while (seg < nseg && d > segStart + segLength) {
+            segStart += segLength;
+            if (++seg < nseg) {
+                const QPointF& p0 = line[seg];
+                const QPointF& p1 = line[seg + 1];
+                segLength = std::hypot(p1.x() - p0.x(), p1.y() - p0.y());
+            }
+        }
+
+        if (seg >= nseg) {
+            result.push_back(line.back());
+            continue;
+        }
+
+        const QPointF& p0 = line[seg];
+        const QPointF& p1 = line[seg + 1];
+        const double f = segLength > 0 ? (d - segStart) / segLength : 0;
+        result.push_back(QPointF(p0.x() + f * (p1.x() - p0.x()),
+                                 p0.y() + f * (p1.y() - p0.y())));
+    }
+
+    return result;
+}
+
 //-----------------------------------------------------------------------------
 // Geometry Operations
 //-----------------------------------------------------------------------------
@@ -247,43 +298,28 @@ std::vector<QPolygonF> GeosOp::buffer(std::vector<QPolygonF> const& mpolygon, do
 
 std::vector<QPolygonF> GeosOp::measurePoints(std::vector<QPolygonF> const& mpolygon, double spacing)
 {
-    // FIXME: The C API GEOSInterpolate function generates a new linear
-    // index each time it is called. Use the C++ API to prevent this.
-
     std::vector<QPolygonF> result;
 
     if (mpolygon.empty() || spacing <= 0)
         return result;
 
-    GEOSGeometry* input = polygonsToGeos(mpolygon);
-
-    for (int i = 0; i < GEOSGetNumGeometries(input); ++i)
+    for (const QPolygonF& polygon : mpolygon)
     {
-        const GEOSGeometry *g = GEOSGetGeometryN(input, i);
-        const GEOSGeometry *ring = GEOSGetExteriorRing(g);
+        if (polygon.size() < 2)
+            continue;
+
+        QPolygonF ring = polygon;
+        if (!ring.isClosed())
+            ring.push_back(ring.front());
 
         // Calculate required number of segments
         double length = 0;
-        GEOSLength(ring, &length);
-        int ns = floor(length / spacing);
+        for (int i = 1; i < ring.size(); ++i)
+            length += std::hypot(ring[i].x() - ring[i-1].x(), ring[i].y() - ring[i-1].y());
+        int ns = static_cast<int>(std::floor(length / spacing));
 
-        // Generate points along ring using linear referencing
-        QPolygonF points;
-        points.reserve(ns + 1);
-        for (int i = 0; i <= ns; ++i) {
-            double px, py;
-            double pd = static_cast<double>(i) * spacing;
-            GEOSGeometry *p = GEOSInterpolate(ring, pd);
-            GEOSGeomGetX(p, &px);
-            GEOSGeomGetY(p, &py);
-            points.push_back(QPointF(px, py));
-            GEOSGeom_destroy(p);
-        }
-
-        result.push_back(points);
+        result.push_back(interpolatePoints(ring, spacing, ns + 1));
     }
 
-    GEOSGeom_destroy(input);
-
     return result;
 }
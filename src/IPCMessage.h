@@ -15,6 +15,9 @@
 
 #pragma once
 
+#include <atomic>
+#include <cstdint>
+
 #include "boost/endian/arithmetic.hpp"
 
 namespace IPCMessage
@@ -43,7 +46,28 @@ namespace IPCMessage
         boost::endian::little_int32_t tothrs;
     };
 
+    // Shared-memory status ring, used instead of the named pipe on Linux.
+    // The host creates a POSIX shared memory object holding this header
+    // followed by a data area of `capacity` bytes, and passes its name to
+    // AERMOD in the SOFEA_STATUS_SHM environment variable. AERMOD appends
+    // complete messages (as above) at `head`, wrapping at the end of the
+    // data area, and publishes them with a release store of `head`. The host
+    // consumes from `tail`. Both are running byte counts. Messages that do
+    // not fit in the free space (capacity - (head - tail)) are dropped by
+    // the writer; progress messages are superseded by the next one anyway.
+    struct ring_header_t {
+        std::uint32_t magic;
+        std::uint32_t capacity;
+        alignas(64) std::atomic<std::uint64_t> head;
+        alignas(64) std::atomic<std::uint64_t> tail;
+    };
+
+    constexpr std::uint32_t RING_MAGIC = 0x53464f53; // "SOFS"
+    constexpr const char *RING_ENV_VAR = "SOFEA_STATUS_SHM";
+
     static_assert(sizeof(header_t) == 12u, "IPCMessage::header_t bad size");
     static_assert(sizeof(errmsg_buffer_t) == 96u, "IPCMessage::errmsg_buffer_t bad size");
     static_assert(sizeof(tothrs_buffer_t) == 16u, "IPCMessage::tothrs_buffer_t bad size");
+    static_assert(sizeof(ring_header_t) == 192u, "IPCMessage::ring_header_t bad size");
+    static_assert(std::atomic<std::uint64_t>::is_always_lock_free, "IPCMessage::ring_header_t requires lock-free atomics");
 }
@@ -14,10 +14,11 @@
 //
 
 #include "IPCServer.h"
-#include "IPCMessage.h"
 
 #include <QByteArray>
 
+#include <cstring>
+
 #include <boost/algorithm/string.hpp>
 #include <boost/log/trivial.hpp>
 #include <boost/log/attributes/scoped_attribute.hpp>
@@ -61,6 +62,7 @@ bool IPCServer::stop()
     BOOST_LOG_TRIVIAL(debug) << "IPC server stopped";
     disconnect(server, &QLocalServer::newConnection, this, &IPCServer::clientConnected);
     connections.clear();
+    pending.clear();
     return true;
 }
 
@@ -72,6 +74,48 @@ void IPCServer::addPid(const qint64 pid, const std::string& dir)
 void IPCServer::removePid(const qint64 pid)
 {
     pidToDir.remove(pid);
+    progress.remove(pid);
+}
+
+QMap<qint64, quint32> IPCServer::takeProgress()
+{
+    // Latest hour count for each process since the last call.
+    QMap<qint64, quint32> result;
+    result.swap(progress);
+    return result;
+}
+
+void IPCServer::logErrorMessage(const IPCMessage::errmsg_buffer_t& msgbuf, const std::string& dir)
+{
+    // Fortran char arrays are not null-terminated.
+    std::string pathwy(msgbuf.pathwy, sizeof(msgbuf.pathwy));
+    std::string errcod(msgbuf.errcod, sizeof(msgbuf.errcod));
+    int lineno = msgbuf.lineno;
+    std::string modnam(msgbuf.modnam, sizeof(msgbuf.modnam));
+    std::string errmg1(msgbuf.errmg1, sizeof(msgbuf.errmg1));
+    std::string errmg2(msgbuf.errmg2, sizeof(msgbuf.errmg2));
+    boost::trim_right(errmg1);
+    boost::trim_right(errmg2);
+
+    // Set attributes.
+    BOOST_LOG_SCOPED_THREAD_TAG("Dir", dir);
+    BOOST_LOG_SCOPED_THREAD_TAG("Pathway", pathwy);
+    BOOST_LOG_SCOPED_THREAD_TAG("ErrorCode", errcod);
+    BOOST_LOG_SCOPED_THREAD_TAG("Line", lineno);
+    BOOST_LOG_SCOPED_THREAD_TAG("Module", modnam);
+
+    // Log the error message.
+    switch (msgbuf.errtyp) {
+    case 'E':
+        BOOST_LOG_TRIVIAL(error) << errmg1 << " " << errmg2;
+        break;
+    case 'W':
+        BOOST_LOG_TRIVIAL(warning) << errmg1 << " " << errmg2;
+        break;
+    default:
+        BOOST_LOG_TRIVIAL(info) << errmg1 << " " << errmg2;
+        break;
+    }
 }
 
 void IPCServer::clientConnected()
@@ -92,6 +136,7 @@ void IPCServer::clientDisconnected()
 
     QLocalSocket *socket = qobject_cast<QLocalSocket*>(QObject::sender());
     connections.removeAll(socket);
+    pending.remove(socket);
     socket->deleteLater();
 }
 
@@ -100,7 +145,10 @@ void IPCServer::readMessage()
     using namespace IPCMessage;
 
     QLocalSocket *socket = qobject_cast<QLocalSocket*>(QObject::sender());
-    QByteArray buffer = socket->readAll();
+
+    // Keep incomplete messages until the next read.
+    QByteArray& buffer = pending[socket];
+    buffer.append(socket->readAll());
 
     int offset = 0;
     while (true)
@@ -112,6 +160,12 @@ void IPCServer::readMessage()
         IPCMessage::header_t header;
         std::memcpy(&header, buffer.constData() + offset, sizeof(header));
 
+        // Discard the stream if the header is corrupt.
+        if (header.cbsize < static_cast<int>(sizeof(header_t))) {
+            offset = buffer.size();
+            break;
+        }
+
         // Read full message.
         if (offset + header.cbsize > buffer.size())
             break;
@@ -120,47 +174,19 @@ void IPCServer::readMessage()
         {
             IPCMessage::errmsg_buffer_t msgbuf;
             std::memcpy(&msgbuf, buffer.constData() + offset, sizeof(msgbuf));
-
-            // Fortran char arrays are not null-terminated.
-            std::string pathwy(msgbuf.pathwy, sizeof(msgbuf.pathwy));
-            std::string errcod(msgbuf.errcod, sizeof(msgbuf.errcod));
-            int lineno = msgbuf.lineno;
-            std::string modnam(msgbuf.modnam, sizeof(msgbuf.modnam));
-            std::string errmg1(msgbuf.errmg1, sizeof(msgbuf.errmg1));
-            std::string errmg2(msgbuf.errmg2, sizeof(msgbuf.errmg2));
-            boost::trim_right(errmg1);
-            boost::trim_right(errmg2);
-
-            // Set attributes.
-            std::string dir = pidToDir.value(header.procid);
-            BOOST_LOG_SCOPED_THREAD_TAG("Dir", dir);
-            BOOST_LOG_SCOPED_THREAD_TAG("Pathway", pathwy);
-            BOOST_LOG_SCOPED_THREAD_TAG("ErrorCode", errcod);
-            BOOST_LOG_SCOPED_THREAD_TAG("Line", lineno);
-            BOOST_LOG_SCOPED_THREAD_TAG("Module", modnam);
-
-            // Log the error message.
-            switch (msgbuf.errtyp) {
-            case 'E':
-                BOOST_LOG_TRIVIAL(error) << errmg1 << " " << errmg2;
-                break;
-            case 'W':
-                BOOST_LOG_TRIVIAL(warning) << errmg1 << " " << errmg2;
-                break;
-            default:
-                BOOST_LOG_TRIVIAL(info) << errmg1 << " " << errmg2;
-                break;
-            }
+            logErrorMessage(msgbuf, pidToDir.value(header.procid));
         }
         else if (header.msgtyp == 2 && header.cbsize == sizeof(tothrs_buffer_t))
         {
             IPCMessage::tothrs_buffer_t msgbuf;
             std::memcpy(&msgbuf, buffer.constData() + offset, sizeof(msgbuf));
 
-            // Signal the Run Model dialog to update progress indicators.
-            emit messageReceived(msgbuf.header.procid, msgbuf.tothrs);
+            // Progress is polled by the Run Model dialog; keep the latest value.
+            progress[msgbuf.header.procid] = msgbuf.tothrs;
         }
 
         offset += header.cbsize;
     }
+
+    buffer.remove(0, offset);
 }
@@ -22,6 +22,8 @@
 
 #include <string>
 
+#include "IPCMessage.h"
+
 class IPCServer : public QObject
 {
     Q_OBJECT
@@ -32,19 +34,21 @@ public:
     bool stop();
     void addPid(const qint64 pid, const std::string &dir);
     void removePid(const qint64 pid);
+    QMap<qint64, quint32> takeProgress();
+
+    static void logErrorMessage(const IPCMessage::errmsg_buffer_t& msgbuf, const std::string& dir);
 
 private slots:
     void clientConnected();
     void clientDisconnected();
     void readMessage();
 
-signals:
-    void messageReceived(quint32 pid, quint32 msg);
-
 private:
     QLocalServer *server;
     QList<QLocalSocket *> connections;
+    QMap<QLocalSocket *, QByteArray> pending;
     QMap<qint64, std::string> pidToDir;
+    QMap<qint64, quint32> progress;
 };
 
 #endif // IPCSERVER_H
@@ -1129,6 +1129,15 @@ void MainWindow::showElevationEditor(Scenario *s)
     editor->setAreaOfUse(area);
     editor->setReceptors(s->receptors);
 
+    connect(editor, &ReceptorElevationEditor::runRequested, [=]() {
+        editor->loadReceptors(s->receptors);
+    });
+
+    connect(editor, &ReceptorElevationEditor::elevationsUpdated, [=]() {
+        editor->saveElevations(s->receptors);
+        emit scenarioUpdated(s);
+    });
+
     editor->show();
 }
 
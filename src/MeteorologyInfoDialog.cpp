@@ -15,8 +15,8 @@
 
 #include <algorithm>
 #include <array>
-
-#include <boost/histogram.hpp>
+#include <tuple>
+#include <utility>
 
 #include <QBoxLayout>
 #include <QButtonGroup>
@@ -33,6 +33,7 @@
 #include <QSignalBlocker>
 #include <QSpinBox>
 #include <QStandardItemModel>
+#include <QTabWidget>
 
 #include <QDebug>
 
@@ -44,6 +45,7 @@
 #include "MeteorologyInfoDialog.h"
 
 #include "ctk/ctkRangeSlider.h"
+#include "models/SurfaceDataModel.h"
 #include "utilities/DateTimeConversion.h"
 #include "utilities/PixmapUtilities.h"
 #include "widgets/ReadOnlyLineEdit.h"
@@ -209,7 +211,7 @@ public:
 //-----------------------------------------------------------------------------
 
 MeteorologyInfoDialog::MeteorologyInfoDialog(const Meteorology& m, QWidget *parent)
-    : QDialog(parent), surfaceData(m.surfaceFile.records())
+    : QDialog(parent), surfaceData(m.surfaceData())
 {
     setWindowTitle("Diagnostics");
     setWindowFlags(windowFlags() & ~Qt::WindowContextHelpButtonHint);
@@ -237,6 +239,22 @@ MeteorologyInfoDialog::MeteorologyInfoDialog(const Meteorology& m, QWidget *pare
     wrPlot->setBackgroundRole(QPalette::Window);
     wrPlot->setAutoFillBackground(true);
 
+    // Data Table
+    cboDataFilter = new QComboBox;
+    cboDataFilter->addItem(tr("All hours"), SurfaceDataModel::AllHours);
+    cboDataFilter->addItem(tr("Valid hours"), SurfaceDataModel::ValidHours);
+    cboDataFilter->addItem(tr("Calm hours"), SurfaceDataModel::CalmHours);
+    cboDataFilter->addItem(tr("Missing hours"), SurfaceDataModel::MissingHours);
+
+    dataModel = new SurfaceDataModel(this);
+    dataModel->setSurfaceData(surfaceData);
+
+    dataView = new StandardTableView;
+    dataView->setModel(dataModel);
+    dataView->setSelectionBehavior(QAbstractItemView::SelectRows);
+    dataView->setSortingEnabled(true);
+    dataView->sortByColumn(SurfaceDataModel::Time, Qt::AscendingOrder);
+
     // Plot Controls
     rbSectorSize10 = new QRadioButton(QLatin1String("10\x00b0"));
     rbSectorSize15 = new QRadioButton(QLatin1String("15\x00b0"));
@@ -342,11 +360,29 @@ MeteorologyInfoDialog::MeteorologyInfoDialog(const Meteorology& m, QWidget *pare
     controlsFrame->setFrameShape(QFrame::NoFrame);
     controlsFrame->setLayout(frameLayout);
 
+    // Data Tab
+    QHBoxLayout *dataFilterLayout = new QHBoxLayout;
+    dataFilterLayout->addWidget(new QLabel(tr("Show: ")));
+    dataFilterLayout->addWidget(cboDataFilter);
+    dataFilterLayout->addStretch(1);
+
+    QVBoxLayout *dataLayout = new QVBoxLayout;
+    dataLayout->addLayout(dataFilterLayout);
+    dataLayout->addWidget(dataView, 1);
+
+    QWidget *dataTab = new QWidget;
+    dataTab->setLayout(dataLayout);
+
+    tabWidget = new QTabWidget;
+    tabWidget->setDocumentMode(true);
+    tabWidget->addTab(wrPlot, tr("Wind Rose"));
+    tabWidget->addTab(dataTab, tr("Data"));
+
     // Main Layout
     QVBoxLayout *mainLayout = new QVBoxLayout;
     mainLayout->setContentsMargins(0, 0, 0, 0);
     mainLayout->addWidget(controlsFrame, 0);
-    mainLayout->addWidget(wrPlot, 1);
+    mainLayout->addWidget(tabWidget, 1);
     setLayout(mainLayout);
 
     // Default Color Map
@@ -366,27 +402,41 @@ MeteorologyInfoDialog::MeteorologyInfoDialog(const Meteorology& m, QWidget *pare
 
 void MeteorologyInfoDialog::init()
 {
-    if (surfaceData.size() == 0)
+    if (surfaceData->empty())
         return;
 
     connect(timeRangeSlider, &ctkRangeSlider::valuesChanged,
             this, &MeteorologyInfoDialog::onSliderChanged);
 
+    connect(timeRangeSlider, &ctkRangeSlider::sliderReleased,
+            this, &MeteorologyInfoDialog::updateRecordRange);
+
     connect(bgSectorSize, QOverload<int>::of(&QButtonGroup::buttonClicked),
             this, &MeteorologyInfoDialog::onSectorSizeChanged);
 
     connect(sbBinCount, QOverload<int>::of(&QSpinBox::valueChanged),
             this, &MeteorologyInfoDialog::onBinCountChanged);
 
+    connect(cboDataFilter, QOverload<int>::of(&QComboBox::currentIndexChanged),
+            this, &MeteorologyInfoDialog::onDataFilterChanged);
+
+    // Calm and missing hours of any record range, from prefix counts.
+    const std::size_t n = surfaceData->size();
+    calmPrefix.assign(n + 1, 0);
+    missingPrefix.assign(n + 1, 0);
+    for (std::size_t i = 0; i < n; ++i) {
+        const bool calm = surfaceData->calm(i);
+        calmPrefix[i + 1] = calmPrefix[i] + (calm ? 1 : 0);
+        missingPrefix[i + 1] = missingPrefix[i] + (!calm && surfaceData->missing(i) ? 1 : 0);
+    }
+
     // Slider Configuration
-    timeRangeSlider->setRange(1, (int)surfaceData.size());
-    timeRangeSlider->setPositions(1, (int)surfaceData.size());
+    timeRangeSlider->setRange(1, (int)surfaceData->size());
+    timeRangeSlider->setPositions(1, (int)surfaceData->size());
     timeRangeSlider->setEnabled(true);
 
-    auto& sr0 = surfaceData.front();
-    auto& sr1 = surfaceData.back();
-    QDateTime minTime = sofea::utilities::convert<QDateTime>(sr0.ptime);
-    QDateTime maxTime = sofea::utilities::convert<QDateTime>(sr1.ptime);
+    QDateTime minTime = sofea::utilities::convert<QDateTime>(surfaceData->time(0));
+    QDateTime maxTime = sofea::utilities::convert<QDateTime>(surfaceData->time(surfaceData->size() - 1));
 
     dteMinTime->setDateTime(minTime);
     dteMinTime->setDateTimeRange(minTime, maxTime);
@@ -408,7 +458,7 @@ void MeteorologyInfoDialog::onSliderChanged(const int min, const int max)
     const QSignalBlocker blocker1(dteMinTime);
     const QSignalBlocker blocker2(dteMaxTime);
 
-    if (min < 1 || max < min || max > surfaceData.size())
+    if (min < 1 || max < min || max > surfaceData->size())
         return;
 
     // Update member variables.
@@ -417,30 +467,37 @@ void MeteorologyInfoDialog::onSliderChanged(const int min, const int max)
 
     // Recalculate metrics on surface data subset.
     int nrec = idxMax - idxMin + 1;
-    int ncalm = 0;
-    int nmiss = 0;
-    for (int i=idxMin-1; i < idxMax; ++i) {
-        if (surfaceData[i].calm)
-            ncalm++;
-        else if (surfaceData[i].missing)
-            nmiss++;
-    }
+    int ncalm = calmPrefix[idxMax] - calmPrefix[idxMin - 1];
+    int nmiss = missingPrefix[idxMax] - missingPrefix[idxMin - 1];
 
     leTotalHours->setText(QString::number(nrec));
     leCalmHours->setText(QString::number(ncalm));
     leMissingHours->setText(QString::number(nmiss));
 
-    auto& sr0 = surfaceData[idxMin - 1];
-    auto& sr1 = surfaceData[idxMax - 1];
-    QDateTime minTime = sofea::utilities::convert<QDateTime>(sr0.ptime);
-    QDateTime maxTime = sofea::utilities::convert<QDateTime>(sr1.ptime);
+    QDateTime minTime = sofea::utilities::convert<QDateTime>(surfaceData->time(idxMin - 1));
+    QDateTime maxTime = sofea::utilities::convert<QDateTime>(surfaceData->time(idxMax - 1));
 
     dteMinTime->setDateTime(minTime);
     dteMaxTime->setDateTime(maxTime);
 
+    // The table is filtered once a drag ends.
+    if (!timeRangeSlider->isSliderDown())
+        updateRecordRange();
+
     drawSectors();
 }
 
+void MeteorologyInfoDialog::updateRecordRange()
+{
+    dataModel->setRecordRange(idxMin - 1, idxMax);
+}
+
+void MeteorologyInfoDialog::onDataFilterChanged(int index)
+{
+    auto filter = cboDataFilter->itemData(index).toInt();
+    dataModel->setFilter(static_cast<SurfaceDataModel::Filter>(filter));
+}
+
 void MeteorologyInfoDialog::onDateTimeChanged(const QDateTime& datetime)
 {
     const QSignalBlocker blocker1(dteMinTime);
@@ -474,19 +531,16 @@ void MeteorologyInfoDialog::onDateTimeChanged(const QDateTime& datetime)
     auto ptime0 = sofea::utilities::convert<boost::posix_time::ptime>(minDT);
     auto ptime1 = sofea::utilities::convert<boost::posix_time::ptime>(maxDT);
 
-    // Get iterators to the range inside the requested bounds.
-    auto lower = std::upper_bound(surfaceData.begin(), surfaceData.end(), ptime0,
-        [&](const auto& x, const auto& record) { return x < record.ptime; });
+    // Get indices of the range inside the requested bounds.
+    std::size_t lower = surfaceData->upperBound(ptime0);
+    std::size_t upper = surfaceData->lowerBound(ptime1);
 
-    auto upper = std::lower_bound(surfaceData.begin(), surfaceData.end(), ptime1,
-        [&](const auto& record, const auto& x) { return record.ptime < x; });
-
-    if (lower == surfaceData.end() || upper == surfaceData.end())
+    if (lower == surfaceData->size() || upper == surfaceData->size())
         return;
 
     // Update the slider.
-    int pos0 = std::distance(surfaceData.begin(), lower);
-    int pos1 = std::distance(surfaceData.begin(), upper) + 1;
+    int pos0 = static_cast<int>(lower);
+    int pos1 = static_cast<int>(upper) + 1;
     timeRangeSlider->setPositions(pos0, pos1);
 }
 
@@ -509,51 +563,48 @@ void MeteorologyInfoDialog::onBinCountChanged(int value)
     // TODO
 }
 
-void MeteorologyInfoDialog::drawSectors()
+const WindRose& MeteorologyInfoDialog::windRose()
 {
-    namespace bh = boost::histogram;
-    using namespace bh::literals; // enables _c suffix
+    // Built once per sector size and reused for every range query.
+    auto it = windRoses.find(wdBinCount);
+    if (it == windRoses.end()) {
+        it = windRoses.emplace(std::piecewise_construct, std::forward_as_tuple(wdBinCount),
+            std::forward_as_tuple(surfaceData, wdBinCount, wsBinCount, wsMin, wsMax)).first;
+    }
+    return it->second;
+}
 
+void MeteorologyInfoDialog::drawSectors()
+{
     // Remove and detach existing curves.
     wrSectors.clear();
     wrPlot->detachItems(QwtPolarItem::Rtti_PolarCurve, true);
 
-    if (idxMin < 1 || idxMax > surfaceData.size())
+    if (idxMin < 1 || idxMax > surfaceData->size())
         return;
 
-    // Number of valid observations (denominator).
-    int nvalid = 0;
-
-    // Generate the histogram.
-    auto hist = bh::make_histogram(
-        bh::axis::circular<>(wdBinCount, 0.0, 360.0), // wdir (azimuth)
-        bh::axis::regular<>(wsBinCount, wsMin, wsMax) // wspd (color)
-    );
-
-    for (int i = idxMin-1; i < idxMax; ++i) {
-        auto& sr = surfaceData[i];
-        if (!sr.calm && !sr.missing) {
-            nvalid++;
-            hist(sr.wdir, sr.wspd);
-        }
-    }
+    // Frequencies over the selected interval.
+    const WindRose& rose = windRose();
+    const WindRose::Counts counts = rose.counts(idxMin - 1, idxMax);
 
-    if (nvalid <= 0)
+    // Number of valid observations (denominator).
+    const std::size_t nvalid = counts.valid;
+    if (nvalid == 0)
         return;
 
     // Generate the sector curves.
     // Radius represents proportion of valid observations.
     double max_radius = 0;
-    for (int i = 0; i <= hist.axis(0_c).size(); ++i)
+    for (int i = 0; i <= rose.directionAxis().size(); ++i)
     {
         double prev_radius = 0;
-        double azimuth0 = hist.axis(0_c).bin(i).lower() + azimuthSpacing;
-        double azimuth1 = hist.axis(0_c).bin(i).upper() - azimuthSpacing;
+        double azimuth0 = rose.directionAxis().bin(i).lower() + azimuthSpacing;
+        double azimuth1 = rose.directionAxis().bin(i).upper() - azimuthSpacing;
 
-        for (int j = 0; j <= hist.axis(1_c).size(); ++j)
+        for (int j = 0; j <= rose.speedAxis().size(); ++j)
         {
             double radius0 = prev_radius;
-            double radius1 = prev_radius + (hist.at(i, j) / static_cast<double>(nvalid));
+            double radius1 = prev_radius + (counts.at(i, j) / static_cast<double>(nvalid));
 
             if (radius1 > max_radius)
                 max_radius = radius1;
@@ -591,10 +642,10 @@ void MeteorologyInfoDialog::drawSectors()
     wrPlot->replot();
 
     // Set legend labels for wind speed.
-    for (int i = 0; i < hist.axis(1_c).size(); ++i)
+    for (int i = 0; i < rose.speedAxis().size(); ++i)
     {
-        double radial0 = hist.axis(1_c).bin(i).lower();
-        double radial1 = hist.axis(1_c).bin(i).upper();
+        double radial0 = rose.speedAxis().bin(i).lower();
+        double radial1 = rose.speedAxis().bin(i).upper();
         QString label = tr("[")  + QString::number(radial0, 'g', 5) +
                         tr(", ") + QString::number(radial1, 'g', 5) + tr(")");
 
@@ -15,6 +15,7 @@
 
 #pragma once
 
+#include <map>
 #include <memory>
 #include <vector>
 
@@ -24,6 +25,7 @@
 
 QT_BEGIN_NAMESPACE
 class QButtonGroup;
+class QComboBox;
 class QDateTimeEdit;
 class QDialog;
 class QDialogButtonBox;
@@ -34,17 +36,21 @@ class QPointF;
 class QRadioButton;
 class QSpinBox;
 class QStandardItemModel;
+class QTabWidget;
 QT_END_NAMESPACE
 
 class ctkRangeSlider;
 class QwtPolarGrid;
 class ReadOnlyLineEdit;
+class StandardTableView;
+class SurfaceDataModel;
 
 #include <qwt_polar_curve.h>
 #include <qwt_polar_plot.h>
 #include <qwt_scale_map.h>
 
 #include "core/Meteorology.h"
+#include "core/WindRose.h"
 
 //-----------------------------------------------------------------------------
 // WindRoseSector
@@ -95,15 +101,21 @@ public:
 private:
     void init();
     void drawSectors();
+    void updateRecordRange();
+    const WindRose& windRose();
 
 private slots:
     void onSliderChanged(const int min, const int max);
     void onDateTimeChanged(const QDateTime& datetime);
     void onSectorSizeChanged(int id);
     void onBinCountChanged(int value);
+    void onDataFilterChanged(int index);
 
 private:
-    std::vector<SurfaceRecord> surfaceData;
+    std::shared_ptr<const SurfaceData> surfaceData;
+    std::map<int, WindRose> windRoses; // keyed by direction bin count
+    std::vector<int> calmPrefix;       // calm records before each index
+    std::vector<int> missingPrefix;    // missing records before each index
 
     // Data Controls
     ctkRangeSlider *timeRangeSlider;
@@ -124,6 +136,12 @@ private:
     QListView *binView;
     QDialogButtonBox *buttonBox;
 
+    // Data Table
+    QComboBox *cboDataFilter;
+    SurfaceDataModel *dataModel;
+    StandardTableView *dataView;
+    QTabWidget *tabWidget;
+
     WindRosePlot *wrPlot;
     std::vector<WindRoseSector *> wrSectors;
     std::vector<QColor> wrColors;
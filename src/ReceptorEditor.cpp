@@ -43,6 +43,7 @@
 #include <qwt_symbol.h>
 
 #include <algorithm>
+#include <map>
 #include <numeric>
 #include <utility>
 
@@ -704,13 +705,36 @@ void ReceptorParamsEditor::onUpdateClicked(bool)
         double zHill = nodeEditor->leNodeZHill->value();
         double zFlag = nodeEditor->leNodeZFlag->value();
 
+        // Update each group once, starting from its current values.
+        std::map<int, std::vector<int>> groupRows;
         for (const QModelIndex& index : selectedRows) {
-            if (zElevChanged)
-                model->updateZElev(index, zElev);
-            if (zHillChanged)
-                model->updateZHill(index, zHill);
-            if (zFlagChanged)
-                model->updateZFlag(index, zFlag);
+            if (index.internalId() != 0)
+                groupRows[index.parent().row()].push_back(index.row());
+        }
+
+        for (const auto& [groupRow, rows] : groupRows) {
+            QModelIndex groupIndex = model->index(groupRow, 0);
+            const ReceptorGroup& group = model->groupFromIndex(groupIndex);
+            std::size_t n = boost::apply_visitor(ReceptorNodeCountVisitor(), group);
+
+            std::vector<double> zElevs(n), zHills(n), zFlags(n);
+            for (std::size_t i = 0; i < n; ++i) {
+                ReceptorNode node = boost::apply_visitor(ReceptorGroupNodeVisitor(static_cast<int>(i)), group);
+                zElevs[i] = node.zElev;
+                zHills[i] = node.zHill;
+                zFlags[i] = node.zFlag;
+            }
+
+            for (int row : rows) {
+                if (zElevChanged)
+                    zElevs[row] = zElev;
+                if (zHillChanged)
+                    zHills[row] = zHill;
+                if (zFlagChanged)
+                    zFlags[row] = zFlag;
+            }
+
+            model->updateElevations(groupIndex, zElevs, zHills, zFlags);
         }
     }
 }
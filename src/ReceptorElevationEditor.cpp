@@ -13,8 +13,6 @@
 // limitations under the License.
 //
 
-#include <chrono>
-
 #include <QApplication>
 #include <QBoxLayout>
 #include <QCheckBox>
@@ -38,12 +36,12 @@
 
 #include <boost/variant.hpp>
 #include <boost/log/trivial.hpp>
+#include <boost/log/attributes/scoped_attribute.hpp>
 
 #include "ReceptorElevationEditor.h"
 #include "ReceptorVisitor.h"
 #include "core/Common.h"
-#include "core/TerrainProcessor.h"
-#include "models/OpenCLDeviceInfoModel.h"
+#include "models/ReceptorModel.h"
 #include "models/WKTModel.h"
 #include "widgets/BoundingBoxEditor.h"
 #include "widgets/GroupBoxFrame.h"
@@ -52,6 +50,11 @@
 #include "widgets/ReadOnlyLineEdit.h"
 #include "widgets/StatusLabel.h"
 
+#ifdef SOFEA_OPENCL
+#include "core/TerrainProcessor.h"
+#include "models/OpenCLDeviceInfoModel.h"
+#endif
+
 ReceptorElevationEditor::ReceptorElevationEditor(QWidget *parent)
     : QWidget(parent)
 {
@@ -72,11 +75,15 @@ ReceptorElevationEditor::ReceptorElevationEditor(QWidget *parent)
 
     bboxEdit = new BoundingBoxEditor;
 
-    deviceModel = new OpenCLDeviceInfoModel(this);
     deviceView = new QTreeView;
     deviceView->setRootIsDecorated(false);
     deviceView->header()->setSectionResizeMode(QHeaderView::ResizeToContents);
+#ifdef SOFEA_OPENCL
+    deviceModel = new OpenCLDeviceInfoModel(this);
     deviceView->setModel(deviceModel);
+#else
+    deviceView->setHidden(true);
+#endif
 
     outputCheckBox = new QCheckBox(tr("Export GeoTIFF"));
     outputCheckBox->setChecked(false);
@@ -101,6 +108,8 @@ ReceptorElevationEditor::ReceptorElevationEditor(QWidget *parent)
 
     btnStartStop = new QPushButton(tr("Start"));
 
+    model_ = new ReceptorModel(this);
+
     // Connections
     connect(infoLabel->label(), &QLabel::linkActivated, [](const QString& url) {
         QDesktopServices::openUrl(QUrl(url));
@@ -142,7 +151,8 @@ ReceptorElevationEditor::ReceptorElevationEditor(QWidget *parent)
     QFormLayout *deviceLayout = new QFormLayout;
     deviceLayout->setRowWrapPolicy(QFormLayout::WrapAllRows);
     deviceLayout->setSpacing(10);
-    deviceLayout->addRow(tr("Compute Device"), deviceView);
+    if (!deviceView->isHidden())
+        deviceLayout->addRow(tr("Compute Device"), deviceView);
 
     QFormLayout *exportLayout = new QFormLayout;
     exportLayout->setRowWrapPolicy(QFormLayout::WrapAllRows);
@@ -190,6 +200,12 @@ void ReceptorElevationEditor::setReceptors(const std::vector<ReceptorGroup>& rec
         bbox |= boost::apply_visitor(ReceptorGroupRectVisitor(), group);
 
     bboxEdit->setValue(bbox);
+    loadReceptors(receptors);
+}
+
+void ReceptorElevationEditor::loadReceptors(const std::vector<ReceptorGroup>& receptors)
+{
+    model_->load(receptors);
 }
 
 void ReceptorElevationEditor::setBoundingBox(const QRectF& bbox)
@@ -197,6 +213,29 @@ void ReceptorElevationEditor::setBoundingBox(const QRectF& bbox)
     bboxEdit->setValue(bbox);
 }
 
+void ReceptorElevationEditor::saveElevations(std::vector<ReceptorGroup>& receptors) const
+{
+    // Only elevations are copied, so other edits made to the receptors
+    // during a run are kept. Groups whose node count has changed since the
+    // run started are skipped.
+    const std::vector<double> zFlag;
+    const int n = std::min(static_cast<int>(receptors.size()), model_->rowCount());
+    for (int i = 0; i < n; ++i) {
+        const ReceptorGroup& group = model_->groupFromIndex(model_->index(i, 0));
+        const std::size_t count = boost::apply_visitor(ReceptorNodeCountVisitor(), group);
+
+        std::vector<double> zElev(count);
+        std::vector<double> zHill(count);
+        for (std::size_t j = 0; j < count; ++j) {
+            ReceptorNode node = boost::apply_visitor(ReceptorGroupNodeVisitor(static_cast<int>(j)), group);
+            zElev[j] = node.zElev;
+            zHill[j] = node.zHill;
+        }
+
+        boost::apply_visitor(SetReceptorGroupElevations(zElev, zHill, zFlag), receptors[static_cast<std::size_t>(i)]);
+    }
+}
+
 void ReceptorElevationEditor::onBoundingBoxChanged(const QRectF& bbox)
 {
     using namespace Projection;
@@ -272,51 +311,144 @@ void ReceptorElevationEditor::onMessage(const QString& message)
 
 void ReceptorElevationEditor::onFinished()
 {
-    btnStartStop->setText(tr("Start"));
-
     try {
-        std::vector<float> array = future_.get();
+        // Receptors are processed once the DEM has been read.
+        if (future_.valid()) {
+            std::vector<float> values = future_.get();
+            QString outputPath = outputPathEdit->currentPath();
+            if (outputCheckBox->isChecked() && !outputPath.isEmpty())
+                dataset_->exportGeoTIFF(outputPath.toStdString(), values);
+            processReceptors(std::move(values));
+            return;
+        }
+
+        TerrainResult result = result_.get();
+        updateElevations(result);
+        progressLabel->setText(tr("Updated %1 receptors").arg(result.zElev.size()));
     } catch (const std::exception& e) {
         progressLabel->setText(e.what());
         progressBar->setState(ProgressBar::Error);
     }
+
+    btnStartStop->setText(tr("Start"));
 }
 
 void ReceptorElevationEditor::onStartStopClicked()
 {
     using namespace sofea::constants;
 
-    // Abort if the future is not ready.
-    if (future_.valid() && future_.wait_for(std::chrono::milliseconds(1)) != std::future_status::ready) {
+    // Abort if a task has not finished. Futures are released in onFinished.
+    if (future_.valid() || result_.valid()) {
         progressLabel->setText("Stopping");
         control_.requestInterrupt();
         return;
     }
 
+    // Receptors may have been edited since the editor was opened.
+    emit runRequested();
+
+    if (model_->rowCount() == 0) {
+        progressLabel->setText(tr("No receptors have been defined."));
+        return;
+    }
+
     Projection::ProjectedExtent bbox;
     bbox.xmin = bboxEdit->xmin();
     bbox.ymin = bboxEdit->ymin();
     bbox.xmax = bboxEdit->xmax();
     bbox.ymax = bboxEdit->ymax();
 
-    auto conv = Projection::createConversion("16017"); // UTM 17N
-    auto gcrs = Projection::createGeodeticCRS(EPSG_HDATUM_NAD83_1986);
-    auto pcrs = Projection::createProjectedCRS(gcrs, conv, EPSG_UOM_METER);
-    //auto vcrs = Projection::createVerticalCRS(EPSG_VDATUM_NAVD88, EPSG_UOM_METER);
-    //auto compound = Projection::createCompoundCRS(pcrs, vcrs);
-
-    //std::string wcsFilename = "WCS:" + std::string(USGS_3DEP_WCS_ENDPOINT);
-    //QString appCachePath = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
-    //QString wcsCachePath = QDir::cleanPath(appCachePath + QDir::separator() + "wcs");
-    //std::string wcsCacheOption = "CACHE:" + wcsCachePath.toStdString();
-    //
-    //try {
-    //    dataset = std::make_unique<Raster::Dataset>(wcsFilename, "WCS", std::vector<std::string>{ wcsCacheOption });
-    //    dataset->setBoundingBox(pcrs, bbox);
-    //    future = dataset->readBlocks(control);
-    //} catch (const std::exception& e) {
-    //    progressLabel->setText(e.what());
-    //    progressBar->setState(ProgressBar::Error);
-    //    return;
-    //}
+    pcrs_ = Projection::getComponentCRS(ccrs_, 0);
+    auto bboxCRS = pcrs_;
+    if (bboxEdit->mode() == BoundingBoxEditor::Geographic)
+        bboxCRS = Projection::getGeodeticCRS(pcrs_);
+
+    std::string wcsFilename = "WCS:" + std::string(USGS_3DEP_WCS_ENDPOINT);
+    QString appCachePath = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    QString wcsCachePath = QDir::cleanPath(appCachePath + QDir::separator() + "wcs");
+    std::string wcsCacheOption = "CACHE:" + wcsCachePath.toStdString();
+
+    control_.resetInterrupt();
+
+    try {
+        dataset_ = std::make_shared<Raster::Dataset>(wcsFilename, "WCS", std::vector<std::string>{ wcsCacheOption });
+        dataset_->setBoundingBox(bboxCRS, bbox);
+
+        // Windows too large for memory are read in tiles as the receptors
+        // are processed.
+        if (StreamingTerrainProcessor::preferred(*dataset_))
+            streamReceptors();
+        else
+            future_ = dataset_->readBlocks(control_);
+    } catch (const std::exception& e) {
+        progressLabel->setText(e.what());
+        progressBar->setState(ProgressBar::Error);
+        return;
+    }
+}
+
+void ReceptorElevationEditor::receptorCoordinates(std::vector<double>& x, std::vector<double>& y) const
+{
+    // Receptor coordinates in node order, transformed to the DEM projection.
+    for (int i = 0; i < model_->rowCount(); ++i) {
+        const ReceptorGroup& group = model_->groupFromIndex(model_->index(i, 0));
+        const QPolygonF points = boost::apply_visitor(ReceptorGroupPointsVisitor(), group);
+        for (const QPointF& p : points) {
+            x.push_back(p.x());
+            y.push_back(p.y());
+        }
+    }
+
+    auto pipeline = Projection::Pipeline(pcrs_, dataset_->projection());
+    int err = pipeline.forward({ x.data(), x.size() }, { y.data(), y.size() });
+    if (err != 0)
+        throw std::runtime_error(Projection::Pipeline::errorString(err));
+}
+
+void ReceptorElevationEditor::processReceptors(std::vector<float> values)
+{
+    std::vector<double> x, y;
+    receptorCoordinates(x, y);
+
+    // TerrainProcessor has no OpenCL kernels yet, so the CPU processor is
+    // used whether or not a device is available.
+    auto dem = std::make_shared<const TerrainGrid>(TerrainGrid::fromDataset(*dataset_, std::move(values)));
+    processor_ = std::make_unique<CpuTerrainProcessor>(dem);
+    result_ = processor_->process(control_, std::move(x), std::move(y));
+}
+
+void ReceptorElevationEditor::streamReceptors()
+{
+    std::vector<double> x, y;
+    receptorCoordinates(x, y);
+
+    if (outputCheckBox->isChecked()) {
+        BOOST_LOG_SCOPED_THREAD_TAG("Source", "Terrain");
+        BOOST_LOG_TRIVIAL(warning) << "GeoTIFF export is not available for a DEM processed in tiles";
+    }
+
+    auto source = std::make_shared<const DatasetTileSource>(dataset_);
+    streamingProcessor_ = std::make_unique<StreamingTerrainProcessor>(source);
+    result_ = streamingProcessor_->process(control_, std::move(x), std::move(y));
+}
+
+void ReceptorElevationEditor::updateElevations(const TerrainResult& result)
+{
+    // Results are in node order, one group after another.
+    std::size_t offset = 0;
+    for (int i = 0; i < model_->rowCount(); ++i) {
+        const QModelIndex index = model_->index(i, 0);
+        const std::size_t n = boost::apply_visitor(ReceptorNodeCountVisitor(), model_->groupFromIndex(index));
+        if (offset + n > result.zElev.size())
+            throw std::runtime_error("Invalid terrain result");
+
+        const auto first = static_cast<std::ptrdiff_t>(offset);
+        const auto last = static_cast<std::ptrdiff_t>(offset + n);
+        std::vector<double> zElev(result.zElev.begin() + first, result.zElev.begin() + last);
+        std::vector<double> zHill(result.zHill.begin() + first, result.zHill.begin() + last);
+        model_->updateElevations(index, zElev, zHill);
+        offset += n;
+    }
+
+    emit elevationsUpdated();
 }
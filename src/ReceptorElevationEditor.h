@@ -21,6 +21,7 @@
 #include <memory>
 #include <vector>
 
+#include "core/CpuTerrainProcessor.h"
 #include "core/Projection.h"
 #include "core/Raster.h"
 #include "core/Receptor.h"
@@ -31,6 +32,7 @@ class OpenCLDeviceInfoModel;
 class PathEdit;
 class ProgressBar;
 class ReadOnlyLineEdit;
+class ReceptorModel;
 class StatusLabel;
 
 QT_BEGIN_NAMESPACE
@@ -53,7 +55,9 @@ public:
     void setCompoundCRS(std::shared_ptr<PJ> ccrs_);
     void setAreaOfUse(const Projection::GeographicExtent& area);
     void setReceptors(const std::vector<ReceptorGroup>& receptors);
+    void loadReceptors(const std::vector<ReceptorGroup>& receptors);
     void setBoundingBox(const QRectF& bbox);
+    void saveElevations(std::vector<ReceptorGroup>& receptors) const;
 
 private slots:
     void onBoundingBoxChanged(const QRectF& bbox);
@@ -68,17 +72,29 @@ signals:
     void progress(double complete);
     void message(const QString& text);
     void finished();
+    void runRequested();
+    void elevationsUpdated();
 
 private:
+    void receptorCoordinates(std::vector<double>& x, std::vector<double>& y) const;
+    void processReceptors(std::vector<float> values);
+    void streamReceptors();
+    void updateElevations(const TerrainResult& result);
+
     std::shared_ptr<PJ> ccrs_;
     Projection::GeographicExtent validArea_;
-    std::unique_ptr<Raster::Dataset> dataset_;
+    std::shared_ptr<PJ> pcrs_;
+    std::shared_ptr<Raster::Dataset> dataset_;
+    std::unique_ptr<CpuTerrainProcessor> processor_;
+    std::unique_ptr<StreamingTerrainProcessor> streamingProcessor_;
     TaskControl control_;
     std::future<std::vector<float>> future_;
+    std::future<TerrainResult> result_;
+    ReceptorModel *model_;
 
     StatusLabel *infoLabel;
     BoundingBoxEditor *bboxEdit;
-    OpenCLDeviceInfoModel *deviceModel;
+    OpenCLDeviceInfoModel *deviceModel = nullptr;
     QTreeView *deviceView;
     QCheckBox *outputCheckBox;
     PathEdit *outputPathEdit;
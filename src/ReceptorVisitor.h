@@ -16,11 +16,13 @@
 #pragma once
 
 #include <QColor>
+#include <QPolygonF>
 #include <QRectF>
 #include <QString>
 #include <QVariant>
 
 #include <string>
+#include <vector>
 
 #include <boost/variant.hpp>
 
@@ -86,6 +88,16 @@ struct ReceptorGroupRectVisitor
     }
 };
 
+// Receptor coordinates in node index order, which is the order expected by
+// SetReceptorGroupElevations.
+struct ReceptorGroupPointsVisitor
+{
+    template <typename T>
+    QPolygonF operator()(const T& group) const {
+        return group.points();
+    }
+};
+
 struct SetReceptorGroupColor
 {
     explicit SetReceptorGroupColor(const QColor& color)
@@ -161,6 +173,34 @@ struct SetReceptorZFlag
     const double zFlag_;
 };
 
+// Sets the elevation and hill height, and optionally the flagpole height, of
+// every receptor in the group from arrays in node index order. An empty zFlag
+// array leaves flagpole heights unchanged. Fails without modifying the group
+// if the array sizes do not match the node count.
+struct SetReceptorGroupElevations
+    : public boost::static_visitor<bool>
+{
+    explicit SetReceptorGroupElevations(const std::vector<double>& zElev, const std::vector<double>& zHill,
+                                        const std::vector<double>& zFlag)
+        : zElev_(zElev), zHill_(zHill), zFlag_(zFlag)
+    {}
+
+    template <typename T>
+    bool operator()(T& group) const {
+        if (zElev_.size() != group.nodeCount() || zHill_.size() != group.nodeCount())
+            return false;
+        if (!zFlag_.empty() && zFlag_.size() != group.nodeCount())
+            return false;
+
+        return group.setZElev(zElev_) && group.setZHill(zHill_) &&
+               (zFlag_.empty() || group.setZFlag(zFlag_));
+    }
+
+    const std::vector<double>& zElev_;
+    const std::vector<double>& zHill_;
+    const std::vector<double>& zFlag_;
+};
+
 struct RemoveReceptorGroupNodes
 {
     explicit RemoveReceptorGroupNodes(int start, int count)
@@ -15,6 +15,7 @@
 
 #include <QAction>
 #include <QBoxLayout>
+#include <QCheckBox>
 #include <QDesktopServices>
 #include <QDialogButtonBox>
 #include <QDir>
@@ -22,7 +23,9 @@
 #include <QLabel>
 #include <QLineEdit>
 #include <QMenu>
+#include <QMessageBox>
 #include <QPushButton>
+#include <QSpinBox>
 #include <QThread>
 #include <QToolButton>
 #include <QSettings>
@@ -36,6 +39,7 @@
 #include "core/Common.h"
 #include "core/Scenario.h"
 #include "delegates/ProgressBarDelegate.h"
+#include "delegates/SpinBoxDelegate.h"
 #include "models/ProcessModel.h"
 #include "widgets/StandardTableView.h"
 
@@ -53,11 +57,40 @@ RunModelDialog::RunModelDialog(QWidget *parent) : QDialog(parent)
     btnWorkingDir->setText("...");
 
     lblThreads = new QLabel(tr("Available processor cores: %1").arg(QThread::idealThreadCount()));
+    sbPartitions = new QSpinBox;
+    sbPartitions->setRange(1, std::max(1, QThread::idealThreadCount()));
+    sbPartitions->setValue(1);
+    sbPartitions->setToolTip(tr("Split the receptor domain across parallel AERMOD processes"));
+    sbSegments = new QSpinBox;
+    sbSegments->setRange(1, std::max(1, QThread::idealThreadCount()));
+    sbSegments->setValue(1);
+    sbSegments->setToolTip(tr("Split the meteorological period across parallel AERMOD processes"));
+    sbOverlap = new QSpinBox;
+    sbOverlap->setRange(0, 366);
+    sbOverlap->setValue(0);
+    sbOverlap->setToolTip(tr("Minimum overlap between time segments, e.g. the longest rolling window"));
+    cbNarrowPeriod = new QCheckBox(tr("Emission period only"));
+    cbNarrowPeriod->setChecked(false);
+    cbNarrowPeriod->setToolTip(tr("Simulate only the days with emissions, extended by the overlap and longest averaging period"));
+    cbTrimMetFiles = new QCheckBox(tr("Trim met files"));
+    cbTrimMetFiles->setChecked(false);
+    cbTrimMetFiles->setToolTip(tr("Copy only the simulated hours of the meteorological files into the job directory"));
+    sbMaxProcesses = new QSpinBox;
+    sbMaxProcesses->setRange(1, 1024);
+    sbMaxProcesses->setValue(std::max(1, QThread::idealThreadCount()));
+    sbMaxProcesses->setToolTip(tr("Maximum number of concurrent AERMOD processes"));
+    cbMemoryAware = new QCheckBox(tr("Memory-aware admission"));
+    cbMemoryAware->setChecked(true);
+    cbMemoryAware->setToolTip(tr("Hold queued processes until enough physical memory is available"));
+    cbAffinity = new QCheckBox(tr("Pin processes to cores"));
+    cbAffinity->setChecked(false);
     btnSelectAll = new QPushButton(tr("Select All"));
     btnDeselectAll = new QPushButton(tr("Deselect All"));
     btnRun = new QPushButton(tr("Run"));
     btnPause = new QPushButton(tr("Pause"));
     btnStop = new QPushButton(tr("Stop"));
+    btnExportMetrics = new QPushButton(tr("Export Metrics..."));
+    btnExportMetrics->setToolTip(tr("Export resource usage of all jobs to CSV"));
 
     model = new ProcessModel(this);
 
@@ -65,22 +98,28 @@ RunModelDialog::RunModelDialog(QWidget *parent) : QDialog(parent)
     table->setModel(model);
     table->setSelectionBehavior(QAbstractItemView::SelectRows);
     table->setSelectionMode(QAbstractItemView::ExtendedSelection);
-    table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    table->setEditTriggers(QAbstractItemView::DoubleClicked | QAbstractItemView::EditKeyPressed);
     table->setContextMenuPolicy(Qt::CustomContextMenu);
     table->setItemDelegateForColumn(ProcessModel::Progress, new ProgressBarDelegate);
+    table->setItemDelegateForColumn(ProcessModel::Priority, new SpinBoxDelegate(-99, 99, 1));
 
     int startingWidth = table->font().pointSize();
-    table->setColumnWidth(0, startingWidth * 12);
-    table->setColumnWidth(1, startingWidth * 12);
-    table->setColumnWidth(2, startingWidth * 20);
-    table->setColumnWidth(3, startingWidth * 10);
-    table->setColumnWidth(4, startingWidth * 20);
+    table->setColumnWidth(ProcessModel::Name, startingWidth * 12);
+    table->setColumnWidth(ProcessModel::Status, startingWidth * 12);
+    table->setColumnWidth(ProcessModel::Started, startingWidth * 20);
+    table->setColumnWidth(ProcessModel::Elapsed, startingWidth * 10);
+    table->setColumnWidth(ProcessModel::Progress, startingWidth * 20);
+    table->setColumnWidth(ProcessModel::Priority, startingWidth * 8);
+    for (int col = ProcessModel::InputTime; col <= ProcessModel::BytesWritten; ++col)
+        table->setColumnWidth(col, startingWidth * 12);
     table->setMinimumWidth(startingWidth * 100);
-    table->setColumnHidden(5, true);
+    table->setColumnHidden(ProcessModel::Path, true);
 
     // Context Menu Actions
     QIcon openFolderIcon = this->style()->standardIcon(static_cast<QStyle::StandardPixmap>(AppStyle::CP_OpenFolder));
     openFolderAction = new QAction(openFolderIcon, tr("Open Folder"), this);
+    moveUpAction = new QAction(tr("Move Up"), this);
+    moveDownAction = new QAction(tr("Move Down"), this);
 
 	// Button Box
     buttonBox = new QDialogButtonBox(QDialogButtonBox::Close);
@@ -94,6 +133,7 @@ RunModelDialog::RunModelDialog(QWidget *parent) : QDialog(parent)
     QHBoxLayout *controlsLayout = new QHBoxLayout;
     controlsLayout->addWidget(btnSelectAll);
     controlsLayout->addWidget(btnDeselectAll);
+    controlsLayout->addWidget(btnExportMetrics);
     controlsLayout->addStretch(1);
     controlsLayout->addWidget(btnRun);
     controlsLayout->addWidget(btnPause);
@@ -105,7 +145,32 @@ RunModelDialog::RunModelDialog(QWidget *parent) : QDialog(parent)
     mainLayout->addSpacing(10);
     mainLayout->addLayout(controlsLayout);
     mainLayout->addWidget(table);
-    mainLayout->addWidget(lblThreads);
+    QHBoxLayout *threadsLayout = new QHBoxLayout;
+    threadsLayout->addWidget(lblThreads);
+    threadsLayout->addStretch(1);
+    threadsLayout->addWidget(new QLabel(tr("Receptor partitions: ")));
+    threadsLayout->addWidget(sbPartitions);
+    threadsLayout->addSpacing(10);
+    threadsLayout->addWidget(new QLabel(tr("Time segments: ")));
+    threadsLayout->addWidget(sbSegments);
+    threadsLayout->addSpacing(10);
+    threadsLayout->addWidget(new QLabel(tr("Overlap (days): ")));
+    threadsLayout->addWidget(sbOverlap);
+    threadsLayout->addSpacing(10);
+    threadsLayout->addWidget(cbNarrowPeriod);
+    threadsLayout->addSpacing(10);
+    threadsLayout->addWidget(cbTrimMetFiles);
+    QHBoxLayout *schedulerLayout = new QHBoxLayout;
+    schedulerLayout->addWidget(new QLabel(tr("Max processes: ")));
+    schedulerLayout->addWidget(sbMaxProcesses);
+    schedulerLayout->addSpacing(10);
+    schedulerLayout->addWidget(cbMemoryAware);
+    schedulerLayout->addSpacing(10);
+    schedulerLayout->addWidget(cbAffinity);
+    schedulerLayout->addStretch(1);
+
+    mainLayout->addLayout(threadsLayout);
+    mainLayout->addLayout(schedulerLayout);
     mainLayout->addWidget(buttonBox);
 
     setLayout(mainLayout);
@@ -140,9 +205,27 @@ void RunModelDialog::setupConnections()
         table->setFocus();
     });
 
+    connect(sbPartitions, QOverload<int>::of(&QSpinBox::valueChanged),
+            model, &ProcessModel::setReceptorPartitions);
+    connect(sbSegments, QOverload<int>::of(&QSpinBox::valueChanged),
+            model, &ProcessModel::setTimeSegments);
+    connect(sbOverlap, QOverload<int>::of(&QSpinBox::valueChanged),
+            model, &ProcessModel::setSegmentOverlap);
+    connect(cbNarrowPeriod, &QCheckBox::toggled,
+            model, &ProcessModel::setNarrowPeriod);
+    connect(cbTrimMetFiles, &QCheckBox::toggled,
+            model, &ProcessModel::setTrimMetFiles);
+    connect(sbMaxProcesses, QOverload<int>::of(&QSpinBox::valueChanged),
+            model, &ProcessModel::setMaxConcurrency);
+    connect(cbMemoryAware, &QCheckBox::toggled,
+            model, &ProcessModel::setMemoryAware);
+    connect(cbAffinity, &QCheckBox::toggled,
+            model, &ProcessModel::setCpuAffinity);
+
     connect(btnRun, &QPushButton::clicked, this, &RunModelDialog::runSelected);
     connect(btnPause, &QPushButton::clicked, this, &RunModelDialog::pauseSelected);
     connect(btnStop, &QPushButton::clicked, this, &RunModelDialog::stopSelected);
+    connect(btnExportMetrics, &QPushButton::clicked, this, &RunModelDialog::exportMetrics);
     connect(buttonBox, &QDialogButtonBox::accepted, this, &RunModelDialog::accept);
     connect(buttonBox, &QDialogButtonBox::rejected, this, &RunModelDialog::reject);
 }
@@ -199,6 +282,17 @@ void RunModelDialog::stopSelected()
         model->stopJob(index.row());
 }
 
+void RunModelDialog::exportMetrics()
+{
+    const QString csvfile = QFileDialog::getSaveFileName(
+        this, tr("Export Job Metrics"), model->workingDirectory(), tr("CSV File (*.csv)"));
+
+    if (csvfile.isEmpty())
+        return;
+
+    if (!model->exportMetrics(csvfile))
+        QMessageBox::critical(this, tr("Export Failed"), tr("Unable to write %1").arg(csvfile));
+}
 
 void RunModelDialog::contextMenuRequested(const QPoint &pos)
 {
@@ -218,11 +312,24 @@ void RunModelDialog::contextMenuRequested(const QPoint &pos)
     QDir dir(path);
     openFolderAction->setEnabled(!path.isEmpty() && dir.exists());
 
+    moveUpAction->setEnabled(i > 0);
+    moveDownAction->setEnabled(i < model->rowCount() - 1);
+
     QMenu contextMenu;
     contextMenu.addAction(openFolderAction);
+    contextMenu.addSeparator();
+    contextMenu.addAction(moveUpAction);
+    contextMenu.addAction(moveDownAction);
 
+    // Queue position breaks ties between jobs of equal priority.
     QAction *selectedAction = contextMenu.exec(globalPos);
     if (selectedAction == openFolderAction) {
         QDesktopServices::openUrl(QUrl(dir.path()));
     }
+    else if (selectedAction == moveUpAction) {
+        model->moveRows(QModelIndex(), i, 1, QModelIndex(), i - 1);
+    }
+    else if (selectedAction == moveDownAction) {
+        model->moveRows(QModelIndex(), i, 1, QModelIndex(), i + 1);
+    }
 }
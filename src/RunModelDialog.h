@@ -30,10 +30,12 @@ class StandardTableView;
 
 QT_BEGIN_NAMESPACE
 class QAction;
+class QCheckBox;
 class QDialogButtonBox;
 class QLabel;
 class QLineEdit;
 class QPushButton;
+class QSpinBox;
 class QToolButton;
 QT_END_NAMESPACE
 
@@ -49,6 +51,7 @@ public:
     void runSelected();
     void pauseSelected();
     void stopSelected();
+    void exportMetrics();
 
 signals:
     void progressValueChanged(int value);
@@ -64,13 +67,24 @@ private:
     QLineEdit *leWorkingDir;
     QToolButton *btnWorkingDir;
     QLabel *lblThreads;
+    QSpinBox *sbPartitions;
+    QSpinBox *sbSegments;
+    QSpinBox *sbOverlap;
+    QCheckBox *cbNarrowPeriod;
+    QCheckBox *cbTrimMetFiles;
+    QSpinBox *sbMaxProcesses;
+    QCheckBox *cbMemoryAware;
+    QCheckBox *cbAffinity;
     QPushButton *btnSelectAll;
     QPushButton *btnDeselectAll;
     QPushButton *btnRun;
     QPushButton *btnPause;
     QPushButton *btnStop;
+    QPushButton *btnExportMetrics;
     StandardTableView *table;
     QAction *openFolderAction;
+    QAction *moveUpAction;
+    QAction *moveDownAction;
     QDialogButtonBox *buttonBox;
 };
 
@@ -0,0 +1,172 @@
+// Copyright 2020 Dow, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "StatusChannel.h"
+#include "IPCMessage.h"
+#include "IPCServer.h"
+
+#include <atomic>
+#include <cstring>
+#include <new>
+#include <vector>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include <boost/log/trivial.hpp>
+#include <boost/log/attributes/scoped_attribute.hpp>
+
+#include <fmt/format.h>
+
+namespace {
+
+// Room for several hundred error messages between polls.
+constexpr std::size_t RING_CAPACITY = 65536;
+
+} // namespace
+
+StatusChannel::StatusChannel(const std::string& name, void *data, std::size_t size)
+    : name_(name), data_(data), size_(size)
+{
+}
+
+std::unique_ptr<StatusChannel> StatusChannel::create()
+{
+#ifdef __linux__
+    BOOST_LOG_SCOPED_THREAD_TAG("Source", "General");
+
+    static std::atomic<unsigned int> counter{0};
+    std::string name = fmt::format("/sofea-status-{}-{}", getpid(), counter++);
+    std::size_t size = sizeof(IPCMessage::ring_header_t) + RING_CAPACITY;
+
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd == -1) {
+        BOOST_LOG_TRIVIAL(error) << "Unable to create status channel " << name
+                                 << ": " << std::strerror(errno);
+        return nullptr;
+    }
+
+    if (ftruncate(fd, static_cast<off_t>(size)) == -1) {
+        BOOST_LOG_TRIVIAL(error) << "Unable to size status channel " << name
+                                 << ": " << std::strerror(errno);
+        close(fd);
+        shm_unlink(name.c_str());
+        return nullptr;
+    }
+
+    void *data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (data == MAP_FAILED) {
+        BOOST_LOG_TRIVIAL(error) << "Unable to map status channel " << name
+                                 << ": " << std::strerror(errno);
+        shm_unlink(name.c_str());
+        return nullptr;
+    }
+
+    // The object is zero-filled by ftruncate.
+    auto hdr = new (data) IPCMessage::ring_header_t;
+    hdr->capacity = static_cast<std::uint32_t>(RING_CAPACITY);
+    hdr->head.store(0, std::memory_order_relaxed);
+    hdr->tail.store(0, std::memory_order_relaxed);
+    hdr->magic = IPCMessage::RING_MAGIC;
+    std::atomic_thread_fence(std::memory_order_release);
+
+    return std::unique_ptr<StatusChannel>(new StatusChannel(name, data, size));
+#else
+    return nullptr;
+#endif
+}
+
+StatusChannel::~StatusChannel()
+{
+#ifdef __linux__
+    munmap(data_, size_);
+    shm_unlink(name_.c_str());
+#endif
+}
+
+const std::string& StatusChannel::name() const
+{
+    return name_;
+}
+
+IPCMessage::ring_header_t *StatusChannel::header() const
+{
+    return static_cast<IPCMessage::ring_header_t *>(data_);
+}
+
+int StatusChannel::poll(const std::string& dir)
+{
+    using namespace IPCMessage;
+
+    auto hdr = header();
+    const char *ring = static_cast<const char *>(data_) + sizeof(ring_header_t);
+    const std::uint64_t capacity = hdr->capacity;
+
+    std::uint64_t head = hdr->head.load(std::memory_order_acquire);
+    std::uint64_t tail = hdr->tail.load(std::memory_order_relaxed);
+
+    if (head == tail)
+        return -1;
+
+    // Skip everything if the writer overran the reader.
+    if (head < tail || head - tail > capacity) {
+        hdr->tail.store(head, std::memory_order_release);
+        return -1;
+    }
+
+    // Copy out the pending bytes, which may wrap around the end of the ring.
+    std::vector<char> buffer(static_cast<std::size_t>(head - tail));
+    std::size_t start = static_cast<std::size_t>(tail % capacity);
+    std::size_t first = std::min(buffer.size(), static_cast<std::size_t>(capacity) - start);
+    std::memcpy(buffer.data(), ring + start, first);
+    std::memcpy(buffer.data() + first, ring, buffer.size() - first);
+
+    // Release the space to the writer.
+    hdr->tail.store(head, std::memory_order_release);
+
+    int hours = -1;
+    std::size_t offset = 0;
+    while (offset + sizeof(header_t) <= buffer.size())
+    {
+        header_t msghdr;
+        std::memcpy(&msghdr, buffer.data() + offset, sizeof(msghdr));
+
+        if (msghdr.cbsize < static_cast<int>(sizeof(header_t)) ||
+            offset + msghdr.cbsize > buffer.size())
+            break;
+
+        if (msghdr.msgtyp == 1 && msghdr.cbsize == sizeof(errmsg_buffer_t))
+        {
+            errmsg_buffer_t msgbuf;
+            std::memcpy(&msgbuf, buffer.data() + offset, sizeof(msgbuf));
+            IPCServer::logErrorMessage(msgbuf, dir);
+        }
+        else if (msghdr.msgtyp == 2 && msghdr.cbsize == sizeof(tothrs_buffer_t))
+        {
+            tothrs_buffer_t msgbuf;
+            std::memcpy(&msgbuf, buffer.data() + offset, sizeof(msgbuf));
+            hours = msgbuf.tothrs;
+        }
+
+        offset += static_cast<std::size_t>(msghdr.cbsize);
+    }
+
+    return hours;
+}
@@ -0,0 +1,57 @@
+// Copyright 2020 Dow, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+namespace IPCMessage {
+struct ring_header_t;
+}
+
+// Per-process status channel backed by a POSIX shared memory ring buffer
+// (see IPCMessage::ring_header_t). Carries the same messages as the named
+// pipe used by IPCServer on Windows, but is drained by polling instead of
+// one event per message.
+
+class StatusChannel
+{
+public:
+    // Returns nullptr if shared memory is not available on this platform.
+    static std::unique_ptr<StatusChannel> create();
+
+    ~StatusChannel();
+
+    StatusChannel(const StatusChannel&) = delete;
+    StatusChannel& operator=(const StatusChannel&) = delete;
+
+    // Shared memory object name, passed to AERMOD in SOFEA_STATUS_SHM.
+    const std::string& name() const;
+
+    // Consume pending messages. Error messages are logged with the given
+    // directory; returns the latest hour count, or -1 if none was received.
+    int poll(const std::string& dir);
+
+private:
+    StatusChannel(const std::string& name, void *data, std::size_t size);
+
+    IPCMessage::ring_header_t *header() const;
+
+    std::string name_;
+    void *data_;
+    std::size_t size_;
+};
@@ -0,0 +1,725 @@
+// Copyright 2020 Dow, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "Merge.h"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <numeric>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <fmt/format.h>
+#include <netcdf.h>
+
+namespace ncpost {
+
+namespace {
+
+// Upper bound on the size of a single hyperslab transfer.
+constexpr std::size_t slab_budget = 64 * 1024 * 1024;
+
+void check(int status, const std::string& context)
+{
+    if (status != NC_NOERR)
+        throw std::runtime_error(fmt::format("{}: {}", context, nc_strerror(status)));
+}
+
+// RAII wrapper for a netCDF file handle.
+class nc_file
+{
+public:
+    nc_file(const std::string& path, int mode, bool create = false)
+        : path_(path)
+    {
+        if (create)
+            check(nc_create(path.c_str(), mode, &ncid_), path);
+        else
+            check(nc_open(path.c_str(), mode, &ncid_), path);
+    }
+
+    nc_file(const nc_file&) = delete;
+    nc_file& operator=(const nc_file&) = delete;
+
+    nc_file(nc_file&& other) noexcept
+        : ncid_(std::exchange(other.ncid_, -1)), path_(std::move(other.path_))
+    {}
+
+    ~nc_file() {
+        if (ncid_ >= 0)
+            nc_close(ncid_);
+    }
+
+    void close() {
+        int status = nc_close(std::exchange(ncid_, -1));
+        check(status, path_);
+    }
+
+    int id() const { return ncid_; }
+    const std::string& path() const { return path_; }
+
+private:
+    int ncid_ = -1;
+    std::string path_;
+};
+
+struct var_info
+{
+    int id;
+    std::string name;
+    nc_type type;
+    std::size_t elsize;
+    std::vector<std::string> dims;
+};
+
+// Contiguous block of indices along the merge dimension.
+struct index_run
+{
+    std::size_t src;   // first index in the input file
+    std::size_t dst;   // first index in the merged file
+    std::size_t count; // number of indices
+};
+
+// Lookup table for receptor arcid or netid strings.
+struct id_table
+{
+    bool present = false;
+    std::size_t length = 0;        // string length dimension
+    std::vector<std::string> rows; // raw fixed-length strings
+    std::vector<int> index;        // one-based index for each receptor, or zero
+};
+
+std::size_t dim_length(int ncid, const std::string& name)
+{
+    int dimid;
+    std::size_t len;
+    check(nc_inq_dimid(ncid, name.c_str(), &dimid), name);
+    check(nc_inq_dimlen(ncid, dimid, &len), name);
+    return len;
+}
+
+std::vector<var_info> inquire_vars(int ncid)
+{
+    int nvars;
+    check(nc_inq_varids(ncid, &nvars, nullptr), "nc_inq_varids");
+    std::vector<int> varids(static_cast<std::size_t>(nvars));
+    check(nc_inq_varids(ncid, &nvars, varids.data()), "nc_inq_varids");
+
+    std::vector<var_info> result;
+    for (int varid : varids) {
+        char name[NC_MAX_NAME + 1];
+        nc_type type;
+        int ndims;
+        int dimids[NC_MAX_VAR_DIMS];
+        check(nc_inq_var(ncid, varid, name, &type, &ndims, dimids, nullptr), "nc_inq_var");
+
+        // Variable-length and user-defined types are not written by AERMOD.
+        if (type < NC_BYTE || type == NC_STRING || type > NC_MAX_ATOMIC_TYPE)
+            throw std::runtime_error(fmt::format("{}: unsupported variable type", name));
+
+        var_info var;
+        var.id = varid;
+        var.name = name;
+        var.type = type;
+        check(nc_inq_type(ncid, type, nullptr, &var.elsize), name);
+        for (int i = 0; i < ndims; ++i) {
+            char dimname[NC_MAX_NAME + 1];
+            check(nc_inq_dimname(ncid, dimids[i], dimname), name);
+            var.dims.push_back(dimname);
+        }
+        result.push_back(var);
+    }
+
+    return result;
+}
+
+std::vector<std::size_t> var_shape(int ncid, const var_info& var)
+{
+    std::vector<std::size_t> shape;
+    for (const auto& dim : var.dims)
+        shape.push_back(dim_length(ncid, dim));
+    return shape;
+}
+
+int create_mode(int format)
+{
+    switch (format) {
+    case NC_FORMAT_NETCDF4:         return NC_CLOBBER | NC_NETCDF4;
+    case NC_FORMAT_NETCDF4_CLASSIC: return NC_CLOBBER | NC_NETCDF4 | NC_CLASSIC_MODEL;
+    case NC_FORMAT_64BIT_OFFSET:    return NC_CLOBBER | NC_64BIT_OFFSET;
+#ifdef NC_FORMAT_64BIT_DATA
+    case NC_FORMAT_64BIT_DATA:      return NC_CLOBBER | NC_64BIT_DATA;
+#endif
+    default:                        return NC_CLOBBER;
+    }
+}
+
+// Create a file with the same dimensions, variables and attributes as the
+// template, overriding the length of the given dimensions.
+nc_file create_like(const nc_file& in, const std::string& path,
+                    const std::map<std::string, std::size_t>& lengths)
+{
+    int format;
+    check(nc_inq_format(in.id(), &format), in.path());
+    bool netcdf4 = (format == NC_FORMAT_NETCDF4 || format == NC_FORMAT_NETCDF4_CLASSIC);
+
+    nc_file out(path, create_mode(format), true);
+    int oldmode;
+    check(nc_set_fill(out.id(), NC_NOFILL, &oldmode), path);
+
+    // Dimensions
+    int ndims, nunlim;
+    check(nc_inq_dimids(in.id(), &ndims, nullptr, 0), in.path());
+    std::vector<int> dimids(static_cast<std::size_t>(ndims));
+    check(nc_inq_dimids(in.id(), &ndims, dimids.data(), 0), in.path());
+    check(nc_inq_unlimdims(in.id(), &nunlim, nullptr), in.path());
+    std::vector<int> unlimdims(static_cast<std::size_t>(nunlim));
+    check(nc_inq_unlimdims(in.id(), &nunlim, unlimdims.data()), in.path());
+
+    for (int dimid : dimids) {
+        char name[NC_MAX_NAME + 1];
+        std::size_t len;
+        check(nc_inq_dim(in.id(), dimid, name, &len), in.path());
+
+        bool unlimited = std::find(unlimdims.begin(), unlimdims.end(), dimid) != unlimdims.end();
+        auto it = lengths.find(name);
+        if (it != lengths.end())
+            len = it->second;
+
+        int outdimid;
+        check(nc_def_dim(out.id(), name, unlimited ? NC_UNLIMITED : len, &outdimid), name);
+    }
+
+    // Variables
+    for (const auto& var : inquire_vars(in.id())) {
+        std::vector<int> outdimids;
+        for (const auto& dim : var.dims) {
+            int outdimid;
+            check(nc_inq_dimid(out.id(), dim.c_str(), &outdimid), dim);
+            outdimids.push_back(outdimid);
+        }
+
+        int outvarid;
+        check(nc_def_var(out.id(), var.name.c_str(), var.type, static_cast<int>(outdimids.size()),
+                         outdimids.data(), &outvarid), var.name);
+
+        if (netcdf4 && !var.dims.empty()) {
+            int storage;
+            std::vector<std::size_t> chunks(var.dims.size());
+            check(nc_inq_var_chunking(in.id(), var.id, &storage, chunks.data()), var.name);
+            if (storage == NC_CHUNKED)
+                check(nc_def_var_chunking(out.id(), outvarid, NC_CHUNKED, chunks.data()), var.name);
+
+            int shuffle, deflate, level;
+            check(nc_inq_var_deflate(in.id(), var.id, &shuffle, &deflate, &level), var.name);
+            if (deflate)
+                check(nc_def_var_deflate(out.id(), outvarid, shuffle, deflate, level), var.name);
+        }
+
+        int natts;
+        check(nc_inq_varnatts(in.id(), var.id, &natts), var.name);
+        for (int i = 0; i < natts; ++i) {
+            char attname[NC_MAX_NAME + 1];
+            check(nc_inq_attname(in.id(), var.id, i, attname), var.name);
+            check(nc_copy_att(in.id(), var.id, attname, out.id(), outvarid), attname);
+        }
+    }
+
+    // Global attributes
+    int natts;
+    check(nc_inq_natts(in.id(), &natts), in.path());
+    for (int i = 0; i < natts; ++i) {
+        char attname[NC_MAX_NAME + 1];
+        check(nc_inq_attname(in.id(), NC_GLOBAL, i, attname), in.path());
+        check(nc_copy_att(in.id(), NC_GLOBAL, attname, out.id(), NC_GLOBAL), attname);
+    }
+
+    check(nc_enddef(out.id()), path);
+    return out;
+}
+
+// Copy a variable which does not depend on the merge dimension.
+void copy_var(const nc_file& in, const var_info& var, const nc_file& out, int outvarid)
+{
+    auto shape = var_shape(in.id(), var);
+    std::size_t n = std::accumulate(shape.begin(), shape.end(), std::size_t{1}, std::multiplies<>());
+    if (n == 0)
+        return;
+
+    std::vector<std::size_t> start(shape.size(), 0);
+    std::vector<char> buffer(n * var.elsize);
+    check(nc_get_vara(in.id(), var.id, start.data(), shape.data(), buffer.data()), var.name);
+    check(nc_put_vara(out.id(), outvarid, start.data(), shape.data(), buffer.data()), var.name);
+}
+
+// Copy runs of indices along dimension m of a variable. The input is read
+// once, in batches bounded by slab_budget along the dimension before m (or m
+// itself for the first dimension), and the runs are scattered from memory.
+// All dimensions after m are transferred whole.
+void copy_runs(const nc_file& in, const var_info& var, const nc_file& out, int outvarid,
+               std::size_t m, const std::vector<std::size_t>& shape, const std::vector<index_run>& runs)
+{
+    const std::size_t nd = shape.size();
+    for (std::size_t k = 0; k < nd; ++k) {
+        if (k != m && shape[k] == 0)
+            return;
+    }
+
+    // Span of dimension m covered by the runs.
+    std::size_t lo = shape[m];
+    std::size_t hi = 0;
+    for (const auto& run : runs) {
+        if (run.count == 0)
+            continue;
+        lo = std::min(lo, run.src);
+        hi = std::max(hi, run.src + run.count);
+    }
+    if (lo >= hi)
+        return;
+
+    std::size_t inner = var.elsize;
+    for (std::size_t k = m + 1; k < nd; ++k)
+        inner *= shape[k];
+
+    std::vector<char> buffer;
+    std::vector<char> scatter;
+    std::vector<std::size_t> start(nd, 0);
+    std::vector<std::size_t> count(shape);
+    std::vector<std::size_t> ostart(nd, 0);
+    std::vector<std::size_t> ocount(shape);
+
+    auto read = [&]() {
+        std::size_t n = std::accumulate(count.begin(), count.end(), std::size_t{1}, std::multiplies<>());
+        buffer.resize(n * var.elsize);
+        check(nc_get_vara(in.id(), var.id, start.data(), count.data(), buffer.data()), var.name);
+        ostart = start;
+        ocount = count;
+    };
+
+    if (m == 0) {
+        // Batches of indices along dimension m; runs are clipped to the batch.
+        const std::size_t batch = std::clamp<std::size_t>(slab_budget / inner, 1, hi - lo);
+        for (std::size_t b = lo; b < hi; b += batch) {
+            start[0] = b;
+            count[0] = std::min(batch, hi - b);
+            read();
+            for (const auto& run : runs) {
+                const std::size_t first = std::max(run.src, b);
+                const std::size_t last = std::min(run.src + run.count, b + count[0]);
+                if (first >= last)
+                    continue;
+                ostart[0] = run.dst + (first - run.src);
+                ocount[0] = last - first;
+                check(nc_put_vara(out.id(), outvarid, ostart.data(), ocount.data(),
+                                  buffer.data() + (first - b) * inner), var.name);
+            }
+        }
+        return;
+    }
+
+    // Batches along dimension m - 1, with one index at a time of the
+    // dimensions before it.
+    for (std::size_t k = 0; k + 1 < m; ++k)
+        count[k] = 1;
+    start[m] = lo;
+    count[m] = hi - lo;
+
+    const std::size_t row = count[m] * inner;
+    const std::size_t batch = std::clamp<std::size_t>(slab_budget / row, 1, shape[m - 1]);
+
+    bool done = false;
+    while (!done) {
+        for (std::size_t b = 0; b < shape[m - 1]; b += batch) {
+            start[m - 1] = b;
+            count[m - 1] = std::min(batch, shape[m - 1] - b);
+            read();
+
+            const std::size_t nb = count[m - 1];
+            for (const auto& run : runs) {
+                if (run.count == 0)
+                    continue;
+
+                // A single run over the whole span is written as read.
+                const std::size_t len = run.count * inner;
+                const char *data = buffer.data();
+                if (len != row) {
+                    scatter.resize(nb * len);
+                    for (std::size_t r = 0; r < nb; ++r)
+                        std::memcpy(scatter.data() + r * len, buffer.data() + r * row + (run.src - lo) * inner, len);
+                    data = scatter.data();
+                }
+
+                ostart[m] = run.dst;
+                ocount[m] = run.count;
+                check(nc_put_vara(out.id(), outvarid, ostart.data(), ocount.data(), data), var.name);
+            }
+        }
+
+        // Advance over the outer dimensions [0, m - 1).
+        done = true;
+        for (std::size_t k = m - 1; k-- > 0;) {
+            if (++start[k] < shape[k]) {
+                done = false;
+                break;
+            }
+            start[k] = 0;
+        }
+    }
+}
+
+std::vector<index_run> make_runs(const std::vector<std::size_t>& indices)
+{
+    std::vector<index_run> runs;
+    for (std::size_t k = 0; k < indices.size(); ++k) {
+        if (!runs.empty()) {
+            auto& last = runs.back();
+            if (last.src + last.count == k && last.dst + last.count == indices[k]) {
+                ++last.count;
+                continue;
+            }
+        }
+        runs.push_back(index_run{k, indices[k], 1});
+    }
+    return runs;
+}
+
+// Number the distinct ids of the receptors in order of first appearance.
+void build_ids(id_table& table, const std::vector<std::string>& owner)
+{
+    table.rows.clear();
+    table.index.assign(owner.size(), 0);
+
+    std::map<std::string, int> lookup;
+    for (std::size_t g = 0; g < owner.size(); ++g) {
+        if (owner[g].empty())
+            continue;
+
+        auto [it, inserted] = lookup.emplace(owner[g], static_cast<int>(table.rows.size()) + 1);
+        if (inserted)
+            table.rows.push_back(owner[g]);
+        table.index[g] = it->second;
+    }
+}
+
+// Rebuild an arcid or netid table in order of first appearance.
+id_table merge_ids(const std::vector<nc_file>& files,
+                   const std::vector<std::vector<std::size_t>>& indices,
+                   std::size_t nrec, const std::string& indexvar, const std::string& idvar)
+{
+    id_table table;
+    table.index.assign(nrec, 0);
+    std::vector<std::string> owner(nrec);
+
+    for (std::size_t i = 0; i < files.size(); ++i) {
+        int ncid = files[i].id();
+        int indexvarid, idvarid;
+        if (nc_inq_varid(ncid, indexvar.c_str(), &indexvarid) != NC_NOERR ||
+            nc_inq_varid(ncid, idvar.c_str(), &idvarid) != NC_NOERR)
+            continue;
+
+        var_info info;
+        info.id = idvarid;
+        info.name = idvar;
+        char dimname[NC_MAX_NAME + 1];
+        int dimids[NC_MAX_VAR_DIMS];
+        int ndims;
+        check(nc_inq_var(ncid, idvarid, nullptr, nullptr, &ndims, dimids, nullptr), idvar);
+        if (ndims != 2)
+            throw std::runtime_error(fmt::format("{}: unexpected dimensions", idvar));
+        for (int k = 0; k < ndims; ++k) {
+            check(nc_inq_dimname(ncid, dimids[k], dimname), idvar);
+            info.dims.push_back(dimname);
+        }
+
+        auto shape = var_shape(ncid, info);
+        std::size_t nids = shape[0];
+        std::size_t len = shape[1];
+        if (table.present && len != table.length)
+            throw std::runtime_error(fmt::format("{}: string length mismatch", idvar));
+
+        table.present = true;
+        table.length = len;
+
+        std::vector<char> text(nids * len);
+        if (!text.empty())
+            check(nc_get_var_text(ncid, idvarid, text.data()), idvar);
+
+        std::vector<int> values(indices[i].size());
+        if (!values.empty())
+            check(nc_get_var_int(ncid, indexvarid, values.data()), indexvar);
+
+        for (std::size_t k = 0; k < values.size(); ++k) {
+            int v = values[k];
+            if (v > 0 && static_cast<std::size_t>(v) <= nids && len > 0)
+                owner[indices[i][k]].assign(&text[static_cast<std::size_t>(v - 1) * len], len);
+        }
+    }
+
+    build_ids(table, owner);
+    return table;
+}
+
+// Move the ids of the flagged receptors to another table, e.g. grid receptors
+// written as discrete receptors, whose netid was written as an arcid.
+void move_ids(id_table& from, id_table& to, const std::vector<bool>& flags)
+{
+    std::size_t nrec = from.index.size();
+    std::vector<std::string> fromOwner(nrec);
+    std::vector<std::string> toOwner(nrec);
+    bool moved = false;
+
+    for (std::size_t g = 0; g < nrec; ++g) {
+        if (from.index[g] > 0)
+            fromOwner[g] = from.rows[static_cast<std::size_t>(from.index[g] - 1)];
+        if (to.index[g] > 0)
+            toOwner[g] = to.rows[static_cast<std::size_t>(to.index[g] - 1)];
+        if (g < flags.size() && flags[g] && !fromOwner[g].empty()) {
+            toOwner[g] = std::move(fromOwner[g]);
+            fromOwner[g].clear();
+            moved = true;
+        }
+    }
+
+    if (!moved)
+        return;
+
+    if (to.present && to.length != from.length)
+        throw std::runtime_error("arcid/netid string length mismatch");
+
+    to.present = true;
+    to.length = from.length;
+    build_ids(from, fromOwner);
+    build_ids(to, toOwner);
+}
+
+void write_ids(const nc_file& out, const id_table& table, const std::string& indexvar, const std::string& idvar)
+{
+    int indexvarid, idvarid;
+    check(nc_inq_varid(out.id(), indexvar.c_str(), &indexvarid), indexvar);
+    check(nc_inq_varid(out.id(), idvar.c_str(), &idvarid), idvar);
+
+    if (!table.index.empty())
+        check(nc_put_var_int(out.id(), indexvarid, table.index.data()), indexvar);
+
+    if (!table.rows.empty()) {
+        std::string text;
+        for (const auto& row : table.rows)
+            text += row;
+        std::size_t start[2] = {0, 0};
+        std::size_t count[2] = {table.rows.size(), table.length};
+        check(nc_put_vara_text(out.id(), idvarid, start, count, text.data()), idvar);
+    }
+}
+
+// Define an id table with the string length of an existing one.
+void define_ids(const nc_file& out, const std::string& likevar,
+                const std::string& indexvar, const std::string& idvar, std::size_t nids)
+{
+    int likevarid;
+    int dimids[NC_MAX_VAR_DIMS];
+    check(nc_inq_varid(out.id(), likevar.c_str(), &likevarid), likevar);
+    check(nc_inq_vardimid(out.id(), likevarid, dimids), likevar);
+
+    int recdimid, iddimid, indexvarid, idvarid;
+    check(nc_redef(out.id()), out.path());
+    check(nc_inq_dimid(out.id(), "rec", &recdimid), "rec");
+    check(nc_def_dim(out.id(), indexvar.c_str(), nids, &iddimid), indexvar);
+    check(nc_def_var(out.id(), indexvar.c_str(), NC_INT, 1, &recdimid, &indexvarid), indexvar);
+    int iddims[2] = {iddimid, dimids[1]};
+    check(nc_def_var(out.id(), idvar.c_str(), NC_CHAR, 2, iddims, &idvarid), idvar);
+    check(nc_enddef(out.id()), out.path());
+}
+
+} // namespace
+
+void merge_receptors(const std::vector<std::string>& inputs,
+                     const std::vector<std::vector<std::size_t>>& indices,
+                     const std::string& output,
+                     const std::vector<bool>& networks)
+{
+    if (inputs.empty() || inputs.size() != indices.size())
+        throw std::invalid_argument("Postfile merge requires receptor indices for each input.");
+
+    std::vector<nc_file> files;
+    files.reserve(inputs.size());
+    for (const auto& path : inputs)
+        files.emplace_back(path, NC_NOWRITE);
+
+    // Verify that the receptor indices are a permutation of the global order.
+    std::size_t nrec = 0;
+    for (std::size_t i = 0; i < files.size(); ++i) {
+        if (dim_length(files[i].id(), "rec") != indices[i].size())
+            throw std::runtime_error(fmt::format("{}: unexpected receptor count", inputs[i]));
+        nrec += indices[i].size();
+    }
+
+    std::vector<bool> seen(nrec, false);
+    for (const auto& chunk : indices) {
+        for (std::size_t g : chunk) {
+            if (g >= nrec || seen[g])
+                throw std::invalid_argument("Invalid receptor index in postfile merge.");
+            seen[g] = true;
+        }
+    }
+
+    id_table arcs = merge_ids(files, indices, nrec, "arc", "arcid");
+    id_table nets = merge_ids(files, indices, nrec, "net", "netid");
+    if (!networks.empty())
+        move_ids(arcs, nets, networks);
+
+    std::map<std::string, std::size_t> lengths{{"rec", nrec}};
+    if (!arcs.rows.empty())
+        lengths["arc"] = arcs.rows.size();
+    if (!nets.rows.empty())
+        lengths["net"] = nets.rows.size();
+
+    nc_file out = create_like(files.front(), output, lengths);
+
+    // Define the network table if no input has one.
+    int varid;
+    bool addNets = nets.present && nc_inq_varid(out.id(), "netid", &varid) != NC_NOERR;
+    if (addNets)
+        define_ids(out, "arcid", "net", "netid", nets.rows.size());
+
+    for (const auto& var : inquire_vars(files.front().id()))
+    {
+        int outvarid;
+        check(nc_inq_varid(out.id(), var.name.c_str(), &outvarid), var.name);
+
+        // Receptor numbers and identifiers are rewritten in global order.
+        if (var.name == "rec") {
+            std::vector<int> values(nrec);
+            std::iota(values.begin(), values.end(), 1);
+            if (!values.empty())
+                check(nc_put_var_int(out.id(), outvarid, values.data()), var.name);
+            continue;
+        }
+        if ((var.name == "arc" || var.name == "arcid") && arcs.present) {
+            if (var.name == "arc")
+                write_ids(out, arcs, "arc", "arcid");
+            continue;
+        }
+        if ((var.name == "net" || var.name == "netid") && nets.present) {
+            if (var.name == "net")
+                write_ids(out, nets, "net", "netid");
+            continue;
+        }
+
+        auto pos = std::find(var.dims.begin(), var.dims.end(), "rec");
+        if (pos == var.dims.end()) {
+            copy_var(files.front(), var, out, outvarid);
+            continue;
+        }
+
+        std::size_t m = static_cast<std::size_t>(std::distance(var.dims.begin(), pos));
+        auto shape0 = var_shape(files.front().id(), var);
+
+        for (std::size_t i = 0; i < files.size(); ++i) {
+            var_info invar = var;
+            check(nc_inq_varid(files[i].id(), var.name.c_str(), &invar.id), inputs[i]);
+
+            auto shape = var_shape(files[i].id(), invar);
+            for (std::size_t k = 0; k < shape.size(); ++k) {
+                if (k != m && shape[k] != shape0[k])
+                    throw std::runtime_error(fmt::format("{}: dimension mismatch for {}", inputs[i], var.name));
+            }
+
+            copy_runs(files[i], invar, out, outvarid, m, shape, make_runs(indices[i]));
+        }
+    }
+
+    if (addNets)
+        write_ids(out, nets, "net", "netid");
+
+    out.close();
+}
+
+void merge_time(const std::vector<std::string>& inputs, const std::string& output)
+{
+    if (inputs.empty())
+        throw std::invalid_argument("Postfile merge requires at least one input.");
+
+    std::vector<nc_file> files;
+    files.reserve(inputs.size());
+    for (const auto& path : inputs)
+        files.emplace_back(path, NC_NOWRITE);
+
+    // Keep the time steps of each input which follow the last time step of
+    // the previous inputs.
+    std::vector<std::vector<index_run>> runs(files.size());
+    std::size_t ntime = 0;
+    std::optional<long long> last;
+
+    for (std::size_t i = 0; i < files.size(); ++i) {
+        int varid;
+        check(nc_inq_varid(files[i].id(), "time", &varid), inputs[i]);
+
+        std::vector<long long> times(dim_length(files[i].id(), "time"));
+        if (times.empty())
+            continue;
+
+        check(nc_get_var_longlong(files[i].id(), varid, times.data()), inputs[i]);
+
+        std::size_t first = 0;
+        if (last)
+            first = static_cast<std::size_t>(std::distance(times.begin(),
+                std::upper_bound(times.begin(), times.end(), *last)));
+
+        if (first < times.size()) {
+            runs[i].push_back(index_run{first, ntime, times.size() - first});
+            ntime += times.size() - first;
+            last = times.back();
+        }
+    }
+
+    nc_file out = create_like(files.front(), output, {{"time", ntime}});
+
+    for (const auto& var : inquire_vars(files.front().id()))
+    {
+        int outvarid;
+        check(nc_inq_varid(out.id(), var.name.c_str(), &outvarid), var.name);
+
+        auto pos = std::find(var.dims.begin(), var.dims.end(), "time");
+        if (pos == var.dims.end()) {
+            copy_var(files.front(), var, out, outvarid);
+            continue;
+        }
+
+        std::size_t m = static_cast<std::size_t>(std::distance(var.dims.begin(), pos));
+        auto shape0 = var_shape(files.front().id(), var);
+
+        for (std::size_t i = 0; i < files.size(); ++i) {
+            var_info invar = var;
+            check(nc_inq_varid(files[i].id(), var.name.c_str(), &invar.id), inputs[i]);
+
+            auto shape = var_shape(files[i].id(), invar);
+            for (std::size_t k = 0; k < shape.size(); ++k) {
+                if (k != m && shape[k] != shape0[k])
+                    throw std::runtime_error(fmt::format("{}: dimension mismatch for {}", inputs[i], var.name));
+            }
+
+            copy_runs(files[i], invar, out, outvarid, m, shape, runs[i]);
+        }
+    }
+
+    out.close();
+}
+
+} // namespace ncpost
@@ -0,0 +1,40 @@
+// Copyright 2020 Dow, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace ncpost {
+
+// Merge postfiles written by AERMOD runs over disjoint receptor subsets.
+// indices[i] holds the global receptor index of each receptor in inputs[i],
+// in file order. Receptor variables are scattered into global order, and the
+// arcid/netid tables are rebuilt in order of first appearance. Receptors
+// flagged in networks (by global index) were written as discrete receptors
+// with their netid as arcid; their ids are moved to the netid table.
+void merge_receptors(const std::vector<std::string>& inputs,
+                     const std::vector<std::vector<std::size_t>>& indices,
+                     const std::string& output,
+                     const std::vector<bool>& networks = {});
+
+// Merge postfiles written by AERMOD runs over consecutive time segments of
+// the same receptors. Time steps which repeat those of an earlier input, i.e.
+// the overlap at the start of each segment, are discarded.
+void merge_time(const std::vector<std::string>& inputs, const std::string& output);
+
+} // namespace ncpost
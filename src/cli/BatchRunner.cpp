@@ -0,0 +1,108 @@
+// Copyright 2020 Dow, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "BatchRunner.h"
+
+#include <algorithm>
+
+#include <boost/log/trivial.hpp>
+#include <boost/log/attributes/scoped_attribute.hpp>
+
+BatchRunner::BatchRunner(const QString& program, int maxJobs, QObject *parent)
+    : QObject(parent), program_(program), maxJobs_(std::max(1, maxJobs))
+{
+}
+
+void BatchRunner::addJob(const QString& name, const QString& path)
+{
+    queue_.push_back({name, path});
+}
+
+void BatchRunner::start()
+{
+    if (queue_.empty() && running_ == 0) {
+        emit finished();
+        return;
+    }
+
+    launchNext();
+}
+
+int BatchRunner::failedCount() const
+{
+    return failed_;
+}
+
+void BatchRunner::launchNext()
+{
+    BOOST_LOG_SCOPED_THREAD_TAG("Source", "Model");
+
+    while (running_ < maxJobs_ && !queue_.empty())
+    {
+        Job job = queue_.front();
+        queue_.pop_front();
+
+        auto process = new QProcess(this);
+        process->setProgram(program_);
+        process->setWorkingDirectory(job.path);
+        process->setProcessChannelMode(QProcess::ForwardedErrorChannel);
+        process->setStandardOutputFile(QProcess::nullDevice());
+
+        connect(process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
+                this, [=](int exitCode, QProcess::ExitStatus exitStatus) {
+            // AERMOD returns a nonzero exit code on fatal input or runtime errors.
+            onProcessFinished(process, job, exitStatus == QProcess::NormalExit && exitCode == 0);
+        });
+
+        connect(process, &QProcess::errorOccurred, this, [=](QProcess::ProcessError error) {
+            // The finished() signal is not emitted if the process failed to start.
+            if (error == QProcess::FailedToStart)
+                onProcessFinished(process, job, false);
+        });
+
+        BOOST_LOG_TRIVIAL(info) << "Starting " << job.name.toStdString();
+        running_++;
+        process->start();
+    }
+}
+
+void BatchRunner::onProcessFinished(QProcess *process, const Job& job, bool ok)
+{
+    BOOST_LOG_SCOPED_THREAD_TAG("Source", "Model");
+
+    if (ok) {
+        BOOST_LOG_TRIVIAL(info) << "Finished " << job.name.toStdString();
+    }
+    else if (process->error() == QProcess::FailedToStart || process->exitStatus() == QProcess::CrashExit) {
+        BOOST_LOG_TRIVIAL(error) << "Failed " << job.name.toStdString() << ": "
+                                 << process->errorString().toStdString();
+        failed_++;
+    }
+    else {
+        BOOST_LOG_TRIVIAL(error) << "Failed " << job.name.toStdString() << ": exit code "
+                                 << process->exitCode();
+        failed_++;
+    }
+
+    process->deleteLater();
+    running_--;
+
+    emit jobFinished(job.name, job.path, ok);
+
+    launchNext();
+
+    if (running_ == 0 && queue_.empty())
+        emit finished();
+}
@@ -0,0 +1,56 @@
+// Copyright 2020 Dow, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+
+#include <QObject>
+#include <QProcess>
+#include <QString>
+
+#include <deque>
+#include <vector>
+
+// Runs AERMOD in each job directory with a limit on concurrent processes.
+
+class BatchRunner : public QObject
+{
+    Q_OBJECT
+
+public:
+    BatchRunner(const QString& program, int maxJobs, QObject *parent = nullptr);
+
+    void addJob(const QString& name, const QString& path);
+    void start();
+    int failedCount() const;
+
+signals:
+    void jobFinished(const QString& name, const QString& path, bool ok);
+    void finished();
+
+private:
+    struct Job {
+        QString name;
+        QString path;
+    };
+
+    void launchNext();
+    void onProcessFinished(QProcess *process, const Job& job, bool ok);
+
+    QString program_;
+    int maxJobs_;
+    int running_ = 0;
+    int failed_ = 0;
+    std::deque<Job> queue_;
+};
@@ -0,0 +1,390 @@
+// Copyright 2020 Dow, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+// sofea-cli: headless batch runner for SOFEA projects.
+//
+//   sofea-cli [options] project.sofea
+//
+// Input files for the selected scenarios are written to a time-stamped
+// directory per scenario under the output directory, and AERMOD is run in
+// each with a limit on concurrent processes. Receptor statistics can be
+// calculated from the postfiles once the runs have finished. Receptor
+// elevations and hill heights can be set from a DEM before the input files
+// are written.
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QPointF>
+#include <QStandardPaths>
+#include <QThread>
+#include <QTimer>
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include <boost/log/trivial.hpp>
+#include <boost/log/attributes/scoped_attribute.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
+
+#include <cereal/archives/json.hpp>
+#include <fmt/format.h>
+
+#include "BatchRunner.h"
+#include "ReceptorVisitor.h"
+#include "analysis/Analysis.h"
+#include "core/Common.h"
+#include "core/CpuTerrainProcessor.h"
+#include "core/Decomposition.h"
+#include "core/MeteorologyCache.h"
+#include "core/Projection.h"
+#include "core/Raster.h"
+#include "core/Scenario.h"
+#include "core/Serialization.h"
+#include "core/TaskControl.h"
+#include "core/Validation.h"
+
+namespace {
+
+bool loadProject(const QString& path, boost::ptr_vector<Scenario>& scenarios)
+{
+    BOOST_LOG_SCOPED_THREAD_TAG("Source", "Project");
+
+    std::ifstream ifs(path.toStdString());
+    if (!ifs) {
+        BOOST_LOG_TRIVIAL(error) << "Unable to open " << path.toStdString();
+        return false;
+    }
+
+    try {
+        // Simple check for JSON: first character is '{'
+        if (ifs.peek() != 0x7b) {
+            BOOST_LOG_TRIVIAL(error) << "Unsupported project format";
+            return false;
+        }
+        cereal::JSONInputArchive ia(ifs);
+        ia(scenarios);
+    } catch (const cereal::Exception &e) {
+        BOOST_LOG_TRIVIAL(error) << "Parse error: " << e.what();
+        return false;
+    }
+
+    return true;
+}
+
+// Write the average and maximum at each receptor for every output type,
+// averaging period and source group in the postfile.
+void writeReceptorStats(const std::string& postfile, const std::string& csvfile)
+{
+    ncpost::analysis analysis(postfile);
+    auto receptors = analysis.receptors();
+
+    std::ofstream ofs(csvfile);
+    ofs << "type,ave,grp,rec,x,y,avg,max\n";
+
+    ncpost::options::statistics statopts;
+    statopts.calc_avg = true;
+    statopts.calc_max = true;
+
+    for (const auto& type : analysis.output_types()) {
+        for (int ave : analysis.averaging_periods()) {
+            for (const auto& grp : analysis.source_groups()) {
+                ncpost::options::general opts;
+                opts.output_type = type.name;
+                opts.averaging_period = ave;
+                opts.source_group = grp;
+
+                ncpost::statistics_type out;
+                analysis.calc_receptor_stats(opts, statopts, out);
+
+                for (std::size_t i = 0; i < receptors.size(); ++i) {
+                    const auto& r = receptors[i];
+                    ofs << fmt::format("{},{},{},{},{:.2f},{:.2f},{:.6g},{:.6g}\n",
+                                       type.name, ave, grp, r.id, r.x, r.y,
+                                       out.avg.at(i), out.max.at(i));
+                }
+            }
+        }
+    }
+}
+
+// Set receptor elevations and hill heights from a GeoTIFF DEM. The whole DEM
+// is searched, so it should be clipped to the modeling domain, as for AERMAP.
+// It is read into memory, or in tiles if streaming is requested or it is too
+// large for memory. sofea-cli is built without OpenCL and always uses the
+// CPU processors.
+void setReceptorElevations(Scenario& s, const std::string& demfile, bool streaming)
+{
+    using namespace Projection;
+
+    BOOST_LOG_SCOPED_THREAD_TAG("Source", "Terrain");
+
+    if (s.conversionCode.empty() || s.hUnitsCode.empty() || s.hDatumCode.empty())
+        throw std::runtime_error("Projection is not set");
+
+    auto conv = createConversion(s.conversionCode);
+    auto gcrs = createGeodeticCRS(s.hDatumCode);
+    auto pcrs = createProjectedCRS(gcrs, conv, s.hUnitsCode);
+
+    auto dataset = std::make_shared<Raster::Dataset>(demfile, "GTiff");
+    const Raster::GeoTransform gt = dataset->geoTransform();
+    const auto dims = dataset->dimensions();
+
+    ProjectedExtent extent;
+    extent.xmin = gt.ulx;
+    extent.xmax = gt.ulx + dims[0] * gt.xres;
+    extent.ymin = gt.uly + dims[1] * gt.yres;
+    extent.ymax = gt.uly;
+    dataset->setBoundingBox(dataset->projection(), extent);
+
+    // Receptor coordinates in node order, transformed to the DEM projection.
+    std::vector<double> x, y;
+    for (const ReceptorGroup& group : s.receptors) {
+        for (const QPointF& p : boost::apply_visitor(ReceptorGroupPointsVisitor(), group)) {
+            x.push_back(p.x());
+            y.push_back(p.y());
+        }
+    }
+
+    Pipeline pipeline(pcrs, dataset->projection());
+    int err = pipeline.forward({ x.data(), x.size() }, { y.data(), y.size() });
+    if (err != 0)
+        throw std::runtime_error(Pipeline::errorString(err));
+
+    TaskControl control;
+    TerrainResult result;
+    if (streaming || StreamingTerrainProcessor::preferred(*dataset)) {
+        BOOST_LOG_TRIVIAL(info) << "Reading " << demfile << " in tiles";
+        auto source = std::make_shared<const DatasetTileSource>(dataset);
+        StreamingTerrainProcessor processor(source);
+        result = processor.process(control, std::move(x), std::move(y)).get();
+    }
+    else {
+        std::vector<float> values = dataset->readBlocks(control).get();
+        auto dem = std::make_shared<const TerrainGrid>(TerrainGrid::fromDataset(*dataset, std::move(values)));
+        CpuTerrainProcessor processor(dem);
+        result = processor.process(control, std::move(x), std::move(y)).get();
+    }
+
+    // Flagpole heights are unchanged.
+    const std::vector<double> zFlag;
+    std::size_t offset = 0;
+    for (ReceptorGroup& group : s.receptors) {
+        const std::size_t n = boost::apply_visitor(ReceptorNodeCountVisitor(), group);
+        const auto first = static_cast<std::ptrdiff_t>(offset);
+        const auto last = static_cast<std::ptrdiff_t>(offset + n);
+        std::vector<double> zElev(result.zElev.begin() + first, result.zElev.begin() + last);
+        std::vector<double> zHill(result.zHill.begin() + first, result.zHill.begin() + last);
+        if (!boost::apply_visitor(SetReceptorGroupElevations(zElev, zHill, zFlag), group))
+            throw std::runtime_error("Failed to set receptor elevations");
+        offset += n;
+    }
+
+    BOOST_LOG_TRIVIAL(info) << fmt::format("Set elevations for {} receptors in {}", offset, s.name);
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setOrganizationName("Dow AgroSciences");
+    QCoreApplication::setOrganizationDomain("dow.com");
+    QCoreApplication::setApplicationName("SOFEA");
+    QCoreApplication::setApplicationVersion(SOFEA_VERSION_STRING);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Headless batch runner for SOFEA projects.");
+    parser.addHelpOption();
+    parser.addVersionOption();
+    parser.addPositionalArgument("project", "SOFEA project file (*.sofea).");
+
+    QCommandLineOption scenarioOption({"s", "scenario"},
+        "Run the named scenario. May be repeated; all scenarios are run if omitted.", "name");
+    QCommandLineOption outputOption({"o", "output"},
+        "Output directory. Defaults to the current directory.", "dir", QDir::currentPath());
+    QCommandLineOption jobsOption({"j", "jobs"},
+        "Maximum number of concurrent AERMOD processes.", "n",
+        QString::number(std::max(1, QThread::idealThreadCount())));
+    QCommandLineOption aermodOption("aermod",
+        "Path to the AERMOD executable.", "path",
+        QDir::cleanPath(QCoreApplication::applicationDirPath() + QDir::separator() + AERMOD_EXE));
+    QCommandLineOption inputsOnlyOption("inputs-only",
+        "Write input files without running AERMOD.");
+    QCommandLineOption analyzeOption("analyze",
+        "Write receptor statistics (receptor_stats.csv) for each completed run.");
+    QCommandLineOption emissionPeriodOption("emission-period",
+        "Simulate only the days with emissions, extended by the longest averaging period.");
+    QCommandLineOption demOption("dem",
+        "Set receptor elevations and hill heights from a GeoTIFF DEM.", "path");
+    QCommandLineOption streamingOption("streaming",
+        "Read the DEM in tiles instead of loading it into memory.");
+    QCommandLineOption checkTerrainOption("check-terrain",
+        "Check the terrain processors against a scan of every DEM node, and exit.");
+
+    parser.addOptions({scenarioOption, outputOption, jobsOption, aermodOption,
+                       inputsOnlyOption, analyzeOption, emissionPeriodOption, demOption, streamingOption,
+                       checkTerrainOption});
+    parser.process(app);
+
+    BOOST_LOG_SCOPED_THREAD_TAG("Source", "Main");
+
+    if (parser.isSet(checkTerrainOption)) {
+        const std::vector<std::string> mismatches = checkTerrainProcessors();
+        for (const std::string& mismatch : mismatches)
+            BOOST_LOG_TRIVIAL(error) << mismatch;
+        return mismatches.empty() ? 0 : 1;
+    }
+
+    const QStringList args = parser.positionalArguments();
+    if (args.size() != 1)
+        parser.showHelp(1);
+
+    bool ok = false;
+    int maxJobs = parser.value(jobsOption).toInt(&ok);
+    if (!ok || maxJobs < 1) {
+        std::cerr << "Invalid number of jobs: " << parser.value(jobsOption).toStdString() << std::endl;
+        return 1;
+    }
+
+    QString appPath = app.applicationDirPath();
+    QString appCachePath = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    QString projDataPath = QDir::cleanPath(appPath + QDir::separator() + SOFEA_PROJ_DATA_PATH);
+    Projection::setSearchPath(projDataPath.toStdString());
+    Projection::setCacheDirectory(appCachePath.toStdString());
+
+    QString metCachePath = QDir::cleanPath(appCachePath + QDir::separator() + "meteorology");
+    MeteorologyCache::setCacheDirectory(metCachePath.toStdString());
+
+    // Resolve paths before the working directory changes.
+    QString outputDir = QFileInfo(parser.value(outputOption)).absoluteFilePath();
+    QString aermodPath = QFileInfo(parser.value(aermodOption)).absoluteFilePath();
+    QString demPath;
+    if (parser.isSet(demOption))
+        demPath = QFileInfo(parser.value(demOption)).absoluteFilePath();
+    QFileInfo projectInfo(args.first());
+
+    if (!QDir().mkpath(outputDir)) {
+        BOOST_LOG_TRIVIAL(error) << "Unable to create " << outputDir.toStdString();
+        return 1;
+    }
+
+    // Relative paths in the project are resolved from the project directory.
+    QDir::setCurrent(projectInfo.canonicalPath());
+
+    boost::ptr_vector<Scenario> scenarios;
+    if (!loadProject(projectInfo.absoluteFilePath(), scenarios))
+        return 1;
+
+    // Select scenarios by name.
+    const QStringList names = parser.values(scenarioOption);
+    std::vector<Scenario *> selected;
+    for (Scenario& s : scenarios) {
+        if (names.isEmpty() || names.contains(QString::fromStdString(s.name)))
+            selected.push_back(&s);
+    }
+
+    for (const QString& name : names) {
+        bool found = std::any_of(scenarios.begin(), scenarios.end(), [&](const Scenario& s) {
+            return QString::fromStdString(s.name) == name;
+        });
+        if (!found) {
+            BOOST_LOG_TRIVIAL(error) << "Scenario not found: " << name.toStdString();
+            return 1;
+        }
+    }
+
+    // Generate the input files.
+    BatchRunner runner(aermodPath, maxJobs);
+    QString timestamp = QDateTime::currentDateTime().toString("yyyyMMddhhmmsszzz");
+
+    for (Scenario *s : selected)
+    {
+        if (!demPath.isEmpty()) {
+            try {
+                setReceptorElevations(*s, demPath.toStdString(), parser.isSet(streamingOption));
+            } catch (const std::exception& e) {
+                BOOST_LOG_TRIVIAL(error) << "Failed to set receptor elevations for " << s->name << ": " << e.what();
+                return 1;
+            }
+        }
+
+        Validation::ValidateScenario validate(*s);
+
+        QString name = QString::fromStdString(s->name);
+        QString jobDir = QDir::cleanPath(outputDir + QDir::separator() + name + "_" + timestamp);
+        if (!QDir().mkpath(jobDir)) {
+            BOOST_LOG_TRIVIAL(error) << "Unable to create " << jobDir.toStdString();
+            return 1;
+        }
+
+        InputOptions opts;
+        if (parser.isSet(emissionPeriodOption)) {
+            int extend = 0;
+            for (int period : s->averagingPeriods)
+                extend = std::max(extend, period);
+            TimeSegment period = emissionPeriod(*s, extend);
+            opts.startTime = period.start;
+            opts.endTime = period.end;
+        }
+
+        try {
+            s->writeFluxFile(QDir(jobDir).filePath("flux.dat").toStdString(), opts);
+            s->writeInputFile(QDir(jobDir).filePath("aermod.inp").toStdString(), opts);
+        } catch (const std::exception& e) {
+            BOOST_LOG_TRIVIAL(error) << "Failed to write input files for " << s->name << ": " << e.what();
+            return 1;
+        }
+
+        BOOST_LOG_TRIVIAL(info) << "Wrote input files to " << jobDir.toStdString();
+        runner.addJob(name, jobDir);
+    }
+
+    if (parser.isSet(inputsOnlyOption))
+        return 0;
+
+    // Run AERMOD and post-process.
+    bool analyze = parser.isSet(analyzeOption);
+    int analysisErrors = 0;
+
+    QObject::connect(&runner, &BatchRunner::jobFinished, [&](const QString& name, const QString& path, bool ok) {
+        if (!ok || !analyze)
+            return;
+
+        BOOST_LOG_SCOPED_THREAD_TAG("Source", "Analysis");
+        try {
+            std::string postfile = QDir(path).filePath("postfile.nc").toStdString();
+            std::string csvfile = QDir(path).filePath("receptor_stats.csv").toStdString();
+            writeReceptorStats(postfile, csvfile);
+            BOOST_LOG_TRIVIAL(info) << "Wrote " << csvfile;
+        } catch (const std::exception& e) {
+            BOOST_LOG_TRIVIAL(error) << "Analysis failed for " << name.toStdString() << ": " << e.what();
+            analysisErrors++;
+        }
+    });
+
+    QObject::connect(&runner, &BatchRunner::finished, [&]() {
+        app.exit(runner.failedCount() + analysisErrors > 0 ? 1 : 0);
+    });
+
+    // Start once the event loop is running.
+    QTimer::singleShot(0, &runner, &BatchRunner::start);
+
+    return app.exec();
+}
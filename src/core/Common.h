@@ -19,7 +19,11 @@
 #define AERMOD_VERSION_STRING "18081"
 #define ISCST3_VERSION_STRING "02035"
 
+#ifdef _WIN32
 #define AERMOD_EXE "sofea_aermod.exe"
+#else
+#define AERMOD_EXE "sofea_aermod"
+#endif
 
 #define SOFEA_DOCUMENTATION_URL "https://sofea-model.github.io/user-guide/index.html"
 
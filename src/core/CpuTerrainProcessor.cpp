@@ -0,0 +1,999 @@
+// Copyright 2020 Dow, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#include "core/CpuTerrainProcessor.h"
+#include "core/Raster.h"
+#include "core/SystemResources.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <exception>
+#include <limits>
+#include <list>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+
+#include <boost/log/trivial.hpp>
+#include <boost/log/attributes/scoped_attribute.hpp>
+
+#include <fmt/format.h>
+
+namespace {
+
+// AERMAP critical hill height criterion: a DEM node counts if it rises at
+// least 10% of its horizontal distance above the receptor. Compared in squared
+// form, which avoids the square root and keeps the row scan branch free.
+inline bool isSteep(double dz, double d2)
+{
+    return dz >= 0 && dz * dz >= 0.01 * d2;
+}
+
+// Highest steep node in a DEM row, or hc if it is higher.
+inline double scanRow(const float *z, const double *xs, int n, double xr, double dy2, double zr, double hc)
+{
+    for (int i = 0; i < n; ++i) {
+        const double zi = z[i];
+        const double dx = xs[i] - xr;
+        hc = std::max(hc, isSteep(zi - zr, dx * dx + dy2) ? zi : hc);
+    }
+    return hc;
+}
+
+// Squared distance from the receptor to the nearest node centre in the
+// inclusive node range. Uses the same node coordinates as the scan, so that
+// the bound holds exactly under rounding.
+inline double minDistance2(const double *xs, const double *ys, int i0, int i1, int j0, int j1, double x, double y)
+{
+    const auto [xlo, xhi] = std::minmax(xs[i0], xs[i1]);
+    const auto [ylo, yhi] = std::minmax(ys[j0], ys[j1]);
+    const double dx = x < xlo ? xlo - x : (x > xhi ? x - xhi : 0.0);
+    const double dy = y < ylo ? ylo - y : (y > yhi ? y - yhi : 0.0);
+    return dx * dx + dy * dy;
+}
+
+// Add coarser levels to the pyramid, each holding the maximum of 2 x 2 tiles
+// of the level below, until the top level is at most 2 x 2 tiles.
+void coarsen(std::vector<TerrainPyramidLevel>& pyramid)
+{
+    while (pyramid.back().nx > 2 || pyramid.back().ny > 2) {
+        const TerrainPyramidLevel& fine = pyramid.back();
+        TerrainPyramidLevel coarse;
+        coarse.span = fine.span * 2;
+        coarse.nx = (fine.nx + 1) / 2;
+        coarse.ny = (fine.ny + 1) / 2;
+        coarse.zmax.assign(static_cast<std::size_t>(coarse.nx) * coarse.ny, std::numeric_limits<float>::lowest());
+
+        for (int tj = 0; tj < fine.ny; ++tj) {
+            for (int ti = 0; ti < fine.nx; ++ti) {
+                float& m = coarse.zmax[static_cast<std::size_t>(tj / 2) * coarse.nx + ti / 2];
+                m = std::max(m, fine.zmax[static_cast<std::size_t>(tj) * fine.nx + ti]);
+            }
+        }
+
+        pyramid.push_back(std::move(coarse));
+    }
+}
+
+// Critical hill height search over a pyramid of an nx x ny node DEM. Tiles
+// are visited in order of decreasing maximum, and skipped when their maximum
+// cannot satisfy the slope criterion at the nearest node of the tile, or
+// cannot exceed the current height. Leaf tiles that remain are passed to
+// scanLeaf(ti, tj, hc), which returns the updated height.
+template <typename ScanLeaf>
+double searchPyramid(const std::vector<TerrainPyramidLevel>& pyramid,
+                     const double *xs, const double *ys, int nx, int ny,
+                     double x, double y, double zr, ScanLeaf scanLeaf)
+{
+    struct Tile {
+        float zmax;
+        int level;
+        int ti;
+        int tj;
+        bool operator<(const Tile& other) const { return zmax < other.zmax; }
+    };
+
+    std::vector<Tile> heap;
+    const int top = static_cast<int>(pyramid.size()) - 1;
+    const TerrainPyramidLevel& root = pyramid[top];
+    for (int tj = 0; tj < root.ny; ++tj) {
+        for (int ti = 0; ti < root.nx; ++ti)
+            heap.push_back(Tile{root.zmax[static_cast<std::size_t>(tj) * root.nx + ti], top, ti, tj});
+    }
+    std::make_heap(heap.begin(), heap.end());
+
+    double hc = zr;
+    while (!heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end());
+        const Tile tile = heap.back();
+        heap.pop_back();
+
+        // Remaining tiles are no higher than this one.
+        if (tile.zmax <= hc)
+            break;
+
+        const TerrainPyramidLevel& level = pyramid[tile.level];
+        const int i0 = tile.ti * level.span;
+        const int j0 = tile.tj * level.span;
+        const int i1 = std::min(nx, i0 + level.span) - 1;
+        const int j1 = std::min(ny, j0 + level.span) - 1;
+        if (!isSteep(tile.zmax - zr, minDistance2(xs, ys, i0, i1, j0, j1, x, y)))
+            continue;
+
+        if (tile.level > 0) {
+            const TerrainPyramidLevel& fine = pyramid[tile.level - 1];
+            for (int tj = 2 * tile.tj; tj < std::min(fine.ny, 2 * tile.tj + 2); ++tj) {
+                for (int ti = 2 * tile.ti; ti < std::min(fine.nx, 2 * tile.ti + 2); ++ti) {
+                    heap.push_back(Tile{fine.zmax[static_cast<std::size_t>(tj) * fine.nx + ti], tile.level - 1, ti, tj});
+                    std::push_heap(heap.begin(), heap.end());
+                }
+            }
+            continue;
+        }
+
+        hc = scanLeaf(tile.ti, tile.tj, hc);
+    }
+
+    return hc;
+}
+
+unsigned int threadCount(unsigned int requested, std::size_t n, std::size_t chunkSize)
+{
+    unsigned int nthreads = requested > 0 ? requested : std::thread::hardware_concurrency();
+    return static_cast<unsigned int>(std::clamp<std::size_t>(nthreads, 1, n / chunkSize + 1));
+}
+
+// Call fn(first, last) for chunks of [0, n) on a pool of worker threads.
+// Workers take chunks from a shared counter, so that uneven chunks are
+// balanced. Progress is reported from this thread only. Returns early if an
+// interrupt is requested; exceptions from workers are rethrown.
+template <typename Fn>
+void parallelFor(TaskControl& control, std::size_t n, std::size_t chunkSize, unsigned int nthreads, Fn fn)
+{
+    std::atomic<std::size_t> next{0};
+    std::atomic<std::size_t> done{0};
+    std::atomic_bool failed{false};
+
+    auto worker = [&]() {
+        try {
+            while (!control.interruptRequested() && !failed) {
+                const std::size_t first = next.fetch_add(chunkSize);
+                if (first >= n)
+                    return;
+
+                const std::size_t last = std::min(n, first + chunkSize);
+                fn(first, last);
+                done += last - first;
+            }
+        }
+        catch (...) {
+            failed = true;
+            throw;
+        }
+    };
+
+    std::vector<std::future<void>> futures;
+    futures.reserve(nthreads);
+    for (unsigned int i = 0; i < nthreads; ++i)
+        futures.push_back(std::async(std::launch::async, worker));
+
+    using namespace std::chrono_literals;
+    std::exception_ptr error;
+    for (auto& f : futures) {
+        while (f.wait_for(100ms) != std::future_status::ready)
+            control.progress(static_cast<double>(done) / static_cast<double>(n));
+        try {
+            f.get();
+        }
+        catch (...) {
+            if (!error)
+                error = std::current_exception();
+        }
+    }
+
+    if (error)
+        std::rethrow_exception(error);
+}
+
+// Bilinear interpolation between node centres, clamped to the edge nodes.
+// Equivalent to an OpenCL image read with CLK_FILTER_LINEAR and
+// CLK_ADDRESS_CLAMP_TO_EDGE. Node values are given by at(i, j).
+template <typename At>
+double bilinear(const TerrainGrid& grid, double x, double y, At at)
+{
+    const double u = (x - grid.x0) / grid.xres - 0.5;
+    const double v = (y - grid.y0) / grid.yres - 0.5;
+    const double fu = std::floor(u);
+    const double fv = std::floor(v);
+    const double a = u - fu;
+    const double b = v - fv;
+
+    auto clampi = [](double value, int n) {
+        return static_cast<int>(std::clamp(value, 0.0, static_cast<double>(n - 1)));
+    };
+
+    const int i0 = clampi(fu, grid.nx);
+    const int i1 = clampi(fu + 1, grid.nx);
+    const int j0 = clampi(fv, grid.ny);
+    const int j1 = clampi(fv + 1, grid.ny);
+
+    return (1 - a) * (1 - b) * at(i0, j0) + a * (1 - b) * at(i1, j0) +
+           (1 - a) * b * at(i0, j1) + a * b * at(i1, j1);
+}
+
+// Geometry of the dataset window, without values.
+TerrainGrid datasetGeometry(const Raster::Dataset& dataset)
+{
+    const Raster::GeoTransform gt = dataset.geoTransform();
+    const Raster::Window window = dataset.window();
+
+    if (gt.xrot != 0 || gt.yrot != 0)
+        throw std::runtime_error("Rotated rasters are not supported");
+
+    if (window.nx() <= 0 || window.ny() <= 0)
+        throw std::runtime_error("Invalid window size");
+
+    TerrainGrid grid;
+    grid.nx = window.nx();
+    grid.ny = window.ny();
+    grid.xres = gt.xres;
+    grid.yres = gt.yres;
+    grid.x0 = gt.ulx + window.xmin * gt.xres;
+    grid.y0 = gt.uly + window.ymax * gt.yres; // ymax is the top row offset
+    return grid;
+}
+
+} // namespace
+
+//-----------------------------------------------------------------------------
+// TerrainGrid
+//-----------------------------------------------------------------------------
+
+TerrainGrid TerrainGrid::fromDataset(const Raster::Dataset& dataset, std::vector<float> values)
+{
+    // Values are the rows of the dataset window, starting at the top.
+    TerrainGrid grid = datasetGeometry(dataset);
+
+    if (values.size() != static_cast<std::size_t>(grid.nx) * grid.ny)
+        throw std::runtime_error("Invalid window size");
+
+    grid.values = std::move(values);
+    return grid;
+}
+
+double TerrainGrid::elevation(double x, double y) const
+{
+    return bilinear(*this, x, y, [this](int i, int j) { return at(i, j); });
+}
+
+//-----------------------------------------------------------------------------
+// DatasetTileSource
+//-----------------------------------------------------------------------------
+
+DatasetTileSource::DatasetTileSource(std::shared_ptr<const Raster::Dataset> dataset)
+    : dataset_(std::move(dataset))
+{
+    if (!dataset_)
+        throw std::runtime_error("Invalid dataset");
+
+    geometry_ = datasetGeometry(*dataset_);
+}
+
+TerrainGrid DatasetTileSource::geometry() const
+{
+    return geometry_;
+}
+
+std::vector<float> DatasetTileSource::read(int i0, int j0, int nx, int ny) const
+{
+    const Raster::Window window = dataset_->window();
+    return dataset_->readWindow(window.xmin + i0, window.ymax + j0, nx, ny);
+}
+
+//-----------------------------------------------------------------------------
+// CpuTerrainProcessor
+//-----------------------------------------------------------------------------
+
+CpuTerrainProcessor::CpuTerrainProcessor(std::shared_ptr<const TerrainGrid> dem)
+    : dem_(std::move(dem))
+{
+    if (!dem_ || dem_->nx <= 0 || dem_->ny <= 0 ||
+        dem_->values.size() != static_cast<std::size_t>(dem_->nx) * dem_->ny)
+        throw std::runtime_error("Invalid DEM");
+
+    // Node centre coordinates, shared by every receptor.
+    xs_.resize(dem_->nx);
+    ys_.resize(dem_->ny);
+    for (int i = 0; i < dem_->nx; ++i)
+        xs_[i] = dem_->nodeX(i);
+    for (int j = 0; j < dem_->ny; ++j)
+        ys_[j] = dem_->nodeY(j);
+
+    buildPyramid();
+}
+
+void CpuTerrainProcessor::buildPyramid()
+{
+    // Leaf level: maximum over LeafSize x LeafSize nodes.
+    TerrainPyramidLevel leaf;
+    leaf.span = LeafSize;
+    leaf.nx = (dem_->nx + LeafSize - 1) / LeafSize;
+    leaf.ny = (dem_->ny + LeafSize - 1) / LeafSize;
+    leaf.zmax.assign(static_cast<std::size_t>(leaf.nx) * leaf.ny, std::numeric_limits<float>::lowest());
+
+    for (int j = 0; j < dem_->ny; ++j) {
+        float *row = leaf.zmax.data() + static_cast<std::size_t>(j / LeafSize) * leaf.nx;
+        for (int i = 0; i < dem_->nx; ++i) {
+            float& m = row[i / LeafSize];
+            m = std::max(m, dem_->at(i, j));
+        }
+    }
+
+    pyramid_.clear();
+    pyramid_.push_back(std::move(leaf));
+    coarsen(pyramid_);
+}
+
+void CpuTerrainProcessor::setThreadCount(unsigned int n)
+{
+    nthreads_ = n;
+}
+
+void CpuTerrainProcessor::setPruning(bool enabled)
+{
+    pruning_ = enabled;
+}
+
+double CpuTerrainProcessor::criticalHeight(double x, double y, double zr) const
+{
+    return pruning_ ? scanPyramid(x, y, zr) : scanAll(x, y, zr);
+}
+
+double CpuTerrainProcessor::scanAll(double x, double y, double zr) const
+{
+    const int nx = dem_->nx;
+    const float *z = dem_->values.data();
+
+    double hc = zr;
+    for (int j = 0; j < dem_->ny; ++j) {
+        const double dy = ys_[j] - y;
+        hc = scanRow(z + static_cast<std::size_t>(j) * nx, xs_.data(), nx, x, dy * dy, zr, hc);
+    }
+
+    return hc;
+}
+
+double CpuTerrainProcessor::scanPyramid(double x, double y, double zr) const
+{
+    const int nx = dem_->nx;
+    const int ny = dem_->ny;
+
+    // Leaf tile: scan its nodes row by row.
+    auto scanLeaf = [&](int ti, int tj, double hc) {
+        const int i0 = ti * LeafSize;
+        const int n = std::min(nx, i0 + LeafSize) - i0;
+        const int j0 = tj * LeafSize;
+        const int j1 = std::min(ny, j0 + LeafSize);
+        for (int j = j0; j < j1; ++j) {
+            const double dy = ys_[j] - y;
+            const float *z = dem_->values.data() + static_cast<std::size_t>(j) * nx + i0;
+            hc = scanRow(z, xs_.data() + i0, n, x, dy * dy, zr, hc);
+        }
+        return hc;
+    };
+
+    return searchPyramid(pyramid_, xs_.data(), ys_.data(), nx, ny, x, y, zr, scanLeaf);
+}
+
+std::future<TerrainResult> CpuTerrainProcessor::process(TaskControl& control,
+                                                        std::vector<double> x,
+                                                        std::vector<double> y) const
+{
+    return std::async(std::launch::async, [&control, this, x = std::move(x), y = std::move(y)]() {
+        return processInternal(control, this, x, y);
+    });
+}
+
+TerrainResult CpuTerrainProcessor::processInternal(TaskControl& control, const CpuTerrainProcessor *p,
+                                                   const std::vector<double>& x,
+                                                   const std::vector<double>& y)
+{
+    BOOST_LOG_SCOPED_THREAD_TAG("Source", "Terrain");
+
+    control.started();
+
+    if (x.size() != y.size()) {
+        control.finished();
+        throw std::runtime_error("Invalid receptor coordinates");
+    }
+
+    const std::size_t n = x.size();
+    TerrainResult result;
+    result.zElev.resize(n);
+    result.zHill.resize(n);
+
+    control.message(fmt::format("Processing {} receptors", n));
+
+    // Small chunks, so that receptors near the DEM edge and in the interior
+    // are balanced.
+    constexpr std::size_t chunkSize = 16;
+    const unsigned int nthreads = threadCount(p->nthreads_, n, chunkSize);
+
+    BOOST_LOG_TRIVIAL(info) << fmt::format("Processing {} receptors on {} threads, DEM {} x {}",
+                                           n, nthreads, p->dem_->nx, p->dem_->ny);
+
+    try {
+        parallelFor(control, n, chunkSize, nthreads, [&](std::size_t first, std::size_t last) {
+            for (std::size_t i = first; i < last; ++i) {
+                const double zr = p->dem_->elevation(x[i], y[i]);
+                result.zElev[i] = zr;
+                result.zHill[i] = p->criticalHeight(x[i], y[i], zr);
+            }
+        });
+    }
+    catch (...) {
+        control.finished();
+        throw;
+    }
+
+    if (control.interruptRequested()) {
+        control.finished();
+        throw std::runtime_error("Canceled");
+    }
+
+    control.progress(1.0);
+    control.finished();
+    return result;
+}
+
+//-----------------------------------------------------------------------------
+// StreamingTerrainProcessor
+//-----------------------------------------------------------------------------
+
+struct StreamingTerrainProcessor::Tile
+{
+    int i0 = 0; // first node column
+    int j0 = 0; // first node row
+    int nx = 0;
+    int ny = 0;
+    int lnx = 0; // leaves per row
+    std::vector<float> values;
+    std::vector<float> leafMax;
+    std::vector<int> leafOrder; // leaves by decreasing maximum
+
+    float at(int i, int j) const {
+        return values[static_cast<std::size_t>(j - j0) * nx + (i - i0)];
+    }
+
+    float zmax() const {
+        return leafMax[leafOrder.front()];
+    }
+};
+
+// Least recently used cache of tiles. A tile is read once, however many
+// threads request it at the same time; tiles in use remain valid after
+// they are evicted.
+class StreamingTerrainProcessor::TileCache
+{
+public:
+    TileCache(const StreamingTerrainProcessor *p, std::size_t capacity)
+        : p_(p), capacity_(capacity)
+    {}
+
+    std::size_t capacity() const {
+        return capacity_;
+    }
+
+    std::shared_ptr<const Tile> get(int k);
+
+private:
+    using Entry = std::shared_future<std::shared_ptr<const Tile>>;
+
+    struct Slot {
+        Entry entry;
+        std::list<int>::iterator pos;
+        std::uint64_t serial; // distinguishes reloads of the same tile
+    };
+
+    const StreamingTerrainProcessor *p_;
+    std::size_t capacity_;
+    std::mutex mutex_;
+    std::uint64_t serial_ = 0;
+    std::list<int> lru_; // most recent first
+    std::unordered_map<int, Slot> entries_;
+};
+
+std::shared_ptr<const StreamingTerrainProcessor::Tile> StreamingTerrainProcessor::TileCache::get(int k)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    auto it = entries_.find(k);
+    if (it != entries_.end()) {
+        lru_.splice(lru_.begin(), lru_, it->second.pos);
+        Entry entry = it->second.entry;
+        lock.unlock();
+        return entry.get();
+    }
+
+    std::promise<std::shared_ptr<const Tile>> promise;
+    Entry entry = promise.get_future().share();
+    const std::uint64_t serial = ++serial_;
+    lru_.push_front(k);
+    entries_.emplace(k, Slot{entry, lru_.begin(), serial});
+    while (entries_.size() > capacity_) {
+        entries_.erase(lru_.back());
+        lru_.pop_back();
+    }
+    lock.unlock();
+
+    try {
+        promise.set_value(p_->loadTile(k));
+    }
+    catch (...) {
+        promise.set_exception(std::current_exception());
+
+        // Read the tile again on the next request, unless the entry has
+        // already been evicted and replaced.
+        lock.lock();
+        it = entries_.find(k);
+        if (it != entries_.end() && it->second.serial == serial) {
+            lru_.erase(it->second.pos);
+            entries_.erase(it);
+        }
+        lock.unlock();
+    }
+
+    return entry.get();
+}
+
+StreamingTerrainProcessor::StreamingTerrainProcessor(std::shared_ptr<const TerrainTileSource> source,
+                                                     std::size_t cacheSize)
+    : source_(std::move(source))
+{
+    if (!source_)
+        throw std::runtime_error("Invalid DEM");
+
+    grid_ = source_->geometry();
+    grid_.values.clear();
+
+    if (grid_.nx <= 0 || grid_.ny <= 0)
+        throw std::runtime_error("Invalid DEM");
+
+    ntx_ = (grid_.nx + TileSize - 1) / TileSize;
+    nty_ = (grid_.ny + TileSize - 1) / TileSize;
+
+    // Node centre coordinates, shared by every receptor.
+    xs_.resize(grid_.nx);
+    ys_.resize(grid_.ny);
+    for (int i = 0; i < grid_.nx; ++i)
+        xs_[i] = grid_.nodeX(i);
+    for (int j = 0; j < grid_.ny; ++j)
+        ys_[j] = grid_.nodeY(j);
+
+    constexpr int nleaves = (TileSize / LeafSize) * (TileSize / LeafSize);
+    constexpr std::size_t tileBytes = TileSize * TileSize * sizeof(float) +
+                                      nleaves * (sizeof(float) + sizeof(int));
+
+    cache_ = std::make_unique<TileCache>(this, std::max<std::size_t>(cacheSize / tileBytes, 4));
+}
+
+StreamingTerrainProcessor::~StreamingTerrainProcessor() = default;
+
+bool StreamingTerrainProcessor::preferred(const Raster::Dataset& dataset)
+{
+    std::uint64_t budget = SystemResources::availableMemory() / 2;
+    if (budget == 0)
+        budget = SystemResources::totalMemory() / 4;
+    if (budget == 0)
+        return false;
+
+    // The window values, with room for the pyramid and read buffers.
+    const Raster::Window window = dataset.window();
+    const std::uint64_t nodes = static_cast<std::uint64_t>(std::max(window.nx(), 0)) *
+                                static_cast<std::uint64_t>(std::max(window.ny(), 0));
+    return nodes * sizeof(float) * 3 / 2 > budget;
+}
+
+void StreamingTerrainProcessor::setThreadCount(unsigned int n)
+{
+    nthreads_ = n;
+}
+
+std::shared_ptr<const StreamingTerrainProcessor::Tile> StreamingTerrainProcessor::loadTile(int k) const
+{
+    auto tile = std::make_shared<Tile>();
+    tile->i0 = (k % ntx_) * TileSize;
+    tile->j0 = (k / ntx_) * TileSize;
+    tile->nx = std::min(TileSize, grid_.nx - tile->i0);
+    tile->ny = std::min(TileSize, grid_.ny - tile->j0);
+    tile->values = source_->read(tile->i0, tile->j0, tile->nx, tile->ny);
+
+    if (tile->values.size() != static_cast<std::size_t>(tile->nx) * tile->ny)
+        throw std::runtime_error("Invalid tile size");
+
+    // Maximum over LeafSize x LeafSize nodes.
+    tile->lnx = (tile->nx + LeafSize - 1) / LeafSize;
+    const int lny = (tile->ny + LeafSize - 1) / LeafSize;
+    tile->leafMax.assign(static_cast<std::size_t>(tile->lnx) * lny, std::numeric_limits<float>::lowest());
+
+    for (int j = 0; j < tile->ny; ++j) {
+        float *row = tile->leafMax.data() + static_cast<std::size_t>(j / LeafSize) * tile->lnx;
+        const float *z = tile->values.data() + static_cast<std::size_t>(j) * tile->nx;
+        for (int i = 0; i < tile->nx; ++i) {
+            float& m = row[i / LeafSize];
+            m = std::max(m, z[i]);
+        }
+    }
+
+    tile->leafOrder.resize(tile->leafMax.size());
+    std::iota(tile->leafOrder.begin(), tile->leafOrder.end(), 0);
+    std::stable_sort(tile->leafOrder.begin(), tile->leafOrder.end(), [&](int a, int b) {
+        return tile->leafMax[a] > tile->leafMax[b];
+    });
+
+    return tile;
+}
+
+float StreamingTerrainProcessor::node(int i, int j) const
+{
+    return cache_->get((j / TileSize) * ntx_ + i / TileSize)->at(i, j);
+}
+
+double StreamingTerrainProcessor::elevation(double x, double y) const
+{
+    return bilinear(grid_, x, y, [this](int i, int j) { return node(i, j); });
+}
+
+double StreamingTerrainProcessor::criticalHeight(double x, double y, double zr) const
+{
+    std::shared_ptr<const std::vector<TerrainPyramidLevel>> pyramid;
+    {
+        std::lock_guard<std::mutex> lock(summaryMutex_);
+        pyramid = pyramid_;
+    }
+
+    if (!pyramid)
+        throw std::runtime_error("DEM summary not available");
+
+    return criticalHeight(*pyramid, x, y, zr);
+}
+
+double StreamingTerrainProcessor::criticalHeight(const std::vector<TerrainPyramidLevel>& pyramid,
+                                                 double x, double y, double zr) const
+{
+    // Pyramid leaves are whole tiles. Blocks of the tile are visited in order
+    // of decreasing maximum, with the same bounds as the pyramid.
+    auto scanTile = [&](int ti, int tj, double hc) {
+        auto tile = cache_->get(tj * ntx_ + ti);
+        for (int leaf : tile->leafOrder) {
+            const float zmax = tile->leafMax[leaf];
+            if (zmax <= hc)
+                break;
+
+            const int i0 = tile->i0 + (leaf % tile->lnx) * LeafSize;
+            const int j0 = tile->j0 + (leaf / tile->lnx) * LeafSize;
+            const int i1 = std::min(tile->i0 + tile->nx, i0 + LeafSize);
+            const int j1 = std::min(tile->j0 + tile->ny, j0 + LeafSize);
+            if (!isSteep(zmax - zr, minDistance2(xs_.data(), ys_.data(), i0, i1 - 1, j0, j1 - 1, x, y)))
+                continue;
+
+            for (int j = j0; j < j1; ++j) {
+                const double dy = ys_[j] - y;
+                const float *z = tile->values.data() + static_cast<std::size_t>(j - tile->j0) * tile->nx + (i0 - tile->i0);
+                hc = scanRow(z, xs_.data() + i0, i1 - i0, x, dy * dy, zr, hc);
+            }
+        }
+        return hc;
+    };
+
+    return searchPyramid(pyramid, xs_.data(), ys_.data(), grid_.nx, grid_.ny, x, y, zr, scanTile);
+}
+
+std::shared_ptr<const std::vector<TerrainPyramidLevel>> StreamingTerrainProcessor::buildSummary(TaskControl& control) const
+{
+    // Maximum elevation of each tile, from a single pass over the DEM. Only
+    // the tiles held by the cache remain in memory.
+    const std::size_t ntiles = static_cast<std::size_t>(ntx_) * nty_;
+
+    TerrainPyramidLevel level;
+    level.span = TileSize;
+    level.nx = ntx_;
+    level.ny = nty_;
+    level.zmax.assign(ntiles, std::numeric_limits<float>::lowest());
+
+    control.message(fmt::format("Scanning {} DEM tiles", ntiles));
+
+    parallelFor(control, ntiles, 1, threadCount(nthreads_, ntiles, 1), [&](std::size_t first, std::size_t last) {
+        for (std::size_t k = first; k < last; ++k)
+            level.zmax[k] = cache_->get(static_cast<int>(k))->zmax();
+    });
+
+    if (control.interruptRequested())
+        return nullptr;
+
+    auto pyramid = std::make_shared<std::vector<TerrainPyramidLevel>>();
+    pyramid->push_back(std::move(level));
+    coarsen(*pyramid);
+    return pyramid;
+}
+
+std::future<TerrainResult> StreamingTerrainProcessor::process(TaskControl& control,
+                                                              std::vector<double> x,
+                                                              std::vector<double> y) const
+{
+    return std::async(std::launch::async, [&control, this, x = std::move(x), y = std::move(y)]() {
+        return processInternal(control, this, x, y);
+    });
+}
+
+TerrainResult StreamingTerrainProcessor::processInternal(TaskControl& control, const StreamingTerrainProcessor *p,
+                                                         const std::vector<double>& x,
+                                                         const std::vector<double>& y)
+{
+    BOOST_LOG_SCOPED_THREAD_TAG("Source", "Terrain");
+
+    control.started();
+
+    if (x.size() != y.size()) {
+        control.finished();
+        throw std::runtime_error("Invalid receptor coordinates");
+    }
+
+    std::shared_ptr<const std::vector<TerrainPyramidLevel>> pyramid;
+    try {
+        std::lock_guard<std::mutex> lock(p->summaryMutex_);
+        if (!p->pyramid_)
+            p->pyramid_ = p->buildSummary(control);
+        pyramid = p->pyramid_;
+    }
+    catch (...) {
+        control.finished();
+        throw;
+    }
+
+    if (control.interruptRequested()) {
+        control.finished();
+        throw std::runtime_error("Canceled");
+    }
+
+    const std::size_t n = x.size();
+    TerrainResult result;
+    result.zElev.resize(n);
+    result.zHill.resize(n);
+
+    // Visit receptors tile by tile, so that neighbouring receptors share the
+    // cached tiles.
+    std::vector<std::size_t> tileIndex(n);
+    for (std::size_t i = 0; i < n; ++i) {
+        const double u = std::floor((x[i] - p->grid_.x0) / p->grid_.xres);
+        const double v = std::floor((y[i] - p->grid_.y0) / p->grid_.yres);
+        const auto ti = static_cast<std::size_t>(std::clamp(u, 0.0, p->grid_.nx - 1.0)) / TileSize;
+        const auto tj = static_cast<std::size_t>(std::clamp(v, 0.0, p->grid_.ny - 1.0)) / TileSize;
+        tileIndex[i] = tj * p->ntx_ + ti;
+    }
+
+    std::vector<std::size_t> order(n);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) {
+        return tileIndex[a] < tileIndex[b];
+    });
+
+    control.message(fmt::format("Processing {} receptors", n));
+
+    constexpr std::size_t chunkSize = 16;
+    const unsigned int nthreads = threadCount(p->nthreads_, n, chunkSize);
+
+    BOOST_LOG_TRIVIAL(info) << fmt::format("Processing {} receptors on {} threads, DEM {} x {}, {} tiles, cache {} tiles",
+                                           n, nthreads, p->grid_.nx, p->grid_.ny,
+                                           static_cast<std::size_t>(p->ntx_) * p->nty_, p->cache_->capacity());
+
+    try {
+        parallelFor(control, n, chunkSize, nthreads, [&](std::size_t first, std::size_t last) {
+            for (std::size_t k = first; k < last; ++k) {
+                const std::size_t i = order[k];
+                const double zr = p->elevation(x[i], y[i]);
+                result.zElev[i] = zr;
+                result.zHill[i] = p->criticalHeight(*pyramid, x[i], y[i], zr);
+            }
+        });
+    }
+    catch (...) {
+        control.finished();
+        throw;
+    }
+
+    if (control.interruptRequested()) {
+        control.finished();
+        throw std::runtime_error("Canceled");
+    }
+
+    control.progress(1.0);
+    control.finished();
+    return result;
+}
+
+//-----------------------------------------------------------------------------
+// Consistency check
+//-----------------------------------------------------------------------------
+
+namespace {
+
+// Tile source over an in-memory grid.
+class GridTileSource : public TerrainTileSource
+{
+public:
+    explicit GridTileSource(std::shared_ptr<const TerrainGrid> grid)
+        : grid_(std::move(grid))
+    {}
+
+    TerrainGrid geometry() const override {
+        TerrainGrid geometry = *grid_;
+        geometry.values.clear();
+        return geometry;
+    }
+
+    std::vector<float> read(int i0, int j0, int nx, int ny) const override {
+        std::vector<float> values;
+        values.reserve(static_cast<std::size_t>(nx) * ny);
+        for (int j = j0; j < j0 + ny; ++j) {
+            for (int i = i0; i < i0 + nx; ++i)
+                values.push_back(grid_->at(i, j));
+        }
+        return values;
+    }
+
+private:
+    std::shared_ptr<const TerrainGrid> grid_;
+};
+
+// Synthetic DEM of 3 x 2 streaming tiles, the last row and column partial.
+// Elevations are rounded to 0.5 m, so that neighbouring nodes and tiles tie.
+// Two plateaus in different tiles share the highest elevation, and a mesa
+// straddles a tile boundary. No data nodes are scattered, cover a leaf block
+// and a whole tile, and run along the east edge.
+std::shared_ptr<const TerrainGrid> syntheticGrid()
+{
+    constexpr int TileSize = StreamingTerrainProcessor::TileSize;
+    constexpr float plateau = 400.0f;
+    const float nodata = std::numeric_limits<float>::quiet_NaN();
+
+    auto grid = std::make_shared<TerrainGrid>();
+    grid->nx = 2 * TileSize + 37;
+    grid->ny = TileSize + 165;
+    grid->x0 = 400000;
+    grid->y0 = 4500000;
+    grid->xres = 30;
+    grid->yres = -30;
+    grid->values.resize(static_cast<std::size_t>(grid->nx) * grid->ny);
+
+    for (int j = 0; j < grid->ny; ++j) {
+        for (int i = 0; i < grid->nx; ++i) {
+            const double d2 = (i - 120.0) * (i - 120.0) + (j - 90.0) * (j - 90.0);
+            double z = 100 + 60 * std::sin(i * 0.03) * std::cos(j * 0.02) + 320 * std::exp(-d2 / 3000.0);
+            z = std::round(z * 2) / 2;
+
+            if (z > plateau)
+                z = plateau;
+            if (i >= 420 && i < 470 && j >= 300 && j < 340)
+                z = plateau;
+            if (i >= TileSize - 16 && i < TileSize + 24 && j >= TileSize - 40 && j < TileSize + 8)
+                z = 300;
+
+            float& value = grid->values[static_cast<std::size_t>(j) * grid->nx + i];
+            value = static_cast<float>(z);
+
+            const bool scattered = (static_cast<std::size_t>(j) * grid->nx + i) % 97 == 0;
+            const bool leaf = i >= 32 && i < 48 && j >= 64 && j < 80;
+            const bool tile = i >= 2 * TileSize && j >= TileSize;
+            const bool edge = i == grid->nx - 1 && j < 50;
+            if (scattered || leaf || tile || edge)
+                value = nodata;
+        }
+    }
+
+    return grid;
+}
+
+// Receptors at random inside and around the DEM, on its edges and corners,
+// and at node centres on the plateaus.
+void syntheticReceptors(const TerrainGrid& grid, std::vector<double>& x, std::vector<double>& y)
+{
+    const double xmin = grid.x0;
+    const double xmax = grid.x0 + grid.nx * grid.xres;
+    const double ymin = grid.y0 + grid.ny * grid.yres;
+    const double ymax = grid.y0;
+
+    std::mt19937 rng(20200101);
+    std::uniform_real_distribution<double> ux(xmin - 3 * grid.xres, xmax + 3 * grid.xres);
+    std::uniform_real_distribution<double> uy(ymin + 3 * grid.yres, ymax - 3 * grid.yres);
+    for (int k = 0; k < 2000; ++k) {
+        x.push_back(ux(rng));
+        y.push_back(uy(rng));
+    }
+
+    for (int k = 0; k <= 20; ++k) {
+        const double fx = xmin + (xmax - xmin) * k / 20;
+        const double fy = ymin + (ymax - ymin) * k / 20;
+        for (const auto& [px, py] : {std::pair{fx, ymin}, std::pair{fx, ymax},
+                                     std::pair{xmin, fy}, std::pair{xmax, fy}}) {
+            x.push_back(px);
+            y.push_back(py);
+        }
+    }
+
+    for (const auto& [i, j] : {std::pair{120, 90}, std::pair{121, 90}, std::pair{445, 320},
+                               std::pair{469, 339}, std::pair{256, 256}, std::pair{0, 0},
+                               std::pair{grid.nx - 1, grid.ny - 1}, std::pair{40, 70}}) {
+        x.push_back(grid.nodeX(i));
+        y.push_back(grid.nodeY(j));
+    }
+}
+
+inline bool identical(double a, double b)
+{
+    return a == b || (std::isnan(a) && std::isnan(b));
+}
+
+} // namespace
+
+std::vector<std::string> checkTerrainProcessors()
+{
+    BOOST_LOG_SCOPED_THREAD_TAG("Source", "Terrain");
+
+    auto grid = syntheticGrid();
+    std::vector<double> x, y;
+    syntheticReceptors(*grid, x, y);
+
+    CpuTerrainProcessor pruned(grid);
+    CpuTerrainProcessor scan(grid);
+    scan.setPruning(false);
+
+    // The smallest cache, so that tiles are evicted and read again.
+    StreamingTerrainProcessor streaming(std::make_shared<const GridTileSource>(grid), 0);
+
+    TaskControl control;
+    const TerrainResult expected = scan.process(control, x, y).get();
+    const TerrainResult cpu = pruned.process(control, x, y).get();
+    const TerrainResult tiled = streaming.process(control, x, y).get();
+
+    std::vector<std::string> mismatches;
+    auto compare = [&](const char *what, std::size_t i, double zr, double a, double b) {
+        if (!identical(a, b))
+            mismatches.push_back(fmt::format("{} at ({}, {}), zr {}: {} != {}", what, x[i], y[i], zr, a, b));
+    };
+
+    for (std::size_t i = 0; i < x.size(); ++i) {
+        const double zr = expected.zElev[i];
+        compare("Pruned zHill", i, zr, cpu.zHill[i], expected.zHill[i]);
+        compare("Streaming zElev", i, zr, tiled.zElev[i], expected.zElev[i]);
+        compare("Streaming zHill", i, zr, tiled.zHill[i], expected.zHill[i]);
+
+        // Receptors below the terrain, and level with the mesa and plateaus.
+        for (double z : {zr - 25.0, 300.0, 399.5, 400.0}) {
+            const double hc = scan.criticalHeight(x[i], y[i], z);
+            compare("Pruned zHill", i, z, pruned.criticalHeight(x[i], y[i], z), hc);
+            compare("Streaming zHill", i, z, streaming.criticalHeight(x[i], y[i], z), hc);
+        }
+    }
+
+    BOOST_LOG_TRIVIAL(info) << fmt::format("Terrain check: {} receptors, {} mismatches", x.size(), mismatches.size());
+
+    return mismatches;
+}
@@ -0,0 +1,236 @@
+// Copyright 2020 Dow, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#pragma once
+
+#include "core/TaskControl.h"
+
+#include <cstddef>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace Raster {
+class Dataset;
+}
+
+//-----------------------------------------------------------------------------
+// TerrainGrid
+//-----------------------------------------------------------------------------
+
+// Elevation grid in a projected coordinate system, stored row by row. The
+// centre of node (i, j) is at (x0 + (i + 0.5) * xres, y0 + (j + 0.5) * yres);
+// yres is negative for north-up rasters.
+
+struct TerrainGrid
+{
+    static TerrainGrid fromDataset(const Raster::Dataset& dataset, std::vector<float> values);
+
+    float at(int i, int j) const {
+        return values[static_cast<std::size_t>(j) * nx + i];
+    }
+
+    double nodeX(int i) const {
+        return x0 + (i + 0.5) * xres;
+    }
+
+    double nodeY(int j) const {
+        return y0 + (j + 0.5) * yres;
+    }
+
+    double elevation(double x, double y) const;
+
+    int nx = 0;
+    int ny = 0;
+    double x0 = 0;
+    double y0 = 0;
+    double xres = 1;
+    double yres = 1;
+    std::vector<float> values;
+};
+
+//-----------------------------------------------------------------------------
+// TerrainTileSource
+//-----------------------------------------------------------------------------
+
+// Source of DEM values for out-of-core processing. Windows are returned row
+// by row, and may be requested concurrently from several threads.
+
+class TerrainTileSource
+{
+public:
+    virtual ~TerrainTileSource() = default;
+
+    // Grid geometry of the DEM, without values.
+    virtual TerrainGrid geometry() const = 0;
+
+    virtual std::vector<float> read(int i0, int j0, int nx, int ny) const = 0;
+};
+
+// Tile source over the window of a GDAL dataset.
+
+class DatasetTileSource : public TerrainTileSource
+{
+public:
+    explicit DatasetTileSource(std::shared_ptr<const Raster::Dataset> dataset);
+
+    TerrainGrid geometry() const override;
+    std::vector<float> read(int i0, int j0, int nx, int ny) const override;
+
+private:
+    std::shared_ptr<const Raster::Dataset> dataset_;
+    TerrainGrid geometry_;
+};
+
+//-----------------------------------------------------------------------------
+// CpuTerrainProcessor
+//-----------------------------------------------------------------------------
+
+struct TerrainResult
+{
+    std::vector<double> zElev;
+    std::vector<double> zHill;
+};
+
+// Maximum elevations over square tiles of a DEM, one level of a pyramid.
+
+struct TerrainPyramidLevel
+{
+    int nx = 0;   // tiles per row
+    int ny = 0;   // tile rows
+    int span = 0; // DEM nodes per tile side
+    std::vector<float> zmax;
+};
+
+// Multi-threaded CPU implementation of the TerrainProcessor kernels, for
+// systems without an OpenCL device. Receptor elevations are interpolated
+// bilinearly from the DEM, and critical hill heights are calculated with the
+// AERMAP method: the highest DEM node at or above a 10% slope from the
+// receptor, or the receptor elevation if there is none.
+//
+// The critical hill height search uses a pyramid of maximum elevations over
+// square tiles of the DEM. Tiles are visited in order of decreasing maximum,
+// and skipped when their maximum cannot satisfy the slope criterion at the
+// nearest point of the tile, or cannot exceed the current height. The result
+// is identical to scanning every node.
+
+class CpuTerrainProcessor
+{
+public:
+    static constexpr int LeafSize = 16;
+
+    explicit CpuTerrainProcessor(std::shared_ptr<const TerrainGrid> dem);
+
+    void setThreadCount(unsigned int n);
+    void setPruning(bool enabled);
+
+    std::future<TerrainResult> process(TaskControl& control,
+                                       std::vector<double> x,
+                                       std::vector<double> y) const;
+
+    double criticalHeight(double x, double y, double zr) const;
+
+private:
+    void buildPyramid();
+    double scanAll(double x, double y, double zr) const;
+    double scanPyramid(double x, double y, double zr) const;
+
+    static TerrainResult processInternal(TaskControl& control, const CpuTerrainProcessor *p,
+                                         const std::vector<double>& x,
+                                         const std::vector<double>& y);
+
+    std::shared_ptr<const TerrainGrid> dem_;
+    std::vector<double> xs_;
+    std::vector<double> ys_;
+    std::vector<TerrainPyramidLevel> pyramid_;
+    unsigned int nthreads_ = 0;
+    bool pruning_ = true;
+};
+
+//-----------------------------------------------------------------------------
+// StreamingTerrainProcessor
+//-----------------------------------------------------------------------------
+
+// Out-of-core variant of CpuTerrainProcessor for DEMs larger than memory.
+// The DEM is read in tiles of TileSize x TileSize nodes, on demand, into a
+// cache of bounded size. A first pass over the DEM records the maximum
+// elevation of each tile, and the critical hill height search runs on a
+// pyramid over these maxima, loading only tiles that may hold the result.
+// Within a tile, blocks of LeafSize nodes are pruned in the same way.
+// Results are identical to CpuTerrainProcessor.
+
+class StreamingTerrainProcessor
+{
+public:
+    static constexpr int TileSize = 256;
+    static constexpr int LeafSize = CpuTerrainProcessor::LeafSize;
+
+    explicit StreamingTerrainProcessor(std::shared_ptr<const TerrainTileSource> source,
+                                       std::size_t cacheSize = std::size_t{512} << 20);
+    ~StreamingTerrainProcessor();
+
+    // Whether the window of a dataset should be processed out of core: an
+    // in-memory DEM of the window would take more than half the available
+    // physical memory.
+    static bool preferred(const Raster::Dataset& dataset);
+
+    void setThreadCount(unsigned int n);
+
+    std::future<TerrainResult> process(TaskControl& control,
+                                       std::vector<double> x,
+                                       std::vector<double> y) const;
+
+    double elevation(double x, double y) const;
+
+    // Requires the tile summary, which is built by the first call to process.
+    double criticalHeight(double x, double y, double zr) const;
+
+private:
+    struct Tile;
+    class TileCache;
+
+    std::shared_ptr<const Tile> loadTile(int k) const;
+    float node(int i, int j) const;
+    double criticalHeight(const std::vector<TerrainPyramidLevel>& pyramid, double x, double y, double zr) const;
+    std::shared_ptr<const std::vector<TerrainPyramidLevel>> buildSummary(TaskControl& control) const;
+
+    static TerrainResult processInternal(TaskControl& control, const StreamingTerrainProcessor *p,
+                                         const std::vector<double>& x,
+                                         const std::vector<double>& y);
+
+    std::shared_ptr<const TerrainTileSource> source_;
+    TerrainGrid grid_;
+    int ntx_ = 0;
+    int nty_ = 0;
+    std::unique_ptr<TileCache> cache_;
+    std::vector<double> xs_;
+    std::vector<double> ys_;
+    mutable std::mutex summaryMutex_;
+    mutable std::shared_ptr<const std::vector<TerrainPyramidLevel>> pyramid_; // guarded by summaryMutex_
+    unsigned int nthreads_ = 0;
+};
+
+//-----------------------------------------------------------------------------
+// Consistency check
+//-----------------------------------------------------------------------------
+
+// Runs the terrain processors over a synthetic DEM with plateaus, tied
+// maxima and no data (NaN) nodes, for receptors inside the DEM, on its edges
+// and beyond it. The pruned search is compared with a scan of every node, and
+// StreamingTerrainProcessor with CpuTerrainProcessor. Results must be
+// identical, NaN included. Returns a description of each mismatch.
+
+std::vector<std::string> checkTerrainProcessors();
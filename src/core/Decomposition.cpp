@@ -0,0 +1,227 @@
+// Copyright 2020 Dow, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "core/Decomposition.h"
+#include "core/Scenario.h"
+#include "utilities/DateTimeConversion.h"
+
+#include <algorithm>
+#include <iterator>
+#include <numeric>
+
+#include <boost/variant/apply_visitor.hpp>
+#include <boost/variant/static_visitor.hpp>
+
+namespace {
+
+struct FlattenVisitor : public boost::static_visitor<>
+{
+    explicit FlattenVisitor(std::vector<FlatReceptor>& out) : out_(out) {}
+
+    void operator()(const ReceptorNodeGroup& group) const {
+        for (std::size_t i = 0; i < group.nodeCount(); ++i)
+            out_.push_back(FlatReceptor{group.getNode(static_cast<int>(i)), group.grpid});
+    }
+
+    void operator()(const ReceptorRingGroup& group) const {
+        for (const auto& node : group.nodes)
+            out_.push_back(FlatReceptor{node, group.grpid});
+    }
+
+    void operator()(const ReceptorGridGroup& group) const {
+        // AERMOD generates grid receptors row by row, with the x-coordinate
+        // varying fastest.
+        for (int j = 0; j < group.yCount; ++j) {
+            for (int i = 0; i < group.xCount; ++i) {
+                ReceptorNode node;
+                node.x = group.xInit + (group.xDelta * i);
+                node.y = group.yInit + (group.yDelta * j);
+                node.zElev = group.zElevM(i, j);
+                node.zHill = group.zHillM(i, j);
+                node.zFlag = group.zFlagM(i, j);
+                out_.push_back(FlatReceptor{node, group.grpid, true});
+            }
+        }
+    }
+
+    std::vector<FlatReceptor>& out_;
+};
+
+struct NodeCountVisitor : public boost::static_visitor<std::size_t>
+{
+    template <typename T>
+    std::size_t operator()(const T& group) const {
+        return group.nodeCount();
+    }
+};
+
+using IndexIterator = std::vector<std::size_t>::iterator;
+
+void bisect(const std::vector<FlatReceptor>& receptors, IndexIterator first, IndexIterator last,
+            int n, std::vector<std::vector<std::size_t>>& chunks)
+{
+    std::size_t count = static_cast<std::size_t>(std::distance(first, last));
+
+    if (n <= 1 || count <= 1) {
+        std::vector<std::size_t> chunk(first, last);
+        std::sort(chunk.begin(), chunk.end());
+        chunks.push_back(std::move(chunk));
+        return;
+    }
+
+    // Split along the axis with the largest extent.
+    auto [xmin, xmax] = std::minmax_element(first, last, [&](std::size_t a, std::size_t b) {
+        return receptors[a].node.x < receptors[b].node.x;
+    });
+    auto [ymin, ymax] = std::minmax_element(first, last, [&](std::size_t a, std::size_t b) {
+        return receptors[a].node.y < receptors[b].node.y;
+    });
+
+    double dx = receptors[*xmax].node.x - receptors[*xmin].node.x;
+    double dy = receptors[*ymax].node.y - receptors[*ymin].node.y;
+
+    // Distribute chunks between halves in proportion to receptor count.
+    int nleft = n / 2;
+    auto middle = first + static_cast<std::ptrdiff_t>(count * nleft / n);
+
+    if (dx >= dy) {
+        std::nth_element(first, middle, last, [&](std::size_t a, std::size_t b) {
+            return receptors[a].node.x < receptors[b].node.x;
+        });
+    }
+    else {
+        std::nth_element(first, middle, last, [&](std::size_t a, std::size_t b) {
+            return receptors[a].node.y < receptors[b].node.y;
+        });
+    }
+
+    bisect(receptors, first, middle, nleft, chunks);
+    bisect(receptors, middle, last, n - nleft, chunks);
+}
+
+} // namespace
+
+std::vector<FlatReceptor> flattenReceptors(const std::vector<ReceptorGroup>& groups)
+{
+    std::vector<FlatReceptor> result;
+    FlattenVisitor visitor(result);
+    for (const auto& group : groups)
+        boost::apply_visitor(visitor, group);
+    return result;
+}
+
+std::size_t receptorCount(const std::vector<ReceptorGroup>& groups)
+{
+    std::size_t count = 0;
+    for (const auto& group : groups)
+        count += boost::apply_visitor(NodeCountVisitor(), group);
+    return count;
+}
+
+std::vector<std::vector<std::size_t>> partitionReceptors(const std::vector<FlatReceptor>& receptors, int n)
+{
+    std::vector<std::vector<std::size_t>> chunks;
+    if (receptors.empty())
+        return chunks;
+
+    n = std::clamp<int>(n, 1, static_cast<int>(receptors.size()));
+
+    std::vector<std::size_t> indices(receptors.size());
+    std::iota(indices.begin(), indices.end(), 0);
+
+    bisect(receptors, indices.begin(), indices.end(), n, chunks);
+    return chunks;
+}
+
+std::vector<TimeSegment> partitionPeriod(const QDateTime& start, const QDateTime& end, int k, int overlapHours)
+{
+    std::vector<TimeSegment> segments;
+    if (!start.isValid() || !end.isValid() || end < start)
+        return segments;
+
+    QDate firstDay = start.date();
+    qint64 ndays = firstDay.daysTo(end.date()) + 1;
+    qint64 nseg = std::clamp<qint64>(k, 1, ndays);
+    int overlapDays = (std::max(0, overlapHours) + 23) / 24;
+
+    for (qint64 i = 0; i < nseg; ++i) {
+        QDate d0 = firstDay.addDays(ndays * i / nseg);
+        QDate d1 = firstDay.addDays(ndays * (i + 1) / nseg - 1);
+
+        TimeSegment segment;
+        segment.start = QDateTime(d0.addDays(-overlapDays), QTime(0, 0), start.timeSpec());
+        segment.end = QDateTime(d1, QTime(23, 0), start.timeSpec());
+
+        if (i == 0 || segment.start < start)
+            segment.start = start;
+        if (i == nseg - 1 || segment.end > end)
+            segment.end = end;
+
+        segments.push_back(segment);
+    }
+
+    return segments;
+}
+
+TimeSegment emissionPeriod(const Scenario& s, int extendHours)
+{
+    TimeSegment period;
+
+    QDateTime minTime = sofea::utilities::convert<QDateTime>(s.meteorology.surfaceFile.minTime());
+    QDateTime maxTime = sofea::utilities::convert<QDateTime>(s.meteorology.surfaceFile.maxTime());
+    if (!minTime.isValid() || !maxTime.isValid())
+        return period;
+
+    // Union of [appStart, appStart + profile hours) over all sources.
+    QDateTime first, last;
+    for (const auto& sgptr : s.sourceGroups) {
+        for (const Source& src : sgptr->sources) {
+            const auto fp = src.fluxProfile.lock();
+            if (!fp || !src.appStart.isValid())
+                continue;
+            int nhours = fp->totalHours();
+            if (nhours <= 0)
+                continue;
+            QDateTime t0 = src.appStart;
+            QDateTime t1 = src.appStart.addSecs(static_cast<qint64>(nhours - 1) * 3600);
+            if (!first.isValid() || t0 < first)
+                first = t0;
+            if (!last.isValid() || t1 > last)
+                last = t1;
+        }
+    }
+
+    if (!first.isValid())
+        return period;
+
+    qint64 extend = static_cast<qint64>(std::max(0, extendHours)) * 3600;
+    first = first.addSecs(-extend);
+    last = last.addSecs(extend);
+
+    // STARTEND is written with whole days, so align to day boundaries.
+    first = QDateTime(first.date(), QTime(0, 0), minTime.timeSpec());
+    last = QDateTime(last.date(), QTime(23, 0), minTime.timeSpec());
+
+    if (first < minTime)
+        first = minTime;
+    if (last > maxTime)
+        last = maxTime;
+    if (last < first)
+        return period;
+
+    period.start = first;
+    period.end = last;
+    return period;
+}
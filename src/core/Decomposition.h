@@ -0,0 +1,68 @@
+// Copyright 2020 Dow, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <QDateTime>
+
+#include "core/Receptor.h"
+
+struct Scenario;
+
+// Receptor with the identifier of the group it belongs to. A flattened list
+// of receptors is ordered as AERMOD numbers them in the RE pathway, so that
+// a global receptor index is stable across decomposed runs.
+
+struct FlatReceptor
+{
+    ReceptorNode node;
+    std::string grpid;
+    bool network = false; // grid receptor; grpid is the netid
+};
+
+std::vector<FlatReceptor> flattenReceptors(const std::vector<ReceptorGroup>& groups);
+
+std::size_t receptorCount(const std::vector<ReceptorGroup>& groups);
+
+// Partition receptors into at most n spatially coherent chunks using recursive
+// coordinate bisection. Each chunk contains global receptor indices in
+// ascending order, and chunk sizes differ by at most one receptor.
+
+std::vector<std::vector<std::size_t>> partitionReceptors(const std::vector<FlatReceptor>& receptors, int n);
+
+// Hourly period simulated by one AERMOD run, inclusive of both ends.
+
+struct TimeSegment
+{
+    QDateTime start;
+    QDateTime end;
+};
+
+// Split the hourly period [start, end] into at most k segments at day
+// boundaries, so that block averages are aligned with the undivided run.
+// Every segment after the first begins overlapHours earlier, rounded up to
+// whole days. The overlap is simulated twice and discarded when merging.
+
+std::vector<TimeSegment> partitionPeriod(const QDateTime& start, const QDateTime& end, int k, int overlapHours);
+
+// Hourly period covering the emissions of all sources, extended by
+// extendHours on both sides, rounded out to whole days and clipped to the
+// surface file period. Invalid if no source emits within that period.
+
+TimeSegment emissionPeriod(const Scenario& s, int extendHours);
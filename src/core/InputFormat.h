@@ -15,8 +15,6 @@
 
 #pragma once
 
-#include <boost/numeric/ublas/vector.hpp>
-#include <boost/numeric/ublas/matrix_proxy.hpp>
 #include <fmt/format.h>
 
 #include "core/Receptor.h"
@@ -38,10 +36,10 @@ struct formatter<ReceptorNodeGroup>
         auto it = format_to(ctx.out(),
             "** Discrete Receptor Group {}\n", group.grpid);
 
-        for (const auto& node : group.nodes) {
+        for (std::size_t i = 0; i < group.nodeCount(); ++i) {
             it = format_to(ctx.out(),
                 "   EVALCART {: 10.2f} {: 10.2f} {:>6.2f} {:>6.2f} {:>6.2f} {}\n",
-                node.x, node.y, node.zElev, node.zHill, node.zFlag, group.grpid);
+                group.x[i], group.y[i], group.zElev[i], group.zHill[i], group.zFlag[i], group.grpid);
         }
 
         return it;
@@ -83,44 +81,22 @@ struct formatter<ReceptorGridGroup>
 
     template <typename FormatContext>
     auto format_matrix(FormatContext& ctx, const std::string& keyword, const std::string& grpid,
-                       const boost::numeric::ublas::compressed_matrix<double>& m)
+                       const GridMatrix& m)
     {
-        namespace ublas = boost::numeric::ublas;
-
         auto it = ctx.out();
         for (std::size_t i = 0; i < m.size1(); ++i) {
             // Row numbers start at 1, and increase with the y-coordinate.
             it = fmt::format_to(ctx.out(), "   GRIDCART {0:<8} {1:<5} {2:<5}", grpid, keyword, i + 1);
 
-            std::size_t ncols = m.size2();
-            ublas::compressed_vector<double> v(ncols);
-            ublas::noalias(v) = ublas::row(m, i);
-            std::size_t nnz = v.nnz(); // number of non-zero entries
-
             // Write contiguous values in shorthand format.
-            std::size_t repeat = 1;
-            for (std::size_t j = 1; j < ncols; ++j) {
-                if (nnz == 0) {
-                    std::size_t nz = ncols - nnz;
-                    it = fmt::format_to(ctx.out(), "{0:>5}*{1:<6.2f}", nz, 0.0);
-                    break;
-                }
-
-                double first = std::as_const(v)[j - 1];
-                double second = std::as_const(v)[j];
-
-                if (first == second) {
+            const std::vector<double> v = m.row(i);
+            std::size_t j = 0;
+            while (j < v.size()) {
+                std::size_t repeat = 1;
+                while (j + repeat < v.size() && v[j + repeat] == v[j])
                     ++repeat;
-                }
-                else {
-                    it = fmt::format_to(ctx.out(), "{0:>5}*{1:<6.2f}", repeat, first);
-                    repeat = 1;
-                }
-
-                if (j == ncols - 1) {
-                    it = fmt::format_to(ctx.out(), "{0:>5}*{1:<6.2f}", repeat, second);
-                    break;
-                }
+                it = fmt::format_to(ctx.out(), "{0:>5}*{1:<6.2f}", repeat, v[j]);
+                j += repeat;
             }
 
             it = fmt::format_to(ctx.out(), "\n");
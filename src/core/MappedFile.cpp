@@ -0,0 +1,141 @@
+// Copyright 2020 Dow, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "core/MappedFile.h"
+
+#include <utility>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(const std::filesystem::path& p)
+{
+#ifdef _WIN32
+    HANDLE file = CreateFileW(p.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                              OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size)) {
+        CloseHandle(file);
+        return;
+    }
+
+    file_ = file;
+    size_ = static_cast<std::size_t>(size.QuadPart);
+    open_ = true;
+
+    // Empty files cannot be mapped.
+    if (size_ == 0)
+        return;
+
+    HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping == nullptr) {
+        close();
+        return;
+    }
+
+    mapping_ = mapping;
+    data_ = static_cast<const char *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    if (data_ == nullptr)
+        close();
+#else
+    int fd = ::open(p.c_str(), O_RDONLY);
+    if (fd == -1)
+        return;
+
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        ::close(fd);
+        return;
+    }
+
+    size_ = static_cast<std::size_t>(st.st_size);
+    open_ = true;
+
+    if (size_ > 0) {
+        void *addr = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr == MAP_FAILED) {
+            size_ = 0;
+            open_ = false;
+        }
+        else {
+            data_ = static_cast<const char *>(addr);
+            madvise(addr, size_, MADV_SEQUENTIAL);
+        }
+    }
+
+    // The mapping remains valid after the descriptor is closed.
+    ::close(fd);
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+{
+    *this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+    if (this != &other) {
+        close();
+        data_ = std::exchange(other.data_, nullptr);
+        size_ = std::exchange(other.size_, 0);
+        open_ = std::exchange(other.open_, false);
+#ifdef _WIN32
+        file_ = std::exchange(other.file_, nullptr);
+        mapping_ = std::exchange(other.mapping_, nullptr);
+#endif
+    }
+    return *this;
+}
+
+void MappedFile::close()
+{
+#ifdef _WIN32
+    if (data_ != nullptr)
+        UnmapViewOfFile(data_);
+    if (mapping_ != nullptr)
+        CloseHandle(mapping_);
+    if (file_ != nullptr)
+        CloseHandle(file_);
+    mapping_ = nullptr;
+    file_ = nullptr;
+#else
+    if (data_ != nullptr)
+        munmap(const_cast<char *>(data_), size_);
+#endif
+    data_ = nullptr;
+    size_ = 0;
+    open_ = false;
+}
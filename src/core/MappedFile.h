@@ -0,0 +1,51 @@
+// Copyright 2020 Dow, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <string_view>
+
+// Read-only memory mapping of a whole file.
+
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    explicit MappedFile(const std::filesystem::path& p);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    bool isOpen() const { return open_; }
+    const char *data() const { return data_; }
+    std::size_t size() const { return size_; }
+    std::string_view view() const { return std::string_view(data_, size_); }
+
+    void close();
+
+private:
+    const char *data_ = nullptr;
+    std::size_t size_ = 0;
+    bool open_ = false;
+#ifdef _WIN32
+    void *file_ = nullptr;
+    void *mapping_ = nullptr;
+#endif
+};
@@ -14,168 +14,152 @@
 //
 
 #include "core/Meteorology.h"
+#include "core/MappedFile.h"
+#include "core/MeteorologyCache.h"
 
 #include <algorithm>
+#include <charconv>
 #include <cmath>
-#include <iostream>
+#include <cstring>
+#include <future>
 #include <iterator>
-#include <fstream>
+#include <limits>
+#include <memory>
 #include <stdexcept>
+#include <string_view>
+#include <thread>
 
 #include <boost/algorithm/string/trim.hpp>
-#include <boost/fusion/include/adapt_struct.hpp>
 #include <boost/icl/gregorian.hpp>
 #include <boost/icl/ptime.hpp>
 #include <boost/icl/interval_set.hpp>
-#include <boost/io/ios_state.hpp>
 #include <boost/log/trivial.hpp>
 #include <boost/log/attributes/scoped_attribute.hpp>
-#include <boost/spirit/include/qi.hpp>
 
 #include <fmt/format.h>
 
-namespace qi = boost::spirit::qi;
-namespace ascii = boost::spirit::ascii;
-
-#ifdef _MSC_VER
-#pragma warning(disable:4068) // Level 1, C4068: unknown pragma
-#endif
-
-#pragma clang diagnostic push
-#pragma clang diagnostic ignored "-Wdisabled-macro-expansion"
-
-BOOST_FUSION_ADAPT_STRUCT(
-    SurfaceRecord,
-    (unsigned short, mpyr)
-    (unsigned short, mpcmo)
-    (unsigned short, mpcdy)
-    (unsigned short, mpjdy)
-    (unsigned short, j)
-    (double, hflux)
-    (double, ustar)
-    (double, wstar)
-    (double, vptg)
-    (double, ziconv)
-    (double, zimech)
-    (double, mol)
-    (double, z0)
-    (double, bowen)
-    (double, albedo)
-    (double, wspd)
-    (double, wdir)
-    (double, zref)
-    (double, t)
-    (double, ztref)
-    (int, ipcode)
-    (double, pamt)
-    (double, rh)
-    (double, p)
-    (int, ccvr)
-    (int, wsadj)
-    (int, subs)
-)
-
-BOOST_FUSION_ADAPT_STRUCT(
-    UpperAirRecord,
-    (unsigned short, mpyr)
-    (unsigned short, mpcmo)
-    (unsigned short, mpcdy)
-    (unsigned short, j)
-    (double, ht)
-    (int, top)
-    (double, wdir)
-    (double, wspd)
-    (double, t)
-    (double, sa)
-    (double, sw)
-)
-
-#pragma clang diagnostic pop
-
-#ifdef _MSC_VER
-#pragma warning(default:4068)
-#endif
+namespace {
 
 //-----------------------------------------------------------------------------
-// Date Parsers
+// Field Parsers
 //-----------------------------------------------------------------------------
 
-static const qi::uint_parser<unsigned short, 10, 2, 2> yy_;
-static const qi::uint_parser<unsigned short, 10, 1, 2> mm_, dd_, hh_;
-static const qi::uint_parser<unsigned short, 10, 1, 3> jjj_;
+// Fields are separated by blanks, as written by AERMET (MPOUT.FOR).
+struct FieldReader
+{
+    FieldReader(const char *first, const char *last)
+        : begin(first), p(first), end(last) {}
 
-//-----------------------------------------------------------------------------
-// Symbol Parsers
-//-----------------------------------------------------------------------------
+    static bool isBlank(char c) {
+        return c == ' ' || c == '\t' || c == '\r';
+    }
+
+    void skip() {
+        while (p < end && isBlank(*p))
+            ++p;
+    }
 
-struct WSAdj : qi::symbols<char, int> {
-    WSAdj() { this->add
-        ("NAD",          0x01)  // 0000 0001
-        ("NAD-OS",       0x11)  // 0001 0001
-        ("NAD-A1",       0x21)  // 0010 0001
-        ("NAD-SFC",      0x41)  // 0100 0001
-        ("ADJ",          0x02)  // 0000 0010
-        ("ADJ-OS",       0x12)  // 0001 0010
-        ("ADJ-A1",       0x22)  // 0010 0010
-        ("ADJ-SFC",      0x42)  // 0100 0010
-        ("MMIF-OS",      0x14); // 0001 0100
+    bool atEnd() {
+        skip();
+        return p == end;
     }
-} static const wsadj_;
-
-struct Subs : qi::symbols<char, int> {
-    Subs() { this->add
-        ("Sub_CC-TT",    0x05)  // 0000 0101 ITMPSUB, ICCSUB
-        ("NoPersC_SubT", 0x06)  // 0000 0110 ITMPSUB, ICNoPers
-        ("Sub_TT",       0x04)  // 0000 0100 ITMPSUB
-        ("SubC-NoPersT", 0x09)  // 0000 1001 ITNoPers, ICCSUB
-        ("NoPers_CC-TT", 0x0A)  // 0000 1010 ITNoPers, ICNoPers
-        ("NoPers_TT",    0x08)  // 0000 1000 ITNoPers
-        ("Sub_CC",       0x01)  // 0000 0001 ICCSUB
-        ("NoPers_CC",    0x02)  // 0000 0010 ICNoPers
-        ("NoSubs",       0x10); // 0001 0000
+
+    std::size_t column() const {
+        return static_cast<std::size_t>(p - begin);
     }
-} static const subs_;
 
-//-----------------------------------------------------------------------------
-// SurfaceRecordParser
-//-----------------------------------------------------------------------------
+    // Next token without consuming it.
+    std::string_view peek() {
+        skip();
+        const char *q = p;
+        while (q < end && !isBlank(*q))
+            ++q;
+        return std::string_view(p, static_cast<std::size_t>(q - p));
+    }
 
-template <typename Iterator, typename Skip = ascii::blank_type>
-struct SurfaceRecordParser : qi::grammar<Iterator, SurfaceRecord(), Skip>
-{
-    SurfaceRecordParser() : SurfaceRecordParser::base_type(start)
-    {
-        using namespace qi;
-
-        start = eps > yy_ > mm_ > dd_ > jjj_ > hh_ >
-                double_ > double_ > double_ > double_ > double_ >
-                double_ > double_ > double_ > double_ > double_ >
-                double_ > double_ > double_ > double_ > double_ >
-                -int_ > -double_ > -double_ > -double_ > -int_ >
-                -wsadj_ > -subs_;
+    void consume(std::string_view token) {
+        p = token.data() + token.size();
     }
 
-private:
-    qi::rule<Iterator, SurfaceRecord(), Skip> start;
+    const char *begin;
+    const char *p;
+    const char *end;
 };
 
+bool parseField(std::string_view token, unsigned short& value,
+                std::size_t minDigits, std::size_t maxDigits)
+{
+    if (token.size() < minDigits || token.size() > maxDigits)
+        return false;
+    auto [ptr, ec] = std::from_chars(token.data(), token.data() + token.size(), value);
+    return ec == std::errc() && ptr == token.data() + token.size();
+}
+
+bool parseField(std::string_view token, int& value)
+{
+    if (!token.empty() && token.front() == '+')
+        token.remove_prefix(1);
+    auto [ptr, ec] = std::from_chars(token.data(), token.data() + token.size(), value);
+    return ec == std::errc() && ptr == token.data() + token.size();
+}
+
+bool parseField(std::string_view token, double& value)
+{
+    if (!token.empty() && token.front() == '+')
+        token.remove_prefix(1);
+    auto [ptr, ec] = std::from_chars(token.data(), token.data() + token.size(), value);
+    return ec == std::errc() && ptr == token.data() + token.size();
+}
+
 //-----------------------------------------------------------------------------
-// UpperAirRecordParser
+// Symbol Parsers
 //-----------------------------------------------------------------------------
 
-template <typename Iterator, typename Skip = ascii::blank_type>
-struct UpperAirRecordParser : qi::grammar<Iterator, UpperAirRecord(), Skip>
+bool parseWSAdj(std::string_view token, int& value)
 {
-    UpperAirRecordParser() : UpperAirRecordParser::base_type(start)
-    {
-        using namespace qi;
-        start = eps > yy_ > mm_ > dd_ > hh_ > double_ > int_ >
-                double_ > double_ > double_ > double_ > double_;
+    static const std::pair<std::string_view, int> symbols[] = {
+        {"NAD",          0x01}, // 0000 0001
+        {"NAD-OS",       0x11}, // 0001 0001
+        {"NAD-A1",       0x21}, // 0010 0001
+        {"NAD-SFC",      0x41}, // 0100 0001
+        {"ADJ",          0x02}, // 0000 0010
+        {"ADJ-OS",       0x12}, // 0001 0010
+        {"ADJ-A1",       0x22}, // 0010 0010
+        {"ADJ-SFC",      0x42}, // 0100 0010
+        {"MMIF-OS",      0x14}, // 0001 0100
+    };
+
+    for (const auto& [symbol, code] : symbols) {
+        if (token == symbol) {
+            value = code;
+            return true;
+        }
     }
+    return false;
+}
 
-private:
-    qi::rule<Iterator, UpperAirRecord(), Skip> start;
-};
+bool parseSubs(std::string_view token, int& value)
+{
+    static const std::pair<std::string_view, int> symbols[] = {
+        {"Sub_CC-TT",    0x05}, // 0000 0101 ITMPSUB, ICCSUB
+        {"NoPersC_SubT", 0x06}, // 0000 0110 ITMPSUB, ICNoPers
+        {"Sub_TT",       0x04}, // 0000 0100 ITMPSUB
+        {"SubC-NoPersT", 0x09}, // 0000 1001 ITNoPers, ICCSUB
+        {"NoPers_CC-TT", 0x0A}, // 0000 1010 ITNoPers, ICNoPers
+        {"NoPers_TT",    0x08}, // 0000 1000 ITNoPers
+        {"Sub_CC",       0x01}, // 0000 0001 ICCSUB
+        {"NoPers_CC",    0x02}, // 0000 0010 ICNoPers
+        {"NoSubs",       0x10}, // 0001 0000
+    };
+
+    for (const auto& [symbol, code] : symbols) {
+        if (token == symbol) {
+            value = code;
+            return true;
+        }
+    }
+    return false;
+}
 
 //-----------------------------------------------------------------------------
 // Helper Functions
@@ -247,42 +231,345 @@ inline bool readSurfaceHeader(const std::string& line, SurfaceHeader& header)
     return true;
 }
 
-inline bool readSurfaceRecord(const std::string& line, SurfaceRecord& record)
+//-----------------------------------------------------------------------------
+// Record Parsers
+//-----------------------------------------------------------------------------
+
+enum class ParseResult {
+    Blank,      // empty line, skipped
+    Ok,
+    Rejected,   // unexpected trailing fields, skipped
+    Invalid     // required field missing or malformed, reported
+};
+
+ParseResult readSurfaceRecord(const char *first, const char *last, SurfaceRecord& r, std::size_t& col)
 {
-    using iterator_type = std::string::const_iterator;
-    static const SurfaceRecordParser<iterator_type> g;
+    FieldReader f(first, last);
+    if (f.atEnd())
+        return ParseResult::Blank;
+
+    auto expect = [&](auto&& parse) {
+        auto token = f.peek();
+        if (!parse(token)) {
+            col = f.column();
+            return false;
+        }
+        f.consume(token);
+        return true;
+    };
+
+    auto expectDouble = [&](double& value) {
+        return expect([&](std::string_view t) { return parseField(t, value); });
+    };
+
+    // Required fields
+    if (!expect([&](std::string_view t) { return parseField(t, r.mpyr, 2, 2); }) ||
+        !expect([&](std::string_view t) { return parseField(t, r.mpcmo, 1, 2); }) ||
+        !expect([&](std::string_view t) { return parseField(t, r.mpcdy, 1, 2); }) ||
+        !expect([&](std::string_view t) { return parseField(t, r.mpjdy, 1, 3); }) ||
+        !expect([&](std::string_view t) { return parseField(t, r.j, 1, 2); }))
+        return ParseResult::Invalid;
+
+    for (double *value : {&r.hflux, &r.ustar, &r.wstar, &r.vptg, &r.ziconv,
+                          &r.zimech, &r.mol, &r.z0, &r.bowen, &r.albedo,
+                          &r.wspd, &r.wdir, &r.zref, &r.t, &r.ztref}) {
+        if (!expectDouble(*value))
+            return ParseResult::Invalid;
+    }
 
-    if (line.empty() || line.find_first_not_of(" \t") == std::string::npos)
-        return false;
+    // Optional fields; each is skipped if the next token does not match.
+    auto optional = [&](auto&& parse) {
+        auto token = f.peek();
+        if (!token.empty() && parse(token))
+            f.consume(token);
+    };
+
+    optional([&](std::string_view t) { return parseField(t, r.ipcode); });
+    optional([&](std::string_view t) { return parseField(t, r.pamt); });
+    optional([&](std::string_view t) { return parseField(t, r.rh); });
+    optional([&](std::string_view t) { return parseField(t, r.p); });
+    optional([&](std::string_view t) { return parseField(t, r.ccvr); });
+    optional([&](std::string_view t) { return parseWSAdj(t, r.wsadj); });
+    optional([&](std::string_view t) { return parseSubs(t, r.subs); });
+
+    if (!f.atEnd())
+        return ParseResult::Rejected;
+
+    updateCalm(r);
+    updateMissing(r);
+    updateTime(r);
+    return ParseResult::Ok;
+}
 
-    iterator_type it = line.begin();
-    iterator_type end = line.end();
-    // May throw qi::expectation_failure<std::string::const_iterator>
-    if (qi::phrase_parse(it, end, g, ascii::blank, record) && it == end) {
-        updateCalm(record);
-        updateMissing(record);
-        updateTime(record);
+ParseResult readUpperAirRecord(const char *first, const char *last, UpperAirRecord& r, std::size_t& col)
+{
+    FieldReader f(first, last);
+    if (f.atEnd())
+        return ParseResult::Blank;
+
+    auto expect = [&](auto&& parse) {
+        auto token = f.peek();
+        if (!parse(token)) {
+            col = f.column();
+            return false;
+        }
+        f.consume(token);
         return true;
+    };
+
+    if (!expect([&](std::string_view t) { return parseField(t, r.mpyr, 2, 2); }) ||
+        !expect([&](std::string_view t) { return parseField(t, r.mpcmo, 1, 2); }) ||
+        !expect([&](std::string_view t) { return parseField(t, r.mpcdy, 1, 2); }) ||
+        !expect([&](std::string_view t) { return parseField(t, r.j, 1, 2); }) ||
+        !expect([&](std::string_view t) { return parseField(t, r.ht); }) ||
+        !expect([&](std::string_view t) { return parseField(t, r.top); }))
+        return ParseResult::Invalid;
+
+    for (double *value : {&r.wdir, &r.wspd, &r.t, &r.sa, &r.sw}) {
+        if (!expect([&](std::string_view t) { return parseField(t, *value); }))
+            return ParseResult::Invalid;
     }
-    return false;
+
+    if (!f.atEnd())
+        return ParseResult::Rejected;
+
+    updateTime(r);
+    return ParseResult::Ok;
+}
+
+//-----------------------------------------------------------------------------
+// Parallel File Parser
+//-----------------------------------------------------------------------------
+
+struct ParseWarning {
+    std::size_t line;   // one-based line number
+    std::string message;
+};
+
+template <class Record>
+struct ParsedRecords {
+    std::vector<Record> records;
+    std::vector<ParseWarning> warnings;
+    std::vector<std::uint64_t> offsets; // line start of each record
+    std::uint64_t end = 0;              // end of the last record line
+};
+
+// Parse records from a line-aligned range. Line numbers are relative to the
+// start of the range; byte offsets are relative to base.
+template <class Record, class Parser>
+ParsedRecords<Record> parseRange(const char *base, const char *first, const char *last, Parser parse, std::size_t& nlines)
+{
+    ParsedRecords<Record> result;
+    nlines = 0;
+
+    const char *p = first;
+    while (p < last) {
+        const char *eol = static_cast<const char *>(std::memchr(p, '\n', static_cast<std::size_t>(last - p)));
+        if (eol == nullptr)
+            eol = last;
+        nlines++;
+
+        Record x{};
+        std::size_t col = 0;
+        try {
+            switch (parse(p, eol, x, col)) {
+            case ParseResult::Ok:
+                result.records.push_back(x);
+                result.offsets.push_back(static_cast<std::uint64_t>(p - base));
+                result.end = static_cast<std::uint64_t>(std::min(eol + 1, last) - base);
+                break;
+            case ParseResult::Invalid:
+                result.warnings.push_back({nlines, fmt::format("column {}: invalid format", col)});
+                break;
+            default:
+                break;
+            }
+        } catch (const std::out_of_range& e) {
+            result.warnings.push_back({nlines, e.what()});
+        }
+
+        p = eol + 1;
+    }
+
+    return result;
 }
 
-inline bool readUpperAirRecord(const std::string& line, UpperAirRecord& record)
+// Split the text into line-aligned chunks and parse them concurrently.
+// Line numbers in warnings are offset by firstLine. The record offsets are
+// relative to base and are followed by the end of the last record line.
+template <class Record, class Parser>
+ParsedRecords<Record> parseRecords(const char *base, std::string_view text, std::size_t firstLine, Parser parse)
 {
-    using iterator_type = std::string::const_iterator;
-    static const UpperAirRecordParser<iterator_type> g;
+    constexpr std::size_t minChunkSize = 1 << 20;
+
+    std::size_t nthreads = std::max(1u, std::thread::hardware_concurrency());
+    std::size_t nchunks = std::clamp<std::size_t>(text.size() / minChunkSize, 1, nthreads);
+
+    std::vector<const char *> bounds{text.data()};
+    const char *end = text.data() + text.size();
+    for (std::size_t i = 1; i < nchunks; ++i) {
+        const char *p = text.data() + i * text.size() / nchunks;
+        p = std::max(p, bounds.back());
+        const char *eol = static_cast<const char *>(std::memchr(p, '\n', static_cast<std::size_t>(end - p)));
+        if (eol == nullptr)
+            break;
+        bounds.push_back(eol + 1);
+    }
+    bounds.push_back(end);
+
+    std::size_t n = bounds.size() - 1;
+    std::vector<std::size_t> nlines(n, 0);
+    std::vector<std::future<ParsedRecords<Record>>> futures;
+    for (std::size_t i = 1; i < n; ++i) {
+        futures.push_back(std::async(std::launch::async, [&, i]() {
+            return parseRange<Record>(base, bounds[i], bounds[i + 1], parse, nlines[i]);
+        }));
+    }
 
-    if (line.empty() || line.find_first_not_of(" \t") == std::string::npos)
-        return false;
+    std::vector<ParsedRecords<Record>> parts;
+    parts.push_back(parseRange<Record>(base, bounds[0], bounds[1], parse, nlines[0]));
+    for (auto& future : futures)
+        parts.push_back(future.get());
+
+    // Concatenate in file order.
+    ParsedRecords<Record> result;
+    std::size_t total = 0;
+    for (const auto& part : parts)
+        total += part.records.size();
+    result.records.reserve(total);
+    result.offsets.reserve(total + 1);
+
+    std::size_t lineOffset = firstLine - 1;
+    for (std::size_t i = 0; i < n; ++i) {
+        auto& part = parts[i];
+        std::move(part.records.begin(), part.records.end(), std::back_inserter(result.records));
+        result.offsets.insert(result.offsets.end(), part.offsets.begin(), part.offsets.end());
+        if (!part.records.empty())
+            result.end = part.end;
+        for (auto& warning : part.warnings) {
+            warning.line += lineOffset;
+            result.warnings.push_back(std::move(warning));
+        }
+        lineOffset += nlines[i];
+    }
+    result.offsets.push_back(result.end);
 
-    iterator_type it = line.begin();
-    iterator_type end = line.end();
-    // May throw qi::expectation_failure<std::string::const_iterator>
-    if (qi::phrase_parse(it, end, g, ascii::blank, record) && it == end) {
-        updateTime(record);
-        return true;
+    return result;
+}
+
+// Build the interval set from record times, coalescing consecutive hours.
+template <class Record>
+boost::icl::interval_set<boost::posix_time::ptime> hourIntervals(const std::vector<Record>& records)
+{
+    using namespace boost::posix_time;
+    using namespace boost::icl;
+
+    interval_set<ptime> result;
+    if (records.empty())
+        return result;
+
+    ptime lower = records.front().ptime;
+    ptime upper = lower + hours(1);
+    for (const auto& x : records) {
+        if (x.ptime == upper) {
+            upper += hours(1);
+        }
+        else if (x.ptime < lower || x.ptime >= upper) {
+            result += discrete_interval<ptime>::right_open(lower, upper);
+            lower = x.ptime;
+            upper = lower + hours(1);
+        }
     }
-    return false;
+    result += discrete_interval<ptime>::right_open(lower, upper);
+
+    return result;
+}
+
+// Split off the first line, without the line terminator.
+std::string_view firstLine(std::string_view text, std::string_view& rest)
+{
+    auto pos = text.find('\n');
+    std::string_view line = text.substr(0, pos);
+    rest = pos == std::string_view::npos ? std::string_view() : text.substr(pos + 1);
+    if (!line.empty() && line.back() == '\r')
+        line.remove_suffix(1);
+    return line;
+}
+
+} // namespace
+
+//-----------------------------------------------------------------------------
+// SurfaceData
+//-----------------------------------------------------------------------------
+
+SurfaceData::SurfaceData(const std::vector<SurfaceRecord>& records,
+                         std::vector<std::uint64_t> offsets, std::uint64_t size)
+    : offset(std::move(offsets)), fileSize(size)
+{
+    std::size_t n = records.size();
+    hour.reserve(n);
+    wspd.reserve(n);
+    wdir.reserve(n);
+    t.reserve(n);
+    mol.reserve(n);
+    flags.reserve(n);
+
+    for (const auto& x : records) {
+        hour.push_back(HourIndex::fromTime(x.ptime));
+        wspd.push_back(x.wspd);
+        wdir.push_back(x.wdir);
+        t.push_back(x.t);
+        mol.push_back(x.mol);
+        flags.push_back((x.calm ? Calm : 0) | (x.missing ? Missing : 0));
+    }
+}
+
+std::size_t SurfaceData::lowerBound(const boost::posix_time::ptime& t) const
+{
+    auto it = std::lower_bound(hour.begin(), hour.end(), HourIndex::fromTime(t));
+    return static_cast<std::size_t>(std::distance(hour.begin(), it));
+}
+
+std::size_t SurfaceData::upperBound(const boost::posix_time::ptime& t) const
+{
+    auto it = std::upper_bound(hour.begin(), hour.end(), HourIndex::fromTime(t));
+    return static_cast<std::size_t>(std::distance(hour.begin(), it));
+}
+
+bool SurfaceData::hasOffsets() const
+{
+    return offset.size() == hour.size() + 1;
+}
+
+//-----------------------------------------------------------------------------
+// UpperAirData
+//-----------------------------------------------------------------------------
+
+UpperAirData::UpperAirData(const std::vector<UpperAirRecord>& records,
+                           std::vector<std::uint64_t> offsets, std::uint64_t size)
+    : offset(std::move(offsets)), fileSize(size)
+{
+    std::size_t n = records.size();
+    hour.reserve(n);
+    ht.reserve(n);
+    wspd.reserve(n);
+    wdir.reserve(n);
+    t.reserve(n);
+    top.reserve(n);
+
+    for (const auto& x : records) {
+        hour.push_back(HourIndex::fromTime(x.ptime));
+        ht.push_back(x.ht);
+        wspd.push_back(x.wspd);
+        wdir.push_back(x.wdir);
+        t.push_back(x.t);
+        top.push_back(x.top != 0);
+    }
+}
+
+bool UpperAirData::hasOffsets() const
+{
+    return offset.size() == hour.size() + 1;
 }
 
 //-----------------------------------------------------------------------------
@@ -294,69 +581,64 @@ SurfaceFile::SurfaceFile(const std::filesystem::path& p)
 {
     BOOST_LOG_SCOPED_THREAD_TAG("Source", "Meteorology")
 
-    using namespace boost::gregorian;
-    using namespace boost::posix_time;
-    using namespace boost::icl;
-
-    using iterator_type = std::string::const_iterator;
-
-    std::ifstream ifs(p, std::ios_base::in);
-    if (!ifs) {
+    MappedFile file(p);
+    if (!file.isOpen()) {
         BOOST_LOG_TRIVIAL(error) << fmt::format("Failed to open surface file: '{}'", p.string());
         return;
     }
 
-    std::size_t nlines = 0;
-    std::string line;
-    if (!std::getline(ifs, line) || !readSurfaceHeader(line, header_)) {
+    MeteorologyCache::Key key;
+    if (MeteorologyCache::enabled()) {
+        key = MeteorologyCache::makeKey(p, file.view());
+        MeteorologyCache::SurfaceEntry entry;
+        if (MeteorologyCache::load(key, entry)) {
+            header_ = entry.header;
+            nhours_ = entry.nhours;
+            ncalm_ = entry.ncalm;
+            nmissing_ = entry.nmissing;
+            intervals_ = std::move(entry.intervals);
+            data_ = std::move(entry.data);
+            return;
+        }
+    }
+
+    std::string_view rest;
+    std::string line(firstLine(file.view(), rest));
+    if (file.size() == 0 || !readSurfaceHeader(line, header_)) {
         BOOST_LOG_TRIVIAL(error) << fmt::format("Surface file '{}': invalid header", p.string());
         return;
     }
-    nlines++;
 
-    while (std::getline(ifs, line)) {
-        nlines++;
-        try {
-            SurfaceRecord x;
-            if (readSurfaceRecord(line, x)) {
-                intervals_ += discrete_interval<ptime>::right_open(x.ptime, x.ptime + hours(1));
-                nhours_++;
-                if (x.calm) ncalm_++;
-                if (x.missing) nmissing_++;
-            }
-        } catch (const std::out_of_range& e) {
-            BOOST_LOG_TRIVIAL(warning) << fmt::format("Surface file '{}', line {}: {}", p.string(), nlines, e.what());
-        } catch (qi::expectation_failure<iterator_type>& e) {
-            auto col = e.first - line.begin();
-            BOOST_LOG_TRIVIAL(warning) << fmt::format("Surface file '{}', line {}, column {}: invalid format", p.string(), nlines, col);
-        }
+    auto parsed = parseRecords<SurfaceRecord>(file.data(), rest, 2, readSurfaceRecord);
+
+    for (const auto& warning : parsed.warnings)
+        BOOST_LOG_TRIVIAL(warning) << fmt::format("Surface file '{}', line {}: {}", p.string(), warning.line, warning.message);
+
+    for (const auto& x : parsed.records) {
+        if (x.calm) ncalm_++;
+        if (x.missing) nmissing_++;
     }
+
+    nhours_ = parsed.records.size();
+    intervals_ = hourIntervals(parsed.records);
+    data_ = std::make_shared<const SurfaceData>(parsed.records, std::move(parsed.offsets), file.size());
+
+    // Files with warnings are not cached, so the warnings are repeated
+    // the next time the file is opened.
+    if (MeteorologyCache::enabled() && parsed.warnings.empty())
+        MeteorologyCache::save(key, {header_, nhours_, ncalm_, nmissing_, intervals_, data_});
 }
 
 std::vector<SurfaceRecord> SurfaceFile::records() const
 {
-    using namespace boost::gregorian;
-    using namespace boost::posix_time;
+    MappedFile file(path_);
+    if (!file.isOpen() || file.size() == 0)
+        return {};
 
-    std::vector<SurfaceRecord> result;
-
-    std::ifstream ifs(path_, std::ios_base::in);
-    if (!ifs)
-        return result;
-
-    std::string line;
-    if (!std::getline(ifs, line))
-        return result;
-
-    while (std::getline(ifs, line)) {
-        SurfaceRecord x;
-        try {
-            readSurfaceRecord(line, x);
-            result.push_back(x);
-        } catch (...) {}
-    }
+    std::string_view rest;
+    firstLine(file.view(), rest);
 
-    return result;
+    return parseRecords<SurfaceRecord>(file.data(), rest, 2, readSurfaceRecord).records;
 }
 
 //-----------------------------------------------------------------------------
@@ -368,57 +650,151 @@ UpperAirFile::UpperAirFile(const std::filesystem::path& p)
 {
     BOOST_LOG_SCOPED_THREAD_TAG("Source", "Meteorology")
 
-    using namespace boost::gregorian;
-    using namespace boost::posix_time;
-    using namespace boost::icl;
-
-    using iterator_type = std::string::const_iterator;
-
-    std::ifstream ifs(p, std::ios_base::in);
-    if (!ifs) {
+    MappedFile file(p);
+    if (!file.isOpen()) {
         BOOST_LOG_TRIVIAL(error) << fmt::format("Failed to open upper air file: '{}'", p.string());
         return;
     }
 
-    std::size_t nlines = 0;
-    std::string line;
-    while (std::getline(ifs, line)) {
-        nlines++;
-        try {
-            UpperAirRecord x;
-            if (readUpperAirRecord(line, x)) {
-                intervals_ += discrete_interval<ptime>::right_open(x.ptime, x.ptime + hours(1));
-                nhours_++;
-            }
-        } catch (const std::out_of_range& e) {
-            BOOST_LOG_TRIVIAL(warning) << fmt::format("Upper air file '{}', line {}: {}", p.string(), nlines, e.what());
-        } catch (qi::expectation_failure<iterator_type>& e) {
-            auto col = e.first - line.begin();
-            BOOST_LOG_TRIVIAL(warning) << fmt::format("Upper air '{}', line {}, column {}: invalid format", p.string(), nlines, col);
+    MeteorologyCache::Key key;
+    if (MeteorologyCache::enabled()) {
+        key = MeteorologyCache::makeKey(p, file.view());
+        MeteorologyCache::UpperAirEntry entry;
+        if (MeteorologyCache::load(key, entry)) {
+            nhours_ = entry.nhours;
+            intervals_ = std::move(entry.intervals);
+            data_ = std::move(entry.data);
+            return;
         }
     }
+
+    auto parsed = parseRecords<UpperAirRecord>(file.data(), file.view(), 1, readUpperAirRecord);
+
+    for (const auto& warning : parsed.warnings)
+        BOOST_LOG_TRIVIAL(warning) << fmt::format("Upper air file '{}', line {}: {}", p.string(), warning.line, warning.message);
+
+    nhours_ = parsed.records.size();
+    intervals_ = hourIntervals(parsed.records);
+    data_ = std::make_shared<const UpperAirData>(parsed.records, std::move(parsed.offsets), file.size());
+
+    if (MeteorologyCache::enabled() && parsed.warnings.empty())
+        MeteorologyCache::save(key, {nhours_, intervals_, data_});
 }
 
 std::vector<UpperAirRecord> UpperAirFile::records() const
 {
-    using namespace boost::gregorian;
-    using namespace boost::posix_time;
+    MappedFile file(path_);
+    if (!file.isOpen())
+        return {};
 
-    std::vector<UpperAirRecord> result;
+    return parseRecords<UpperAirRecord>(file.data(), file.view(), 1, readUpperAirRecord).records;
+}
 
-    std::ifstream ifs(path_, std::ios_base::in);
-    if (!ifs)
-        return result;
+//-----------------------------------------------------------------------------
+// MeteorologyJoin
+//-----------------------------------------------------------------------------
 
-    std::string line;
-    while (std::getline(ifs, line)) {
-        UpperAirRecord x;
-        try {
-            readUpperAirRecord(line, x);
-            result.push_back(x);
-        } catch (...) {}
+MeteorologyJoin::MeteorologyJoin(std::shared_ptr<const SurfaceData> sfc, std::shared_ptr<const UpperAirData> ua)
+    : surface(std::move(sfc)), upperAir(std::move(ua))
+{
+    const auto& sh = surface->hour;
+    const auto& uh = upperAir->hour;
+    const std::size_t ns = sh.size();
+    const std::size_t nu = uh.size();
+
+    profile.assign(ns, -1);
+
+    // Merge the hour indices. Profiles have several levels per hour.
+    std::size_t j = 0;
+    std::int32_t matched = std::numeric_limits<std::int32_t>::min();
+    auto skipProfile = [&]() {
+        std::int32_t h = uh[j];
+        if (h != matched)
+            unmatchedProfiles++;
+        while (j < nu && uh[j] == h)
+            j++;
+        if (j < nu && uh[j] < h)
+            ordered = false;
+    };
+
+    MonthSummary *month = nullptr;
+    for (std::size_t i = 0; i < ns; ++i) {
+        const std::int32_t h = sh[i];
+
+        if (i > 0) {
+            if (h <= sh[i - 1])
+                ordered = false;
+            else if (h > sh[i - 1] + 1)
+                gaps.emplace_back(sh[i - 1] + 1, h - 1);
+        }
+
+        while (j < nu && uh[j] < h)
+            skipProfile();
+
+        bool found = j < nu && uh[j] == h;
+        if (found) {
+            profile[i] = static_cast<std::int64_t>(j);
+            matched = h;
+        }
+        else {
+            missingProfiles++;
+        }
+
+        // Monthly summary.
+        auto date = surface->time(i).date();
+        int y = date.year();
+        int m = date.month();
+        if (!month || month->year != y || month->month != m) {
+            months.push_back(MonthSummary{y, m});
+            month = &months.back();
+        }
+        month->hours++;
+        if (surface->calm(i))
+            month->calm++;
+        else if (surface->missing(i))
+            month->missing++;
+        if (!found)
+            month->missingProfiles++;
     }
 
-    return result;
+    while (j < nu)
+        skipProfile();
+}
+
+//-----------------------------------------------------------------------------
+// Meteorology
+//-----------------------------------------------------------------------------
+
+Meteorology::Meteorology(const std::filesystem::path& sfc, const std::filesystem::path& pfl)
+    : surfaceFile(sfc), upperAirFile(pfl)
+{
+    join_ = std::make_shared<const MeteorologyJoin>(surfaceData(), upperAirData());
+}
+
+std::shared_ptr<const SurfaceData> Meteorology::surfaceData() const
+{
+    static const auto empty = std::make_shared<const SurfaceData>(std::vector<SurfaceRecord>());
+    auto data = surfaceFile.data();
+    return data ? data : empty;
+}
+
+std::shared_ptr<const UpperAirData> Meteorology::upperAirData() const
+{
+    static const auto empty = std::make_shared<const UpperAirData>(std::vector<UpperAirRecord>());
+    auto data = upperAirFile.data();
+    return data ? data : empty;
 }
 
+std::shared_ptr<const MeteorologyJoin> Meteorology::join() const
+{
+    auto sfc = surfaceData();
+    auto ua = upperAirData();
+
+    auto cached = std::atomic_load(&join_);
+    if (cached && cached->surface == sfc && cached->upperAir == ua)
+        return cached;
+
+    auto result = std::make_shared<const MeteorologyJoin>(sfc, ua);
+    std::atomic_store(&join_, result);
+    return result;
+}
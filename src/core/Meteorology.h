@@ -15,6 +15,7 @@
 
 #pragma once
 
+#include <cstdint>
 #include <filesystem>
 #include <istream>
 #include <locale>
@@ -152,6 +153,126 @@ inline std::ostream& operator<<(std::ostream& os, const boost::icl::discrete_int
     return os;
 }
 
+//-----------------------------------------------------------------------------
+// HourIndex
+//-----------------------------------------------------------------------------
+
+// Compact time column; hours since 1900-01-01 00:00 UTC.
+struct HourIndex
+{
+    static boost::posix_time::ptime epoch() {
+        return boost::posix_time::ptime(boost::gregorian::date(1900, 1, 1));
+    }
+
+    static std::int32_t fromTime(const boost::posix_time::ptime& t) {
+        return static_cast<std::int32_t>((t - epoch()).hours());
+    }
+
+    static boost::posix_time::ptime toTime(std::int32_t h) {
+        return epoch() + boost::posix_time::hours(h);
+    }
+};
+
+//-----------------------------------------------------------------------------
+// SurfaceData
+//-----------------------------------------------------------------------------
+
+// Immutable columnar store of the surface variables used by the
+// application, built once when the file is parsed and shared by copies.
+struct SurfaceData
+{
+    enum Flags : std::uint8_t {
+        Calm    = 0x01,
+        Missing = 0x02
+    };
+
+    SurfaceData() = default;
+    explicit SurfaceData(const std::vector<SurfaceRecord>& records,
+                         std::vector<std::uint64_t> offsets = {},
+                         std::uint64_t size = 0);
+
+    std::size_t size() const {
+        return hour.size();
+    }
+
+    bool empty() const {
+        return hour.empty();
+    }
+
+    boost::posix_time::ptime time(std::size_t i) const {
+        return HourIndex::toTime(hour[i]);
+    }
+
+    bool calm(std::size_t i) const {
+        return flags[i] & Calm;
+    }
+
+    bool missing(std::size_t i) const {
+        return flags[i] & Missing;
+    }
+
+    // Index of the first record at or after t.
+    std::size_t lowerBound(const boost::posix_time::ptime& t) const;
+
+    // Index of the first record after t.
+    std::size_t upperBound(const boost::posix_time::ptime& t) const;
+
+    // True if the byte offsets of the records in the file are known.
+    bool hasOffsets() const;
+
+    std::vector<std::int32_t> hour;
+    std::vector<double> wspd;
+    std::vector<double> wdir;
+    std::vector<double> t;
+    std::vector<double> mol;
+    std::vector<std::uint8_t> flags;
+
+    // Line start of each record in the file, followed by the end of the
+    // last record line, and the size of the file when it was parsed.
+    std::vector<std::uint64_t> offset;
+    std::uint64_t fileSize = 0;
+};
+
+//-----------------------------------------------------------------------------
+// UpperAirData
+//-----------------------------------------------------------------------------
+
+// Immutable columnar store of profile levels, one entry per level.
+struct UpperAirData
+{
+    UpperAirData() = default;
+    explicit UpperAirData(const std::vector<UpperAirRecord>& records,
+                          std::vector<std::uint64_t> offsets = {},
+                          std::uint64_t size = 0);
+
+    std::size_t size() const {
+        return hour.size();
+    }
+
+    bool empty() const {
+        return hour.empty();
+    }
+
+    boost::posix_time::ptime time(std::size_t i) const {
+        return HourIndex::toTime(hour[i]);
+    }
+
+    // True if the byte offsets of the levels in the file are known.
+    bool hasOffsets() const;
+
+    std::vector<std::int32_t> hour;
+    std::vector<double> ht;
+    std::vector<double> wspd;
+    std::vector<double> wdir;
+    std::vector<double> t;
+    std::vector<std::uint8_t> top;
+
+    // Line start of each level in the file, followed by the end of the
+    // last level line, and the size of the file when it was parsed.
+    std::vector<std::uint64_t> offset;
+    std::uint64_t fileSize = 0;
+};
+
 //-----------------------------------------------------------------------------
 // SurfaceFile
 //-----------------------------------------------------------------------------
@@ -203,11 +324,16 @@ struct SurfaceFile
         return header_;
     }
 
+    std::shared_ptr<const SurfaceData> data() const {
+        return data_;
+    }
+
     std::vector<SurfaceRecord> records() const;
 
 private:
     std::filesystem::path path_;
     SurfaceHeader header_;
+    std::shared_ptr<const SurfaceData> data_;
     std::size_t nhours_ = 0;
     std::size_t ncalm_ = 0;
     std::size_t nmissing_ = 0;
@@ -253,14 +379,55 @@ struct UpperAirFile
         return intervals_;
     }
 
+    std::shared_ptr<const UpperAirData> data() const {
+        return data_;
+    }
+
     std::vector<UpperAirRecord> records() const;
 
 private:
     std::filesystem::path path_;
+    std::shared_ptr<const UpperAirData> data_;
     std::size_t nhours_ = 0;
     boost::icl::interval_set<boost::posix_time::ptime> intervals_;
 };
 
+//-----------------------------------------------------------------------------
+// MeteorologyJoin
+//-----------------------------------------------------------------------------
+
+// Hour-by-hour join of surface records and upper air profiles, built with a
+// single merge of the two hour indices.
+struct MeteorologyJoin
+{
+    struct MonthSummary {
+        int year = 0;
+        int month = 0;
+        std::size_t hours = 0;
+        std::size_t calm = 0;
+        std::size_t missing = 0;
+        std::size_t missingProfiles = 0;
+    };
+
+    MeteorologyJoin(std::shared_ptr<const SurfaceData> sfc, std::shared_ptr<const UpperAirData> ua);
+
+    std::shared_ptr<const SurfaceData> surface;
+    std::shared_ptr<const UpperAirData> upperAir;
+
+    // First upper air level for each surface record, or -1 if there is no
+    // profile for the hour.
+    std::vector<std::int64_t> profile;
+
+    std::size_t missingProfiles = 0;    // surface hours without a profile
+    std::size_t unmatchedProfiles = 0;  // profile hours without a surface record
+    bool ordered = true;                // both files in chronological order
+
+    // Runs of hours missing from the surface file, inclusive.
+    std::vector<std::pair<std::int32_t, std::int32_t>> gaps;
+
+    std::vector<MonthSummary> months;
+};
+
 //-----------------------------------------------------------------------------
 // Meteorology
 //-----------------------------------------------------------------------------
@@ -268,8 +435,15 @@ private:
 struct Meteorology
 {
     Meteorology() {}
-    Meteorology(const std::filesystem::path& sfc, const std::filesystem::path& pfl)
-        : surfaceFile(sfc), upperAirFile(pfl) {}
+    Meteorology(const std::filesystem::path& sfc, const std::filesystem::path& pfl);
+
+    // Parsed data is shared with copies of this object; never null.
+    std::shared_ptr<const SurfaceData> surfaceData() const;
+    std::shared_ptr<const UpperAirData> upperAirData() const;
+
+    // Join of the current surface and upper air data; rebuilt if either
+    // file has been replaced.
+    std::shared_ptr<const MeteorologyJoin> join() const;
 
     std::string name;
     SurfaceFile surfaceFile;
@@ -277,4 +451,7 @@ struct Meteorology
     double terrainElevation = 0;
     double anemometerHeight = 10;
     double windRotation = 0;
+
+private:
+    mutable std::shared_ptr<const MeteorologyJoin> join_;
 };
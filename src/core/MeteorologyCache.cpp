@@ -0,0 +1,403 @@
+// Copyright 2020 Dow, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#include "core/MeteorologyCache.h"
+#include "core/MappedFile.h"
+
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <system_error>
+#include <type_traits>
+#include <vector>
+
+#include <boost/log/trivial.hpp>
+#include <boost/log/attributes/scoped_attribute.hpp>
+
+#include <fmt/format.h>
+
+namespace MeteorologyCache {
+
+namespace {
+
+constexpr char CACHE_MAGIC[8] = {'S', 'O', 'F', 'E', 'A', 'M', 'E', 'T'};
+constexpr std::uint32_t CACHE_VERSION = 2;
+constexpr std::uint32_t CACHE_BYTE_ORDER = 0x01020304;
+
+enum class Kind : std::uint32_t {
+    Surface = 1,
+    UpperAir = 2
+};
+
+std::mutex dirMutex;
+std::filesystem::path dir;
+
+//-----------------------------------------------------------------------------
+// Hashing
+//-----------------------------------------------------------------------------
+
+// FNV-1a variant over 64-bit words, with a byte-wise tail.
+std::uint64_t hash64(std::string_view s)
+{
+    constexpr std::uint64_t prime = 0x100000001b3;
+    std::uint64_t h = 0xcbf29ce484222325;
+
+    std::size_t i = 0;
+    for (; i + 8 <= s.size(); i += 8) {
+        std::uint64_t w;
+        std::memcpy(&w, s.data() + i, 8);
+        h = (h ^ w) * prime;
+        h ^= h >> 32;
+    }
+    for (; i < s.size(); ++i)
+        h = (h ^ static_cast<unsigned char>(s[i])) * prime;
+
+    return h;
+}
+
+//-----------------------------------------------------------------------------
+// Serialization
+//-----------------------------------------------------------------------------
+
+class Writer
+{
+public:
+    template <typename T>
+    void put(const T& value) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        buffer_.append(reinterpret_cast<const char *>(&value), sizeof(T));
+    }
+
+    void put(const std::string& s) {
+        put<std::uint64_t>(s.size());
+        buffer_.append(s);
+    }
+
+    template <typename T>
+    void put(const std::vector<T>& v) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        put<std::uint64_t>(v.size());
+        buffer_.append(reinterpret_cast<const char *>(v.data()), v.size() * sizeof(T));
+    }
+
+    const std::string& buffer() const {
+        return buffer_;
+    }
+
+private:
+    std::string buffer_;
+};
+
+class Reader
+{
+public:
+    explicit Reader(std::string_view data) : data_(data) {}
+
+    template <typename T>
+    bool get(T& value) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        if (data_.size() - pos_ < sizeof(T))
+            return false;
+        std::memcpy(&value, data_.data() + pos_, sizeof(T));
+        pos_ += sizeof(T);
+        return true;
+    }
+
+    bool get(std::string& s) {
+        std::uint64_t n;
+        if (!get(n) || data_.size() - pos_ < n)
+            return false;
+        s.assign(data_.data() + pos_, n);
+        pos_ += n;
+        return true;
+    }
+
+    template <typename T>
+    bool get(std::vector<T>& v) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        std::uint64_t n;
+        if (!get(n) || (data_.size() - pos_) / sizeof(T) < n)
+            return false;
+        v.resize(n);
+        std::memcpy(v.data(), data_.data() + pos_, n * sizeof(T));
+        pos_ += n * sizeof(T);
+        return true;
+    }
+
+    bool atEnd() const {
+        return pos_ == data_.size();
+    }
+
+private:
+    std::string_view data_;
+    std::size_t pos_ = 0;
+};
+
+void putHeader(Writer& w, Kind kind, const Key& key)
+{
+    w.put(CACHE_MAGIC);
+    w.put(CACHE_VERSION);
+    w.put(CACHE_BYTE_ORDER);
+    w.put(static_cast<std::uint32_t>(kind));
+    w.put(key.path);
+    w.put(key.size);
+    w.put(key.mtime);
+    w.put(key.hash);
+}
+
+bool getHeader(Reader& r, Kind kind, const Key& key)
+{
+    char magic[8];
+    std::uint32_t version, byteOrder, k;
+    Key cached;
+
+    return r.get(magic) && std::memcmp(magic, CACHE_MAGIC, sizeof(magic)) == 0 &&
+           r.get(version) && version == CACHE_VERSION &&
+           r.get(byteOrder) && byteOrder == CACHE_BYTE_ORDER &&
+           r.get(k) && k == static_cast<std::uint32_t>(kind) &&
+           r.get(cached.path) && cached.path == key.path &&
+           r.get(cached.size) && cached.size == key.size &&
+           r.get(cached.mtime) && cached.mtime == key.mtime &&
+           r.get(cached.hash) && cached.hash == key.hash;
+}
+
+void putIntervals(Writer& w, const boost::icl::interval_set<boost::posix_time::ptime>& intervals)
+{
+    std::vector<std::int32_t> bounds;
+    bounds.reserve(intervals.iterative_size() * 2);
+    for (const auto& i : intervals) {
+        bounds.push_back(HourIndex::fromTime(i.lower()));
+        bounds.push_back(HourIndex::fromTime(i.upper()));
+    }
+    w.put(bounds);
+}
+
+bool getIntervals(Reader& r, boost::icl::interval_set<boost::posix_time::ptime>& intervals)
+{
+    using namespace boost::icl;
+    using boost::posix_time::ptime;
+
+    std::vector<std::int32_t> bounds;
+    if (!r.get(bounds) || bounds.size() % 2 != 0)
+        return false;
+
+    intervals.clear();
+    for (std::size_t i = 0; i < bounds.size(); i += 2) {
+        intervals += discrete_interval<ptime>::right_open(
+            HourIndex::toTime(bounds[i]), HourIndex::toTime(bounds[i + 1]));
+    }
+    return true;
+}
+
+std::filesystem::path entryPath(const Key& key, Kind kind)
+{
+    std::string ext = kind == Kind::Surface ? "sfc" : "pfl";
+    return cacheDirectory() / fmt::format("{:016x}.{}.cache", hash64(key.path), ext);
+}
+
+void write(const std::filesystem::path& p, const std::string& contents)
+{
+    BOOST_LOG_SCOPED_THREAD_TAG("Source", "Meteorology")
+
+    std::error_code ec;
+    std::filesystem::create_directories(p.parent_path(), ec);
+
+    // Write to a temporary file and rename, so readers never see a
+    // partially written entry.
+    std::filesystem::path tmp = p;
+    tmp += ".tmp";
+
+    std::ofstream ofs(tmp, std::ios::out | std::ios::binary | std::ios::trunc);
+    ofs.write(contents.data(), static_cast<std::streamsize>(contents.size()));
+    ofs.close();
+
+    if (!ofs) {
+        BOOST_LOG_TRIVIAL(warning) << fmt::format("Failed to write meteorology cache: '{}'", tmp.string());
+        std::filesystem::remove(tmp, ec);
+        return;
+    }
+
+    std::filesystem::rename(tmp, p, ec);
+    if (ec) {
+        BOOST_LOG_TRIVIAL(warning) << fmt::format("Failed to write meteorology cache: '{}': {}", p.string(), ec.message());
+        std::filesystem::remove(tmp, ec);
+    }
+}
+
+} // namespace
+
+//-----------------------------------------------------------------------------
+// Cache Directory
+//-----------------------------------------------------------------------------
+
+void setCacheDirectory(const std::filesystem::path& path) noexcept
+{
+    std::lock_guard<std::mutex> lock(dirMutex);
+    dir = path;
+}
+
+std::filesystem::path cacheDirectory() noexcept
+{
+    std::lock_guard<std::mutex> lock(dirMutex);
+    return dir;
+}
+
+bool enabled() noexcept
+{
+    return !cacheDirectory().empty();
+}
+
+//-----------------------------------------------------------------------------
+// Cache Entries
+//-----------------------------------------------------------------------------
+
+Key makeKey(const std::filesystem::path& p, std::string_view contents)
+{
+    Key key;
+
+    std::error_code ec;
+    auto ap = std::filesystem::absolute(p, ec);
+    key.path = ec ? p.string() : ap.lexically_normal().string();
+    key.size = contents.size();
+
+    auto mtime = std::filesystem::last_write_time(p, ec);
+    if (!ec)
+        key.mtime = static_cast<std::int64_t>(mtime.time_since_epoch().count());
+
+    key.hash = hash64(contents);
+    return key;
+}
+
+bool load(const Key& key, SurfaceEntry& entry)
+{
+    if (!enabled())
+        return false;
+
+    MappedFile file(entryPath(key, Kind::Surface));
+    if (!file.isOpen())
+        return false;
+
+    Reader r(file.view());
+    if (!getHeader(r, Kind::Surface, key))
+        return false;
+
+    std::uint64_t nhours, ncalm, nmissing;
+    auto data = std::make_shared<SurfaceData>();
+
+    bool ok = r.get(entry.header.mplat) && r.get(entry.header.mplon) &&
+              r.get(entry.header.ualoc) && r.get(entry.header.sfloc) &&
+              r.get(entry.header.osloc) && r.get(entry.header.versno) &&
+              r.get(nhours) && r.get(ncalm) && r.get(nmissing) &&
+              getIntervals(r, entry.intervals) &&
+              r.get(data->hour) && r.get(data->wspd) && r.get(data->wdir) &&
+              r.get(data->t) && r.get(data->mol) && r.get(data->flags) &&
+              r.get(data->offset) && r.get(data->fileSize) &&
+              r.atEnd();
+
+    std::size_t n = data->hour.size();
+    if (!ok || data->wspd.size() != n || data->wdir.size() != n ||
+        data->t.size() != n || data->mol.size() != n || data->flags.size() != n)
+        return false;
+
+    entry.nhours = nhours;
+    entry.ncalm = ncalm;
+    entry.nmissing = nmissing;
+    entry.data = std::move(data);
+    return true;
+}
+
+bool load(const Key& key, UpperAirEntry& entry)
+{
+    if (!enabled())
+        return false;
+
+    MappedFile file(entryPath(key, Kind::UpperAir));
+    if (!file.isOpen())
+        return false;
+
+    Reader r(file.view());
+    if (!getHeader(r, Kind::UpperAir, key))
+        return false;
+
+    std::uint64_t nhours;
+    auto data = std::make_shared<UpperAirData>();
+
+    bool ok = r.get(nhours) &&
+              getIntervals(r, entry.intervals) &&
+              r.get(data->hour) && r.get(data->ht) && r.get(data->wspd) &&
+              r.get(data->wdir) && r.get(data->t) && r.get(data->top) &&
+              r.get(data->offset) && r.get(data->fileSize) &&
+              r.atEnd();
+
+    std::size_t n = data->hour.size();
+    if (!ok || data->ht.size() != n || data->wspd.size() != n ||
+        data->wdir.size() != n || data->t.size() != n || data->top.size() != n)
+        return false;
+
+    entry.nhours = nhours;
+    entry.data = std::move(data);
+    return true;
+}
+
+void save(const Key& key, const SurfaceEntry& entry)
+{
+    if (!enabled() || !entry.data)
+        return;
+
+    Writer w;
+    putHeader(w, Kind::Surface, key);
+    w.put(entry.header.mplat);
+    w.put(entry.header.mplon);
+    w.put(entry.header.ualoc);
+    w.put(entry.header.sfloc);
+    w.put(entry.header.osloc);
+    w.put(entry.header.versno);
+    w.put<std::uint64_t>(entry.nhours);
+    w.put<std::uint64_t>(entry.ncalm);
+    w.put<std::uint64_t>(entry.nmissing);
+    putIntervals(w, entry.intervals);
+    w.put(entry.data->hour);
+    w.put(entry.data->wspd);
+    w.put(entry.data->wdir);
+    w.put(entry.data->t);
+    w.put(entry.data->mol);
+    w.put(entry.data->flags);
+    w.put(entry.data->offset);
+    w.put(entry.data->fileSize);
+
+    write(entryPath(key, Kind::Surface), w.buffer());
+}
+
+void save(const Key& key, const UpperAirEntry& entry)
+{
+    if (!enabled() || !entry.data)
+        return;
+
+    Writer w;
+    putHeader(w, Kind::UpperAir, key);
+    w.put<std::uint64_t>(entry.nhours);
+    putIntervals(w, entry.intervals);
+    w.put(entry.data->hour);
+    w.put(entry.data->ht);
+    w.put(entry.data->wspd);
+    w.put(entry.data->wdir);
+    w.put(entry.data->t);
+    w.put(entry.data->top);
+    w.put(entry.data->offset);
+    w.put(entry.data->fileSize);
+
+    write(entryPath(key, Kind::UpperAir), w.buffer());
+}
+
+} // namespace MeteorologyCache
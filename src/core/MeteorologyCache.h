@@ -0,0 +1,71 @@
+// Copyright 2020 Dow, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "core/Meteorology.h"
+
+// Binary cache of parsed meteorology files. Entries are stored in the cache
+// directory, one file per source file, and are validated against the source
+// path, size, modification time and a hash of the contents. Caching is
+// disabled until a cache directory is set.
+
+namespace MeteorologyCache {
+
+struct Key {
+    std::string path;
+    std::uint64_t size = 0;
+    std::int64_t mtime = 0;
+    std::uint64_t hash = 0;
+};
+
+struct SurfaceEntry {
+    SurfaceHeader header;
+    std::size_t nhours = 0;
+    std::size_t ncalm = 0;
+    std::size_t nmissing = 0;
+    boost::icl::interval_set<boost::posix_time::ptime> intervals;
+    std::shared_ptr<const SurfaceData> data;
+};
+
+struct UpperAirEntry {
+    std::size_t nhours = 0;
+    boost::icl::interval_set<boost::posix_time::ptime> intervals;
+    std::shared_ptr<const UpperAirData> data;
+};
+
+void setCacheDirectory(const std::filesystem::path& dir) noexcept;
+
+std::filesystem::path cacheDirectory() noexcept;
+
+bool enabled() noexcept;
+
+// Key for a source file given its contents.
+Key makeKey(const std::filesystem::path& p, std::string_view contents);
+
+bool load(const Key& key, SurfaceEntry& entry);
+
+bool load(const Key& key, UpperAirEntry& entry);
+
+void save(const Key& key, const SurfaceEntry& entry);
+
+void save(const Key& key, const UpperAirEntry& entry);
+
+} // namespace MeteorologyCache
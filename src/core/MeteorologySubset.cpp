@@ -0,0 +1,102 @@
+// Copyright 2020 Dow, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#include "core/MeteorologySubset.h"
+#include "core/MappedFile.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+#include <boost/log/trivial.hpp>
+#include <boost/log/attributes/scoped_attribute.hpp>
+
+#include <fmt/format.h>
+
+namespace MeteorologySubset {
+
+namespace {
+
+template <class Data>
+bool copyRecords(const std::filesystem::path& src, const Data& data, bool header,
+                 const HourSet& windows, const std::filesystem::path& out)
+{
+    BOOST_LOG_SCOPED_THREAD_TAG("Source", "Meteorology")
+
+    if (!data.hasOffsets())
+        return false;
+
+    MappedFile in(src);
+    if (!in.isOpen() || in.size() != data.fileSize) {
+        BOOST_LOG_TRIVIAL(warning) << fmt::format("Meteorology file '{}' has changed since it was opened", src.string());
+        return false;
+    }
+
+    std::ofstream ofs(out, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!ofs) {
+        BOOST_LOG_TRIVIAL(error) << fmt::format("Failed to create '{}'", out.string());
+        return false;
+    }
+
+    if (header && in.size() > 0) {
+        const char *eol = static_cast<const char *>(std::memchr(in.data(), '\n', in.size()));
+        std::size_t n = eol ? static_cast<std::size_t>(eol - in.data()) + 1 : in.size();
+        ofs.write(in.data(), static_cast<std::streamsize>(n));
+    }
+
+    for (const auto& window : windows) {
+        // Records from the first hour up to and including the last hour.
+        auto i0 = std::lower_bound(data.hour.begin(), data.hour.end(),
+                                   HourIndex::fromTime(boost::icl::first(window)));
+        auto i1 = std::upper_bound(i0, data.hour.end(),
+                                   HourIndex::fromTime(boost::icl::last(window)));
+        if (i0 == i1)
+            continue;
+
+        std::uint64_t first = data.offset[static_cast<std::size_t>(i0 - data.hour.begin())];
+        std::uint64_t last = data.offset[static_cast<std::size_t>(i1 - data.hour.begin())];
+        ofs.write(in.data() + first, static_cast<std::streamsize>(last - first));
+    }
+
+    ofs.close();
+    if (!ofs) {
+        BOOST_LOG_TRIVIAL(error) << fmt::format("Failed to write '{}'", out.string());
+        return false;
+    }
+
+    return true;
+}
+
+} // namespace
+
+bool writeSurfaceFile(const SurfaceFile& sf, const HourSet& windows, const std::filesystem::path& out)
+{
+    auto data = sf.data();
+    return data && copyRecords(sf.path(), *data, true, windows, out);
+}
+
+bool writeUpperAirFile(const UpperAirFile& ua, const HourSet& windows, const std::filesystem::path& out)
+{
+    auto data = ua.data();
+    return data && copyRecords(ua.path(), *data, false, windows, out);
+}
+
+bool writeFiles(const Meteorology& m, const HourSet& windows,
+                const std::filesystem::path& sfcOut, const std::filesystem::path& pflOut)
+{
+    return writeSurfaceFile(m.surfaceFile, windows, sfcOut) &&
+           writeUpperAirFile(m.upperAirFile, windows, pflOut);
+}
+
+} // namespace MeteorologySubset
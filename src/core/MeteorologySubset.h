@@ -0,0 +1,44 @@
+// Copyright 2020 Dow, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#pragma once
+
+#include <filesystem>
+
+#include <boost/icl/ptime.hpp>
+#include <boost/icl/interval_set.hpp>
+
+#include "core/Meteorology.h"
+
+// Extraction of time windows from surface and upper air files. Records are
+// located with the byte offsets recorded when the files were parsed, so the
+// output is a byte-range copy of the input rather than a re-parse.
+
+namespace MeteorologySubset {
+
+using HourSet = boost::icl::interval_set<boost::posix_time::ptime>;
+
+// Write the header and the records of the surface file within the windows.
+// Returns false if the file has changed since it was parsed or the output
+// cannot be written.
+bool writeSurfaceFile(const SurfaceFile& sf, const HourSet& windows, const std::filesystem::path& out);
+
+// Write the profile levels of the upper air file within the windows.
+bool writeUpperAirFile(const UpperAirFile& ua, const HourSet& windows, const std::filesystem::path& out);
+
+// Write both files. Returns false if either file cannot be written.
+bool writeFiles(const Meteorology& m, const HourSet& windows,
+                const std::filesystem::path& sfcOut, const std::filesystem::path& pflOut);
+
+} // namespace MeteorologySubset
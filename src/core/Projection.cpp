@@ -21,10 +21,15 @@
 #include <boost/log/trivial.hpp>
 #include <boost/log/attributes/scoped_attribute.hpp>
 
+#include <algorithm>
+#include <atomic>
 #include <cstdlib>
+#include <future>
 #include <iostream>
 #include <stdexcept>
 #include <string>
+#include <thread>
+#include <vector>
 
 // proj_internal.h
 extern void PROJ_DLL pj_context_set_user_writable_directory(PJ_CONTEXT* ctx, const std::string& path);
@@ -64,26 +69,32 @@ inline void contextLogFunction(void *data, int level, const char *msg)
     }
 }
 
-inline PJ_CONTEXT * context()
+inline std::shared_ptr<PJ_CONTEXT> createContext()
 {
-    thread_local std::shared_ptr<PJ_CONTEXT> ctx;
+    auto ctx = std::shared_ptr<PJ_CONTEXT>(
+        proj_context_create(),
+        [](PJ_CONTEXT *p) { proj_context_destroy(p); });
 
-    if (ctx == nullptr) {
-        ctx = std::shared_ptr<PJ_CONTEXT>(
-            proj_context_create(),
-            [](PJ_CONTEXT *p) { proj_context_destroy(p); });
+    // Cache directory is not inherited. Initialize from the default context.
+    setCacheDirectory(cacheDirectory(nullptr), ctx.get());
 
-        // Cache directory is not inherited. Initialize from the default context.
-        setCacheDirectory(cacheDirectory(nullptr), ctx.get());
+    // Enable networking.
+    proj_grid_cache_set_enable(ctx.get(), true);
+    proj_context_set_enable_network(ctx.get(), true);
 
-        // Enable networking.
-        proj_grid_cache_set_enable(ctx.get(), true);
-        proj_context_set_enable_network(ctx.get(), true);
+    // Set the log callback.
+    proj_log_level(ctx.get(), PJ_LOG_TRACE);
+    proj_log_func(ctx.get(), nullptr, contextLogFunction);
 
-        // Set the log callback.
-        proj_log_level(ctx.get(), PJ_LOG_TRACE);
-        proj_log_func(ctx.get(), nullptr, contextLogFunction);
-    }
+    return ctx;
+}
+
+inline PJ_CONTEXT * context()
+{
+    thread_local std::shared_ptr<PJ_CONTEXT> ctx;
+
+    if (ctx == nullptr)
+        ctx = createContext();
 
     return ctx.get();
 }
@@ -498,6 +509,110 @@ int Pipeline::inverse(double x0, double y0, double z0, double& x1, double& y1, d
     return err;
 }
 
+int Pipeline::forward(Span x, Span y, Span z) const noexcept
+{
+    return transform(false, x, y, z);
+}
+
+int Pipeline::inverse(Span x, Span y, Span z) const noexcept
+{
+    return transform(true, x, y, z);
+}
+
+int Pipeline::transform(bool inverse, Span x, Span y, Span z) const noexcept
+{
+    if (coordop_ == nullptr)
+        return -1; // PJD_ERR_NO_ARGS
+
+    const std::size_t n = x.size;
+    if (y.size != n || (z.data != nullptr && z.size != n))
+        return -1;
+
+    if (n == 0)
+        return 0;
+
+    const PJ_DIRECTION direction = inverse ? PJ_INV : PJ_FWD;
+
+    // Transform points [first, last) in a single call.
+    auto transformChunk = [&](PJ *op, std::size_t first, std::size_t last) {
+        auto at = [](const Span& span, std::size_t i) {
+            return reinterpret_cast<double *>(reinterpret_cast<char *>(span.data) + i * span.stride);
+        };
+
+        const std::size_t count = last - first;
+        proj_errno_reset(op);
+        proj_trans_generic(op, direction,
+                           at(x, first), x.stride, count,
+                           at(y, first), y.stride, count,
+                           z.data ? at(z, first) : nullptr, z.stride, z.data ? count : 0,
+                           nullptr, 0, 0);
+        return proj_errno(op);
+    };
+
+    constexpr std::size_t chunkSize = 8192;
+    unsigned int nthreads = std::thread::hardware_concurrency();
+    nthreads = static_cast<unsigned int>(std::clamp<std::size_t>(nthreads, 1, (n + chunkSize - 1) / chunkSize));
+
+    if (nthreads == 1)
+        return transformChunk(coordop_.get(), 0, n);
+
+    // Chunks are taken from a shared counter. PJ objects and contexts are not
+    // thread safe, so each worker transforms with its own clone in its own
+    // context; this thread uses the pipeline object itself. The clones are
+    // made here, before any transform starts.
+    std::vector<std::shared_ptr<PJ_CONTEXT>> contexts;
+    std::vector<PJUniquePtr> clones;
+    try {
+        for (unsigned int i = 1; i < nthreads; ++i) {
+            auto ctx = createContext();
+            PJUniquePtr clone(proj_clone(ctx.get(), coordop_.get()));
+            if (clone == nullptr)
+                break; // remaining chunks are taken by the other workers
+            contexts.push_back(std::move(ctx));
+            clones.push_back(std::move(clone));
+        }
+    }
+    catch (...) {
+        // Allocation failed; use the clones made so far.
+    }
+
+    std::atomic<std::size_t> next{0};
+    std::atomic<int> error{0};
+
+    auto worker = [&](PJ *op) {
+        for (;;) {
+            const std::size_t first = next.fetch_add(chunkSize);
+            if (first >= n)
+                return;
+
+            int err = transformChunk(op, first, std::min(n, first + chunkSize));
+            int expected = 0;
+            if (err)
+                error.compare_exchange_strong(expected, err);
+        }
+    };
+
+    std::vector<std::future<void>> futures;
+    try {
+        for (auto& clone : clones) {
+            PJ *op = clone.get();
+            futures.push_back(std::async(std::launch::async, [&worker, op]() {
+                worker(op);
+            }));
+        }
+    }
+    catch (...) {
+        // Thread creation failed; this thread takes the remaining chunks.
+    }
+
+    worker(coordop_.get());
+
+    for (auto& f : futures)
+        f.wait();
+
+    return error;
+}
+
 std::string Pipeline::errorString(int err)
 {
     if (err >= 0)
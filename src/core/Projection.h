@@ -15,6 +15,7 @@
 
 #pragma once
 
+#include <cstddef>
 #include <memory>
 #include <string>
 #include <vector>
@@ -50,6 +51,14 @@ struct UnitOfMeasure
     std::string category;
 };
 
+// Strided array of coordinate values, transformed in place. The stride is in
+// bytes, so that a member of an array of structs can be passed directly.
+struct Span {
+    double *data = nullptr;
+    std::size_t size = 0;
+    std::size_t stride = sizeof(double);
+};
+
 struct Grid {
     std::string shortName;
     std::string fullName;
@@ -144,9 +153,18 @@ struct Pipeline
     double accuracy() noexcept;
     int forward(double x0, double y0, double z0, double& x1, double& y1, double& z1) const noexcept;
     int inverse(double x0, double y0, double z0, double& x1, double& y1, double& z1) const noexcept;
+
+    // Transform arrays of coordinates in place. Large arrays are split into
+    // chunks and transformed in parallel. Points that fail are set to
+    // HUGE_VAL; returns the first error, or 0.
+    int forward(Span x, Span y, Span z = {}) const noexcept;
+    int inverse(Span x, Span y, Span z = {}) const noexcept;
+
     static std::string errorString(int err);
 
 private:
+    int transform(bool inverse, Span x, Span y, Span z) const noexcept;
+
     std::shared_ptr<PJ> coordop_;
 };
 
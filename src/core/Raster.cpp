@@ -14,6 +14,15 @@
 //
 
 #include "core/Raster.h"
+#include "core/RasterCache.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <thread>
 
 #include <boost/log/trivial.hpp>
 #include <boost/log/attributes/scoped_attribute.hpp>
@@ -101,6 +110,7 @@ private:
 Dataset::Dataset(const std::string& filename,
                  const std::string& drivername,
                  const std::vector<std::string>& options)
+    : filename_(filename), drivername_(drivername), options_(options)
 {
     GDALDriver *driver = DriverManager::instance()->GetDriverByName(drivername.c_str());
     if (driver == nullptr)
@@ -108,15 +118,7 @@ Dataset::Dataset(const std::string& filename,
 
     DriverManager::instance()->RegisterDriver(driver);
 
-    const unsigned int openFlags = GDAL_OF_READONLY | GDAL_OF_RASTER;
-    const char *allowedDrivers[] = { drivername.c_str(), nullptr };
-
-    std::vector<const char *> optionsArray;
-    for (const auto& option : options)
-        optionsArray.push_back(option.c_str());
-    optionsArray.push_back(nullptr);
-
-    dataset_ = GDALDataset::Open(filename.c_str(), openFlags, allowedDrivers, optionsArray.data());
+    dataset_ = openHandle();
 
     if (dataset_ == nullptr)
         throw std::runtime_error("Failed to open dataset");
@@ -132,9 +134,25 @@ Dataset::Dataset(const std::string& filename,
 
 Dataset::~Dataset()
 {
+    for (GDALDataset *handle : pool_)
+        GDALClose(handle);
+
     GDALClose(dataset_);
 }
 
+GDALDataset * Dataset::openHandle() const
+{
+    const unsigned int openFlags = GDAL_OF_READONLY | GDAL_OF_RASTER;
+    const char *allowedDrivers[] = { drivername_.c_str(), nullptr };
+
+    std::vector<const char *> optionsArray;
+    for (const auto& option : options_)
+        optionsArray.push_back(option.c_str());
+    optionsArray.push_back(nullptr);
+
+    return GDALDataset::Open(filename_.c_str(), openFlags, allowedDrivers, optionsArray.data());
+}
+
 GDALRasterBand * Dataset::band()
 {
     return band_;
@@ -204,22 +222,40 @@ Window Dataset::blockWindow() const
 
 void Dataset::setBoundingBox(std::shared_ptr<PJ> crs, const Projection::ProjectedExtent& bbox)
 {
-    // Transform bounding box coordinates to dataset projection.
+    // Transform points along the edges of the bounding box to the dataset
+    // projection in one call. Edges are densified, as they may be curved in
+    // the dataset projection.
+    constexpr int nedge = 20;
+    std::vector<double> xs, ys;
+    xs.reserve(4 * nedge);
+    ys.reserve(4 * nedge);
+    for (int i = 0; i < nedge; ++i) {
+        const double t = static_cast<double>(i) / nedge;
+        const double x = bbox.xmin + t * (bbox.xmax - bbox.xmin);
+        const double y = bbox.ymin + t * (bbox.ymax - bbox.ymin);
+        xs.insert(xs.end(), { x, bbox.xmax, bbox.xmax - (x - bbox.xmin), bbox.xmin });
+        ys.insert(ys.end(), { bbox.ymin, y, bbox.ymax, bbox.ymax - (y - bbox.ymin) });
+    }
+
     auto op = Projection::Pipeline(crs, projection());
-    double llx = 0, lly = 0, llz = 0;
-    double lrx = 0, lry = 0, lrz = 0;
-    double ulx = 0, uly = 0, ulz = 0;
-    double urx = 0, ury = 0, urz = 0;
-    op.forward(bbox.xmin, bbox.ymin, 0, llx, lly, llz); // SW corner
-    op.forward(bbox.xmax, bbox.ymin, 0, lrx, lry, lrz); // SE corner
-    op.forward(bbox.xmin, bbox.ymax, 0, ulx, uly, ulz); // NW corner
-    op.forward(bbox.xmax, bbox.ymax, 0, urx, ury, urz); // NE corner
+    op.forward({ xs.data(), xs.size() }, { ys.data(), ys.size() });
 
     // Get the maximum source window covering the projected bounding box.
-    double x0 = std::min(llx, ulx); // SW, NW: West
-    double y0 = std::min(lly, lry); // SW, SE: South
-    double x1 = std::max(lrx, urx); // SE, NE: East
-    double y1 = std::max(uly, ury); // NW, NE: North
+    double x0 = std::numeric_limits<double>::max(); // West
+    double y0 = std::numeric_limits<double>::max(); // South
+    double x1 = std::numeric_limits<double>::lowest(); // East
+    double y1 = std::numeric_limits<double>::lowest(); // North
+    for (std::size_t i = 0; i < xs.size(); ++i) {
+        if (xs[i] == HUGE_VAL || ys[i] == HUGE_VAL)
+            continue;
+        x0 = std::min(x0, xs[i]);
+        y0 = std::min(y0, ys[i]);
+        x1 = std::max(x1, xs[i]);
+        y1 = std::max(y1, ys[i]);
+    }
+
+    if (x0 > x1 || y0 > y1)
+        throw std::runtime_error("Failed to transform bounding box");
 
     // Calculate pixel offsets and window dimensions.
     auto gt = geoTransform();
@@ -248,125 +284,182 @@ void Dataset::setBoundingBox(std::shared_ptr<PJ> crs, const Projection::Projecte
     blockWindow_.ymax = window_.ymax - (window_.ymax % blockDims[1]) + blockDims[1];
 }
 
+void Dataset::setThreadCount(unsigned int n)
+{
+    nthreads_ = n;
+}
+
 std::vector<float> Dataset::readBlocksInternal(TaskControl& control, Dataset *p)
 {
     control.started();
 
-    auto band = p->band();
-    auto window = p->window();
-    auto blockWindow = p->blockWindow();
-    auto blockDims = p->blockDimensions();
-
-    const int xbmin = blockWindow.xmin;
-    const int ybmax = blockWindow.ymax;
-    const int nxbuf = blockWindow.nx();
-    const int nybuf = blockWindow.ny();
+    const Window window = p->window();
+    const auto dims = p->dimensions();
+    const auto blockDims = p->blockDimensions();
     const int xbsize = blockDims[0];
     const int ybsize = blockDims[1];
-    const int nxblocks = nxbuf / xbsize;
-    const int nyblocks = nybuf / ybsize;
 
-    const int xoffset = window.xmin - blockWindow.xmin;
-    const int yoffset = blockWindow.ymax - window.ymax;
+    // Pixel rectangle of the window; ymax is the row offset of the top edge.
+    const int nx = window.nx();
+    const int ny = window.ny();
+    const int col0 = window.xmin;
+    const int row0 = window.ymax;
 
-    if (nxbuf <= 0 || nybuf <= 0) {
+    if (nx <= 0 || ny <= 0 || xbsize <= 0 || ybsize <= 0) {
         control.finished();
         throw std::runtime_error("Invalid buffer size");
     }
 
-    // Create the buffer to hold block data.
-    float fillValue = static_cast<float>((p->noDataValue() * p->scale()) + p->offset());
-    std::vector<float> buffer(nxbuf * nybuf, fillValue);
+    // Natural blocks covering the window, clipped to the raster.
+    const int cx0 = std::clamp(col0, 0, dims[0]);
+    const int cx1 = std::clamp(col0 + nx, 0, dims[0]);
+    const int cy0 = std::clamp(row0, 0, dims[1]);
+    const int cy1 = std::clamp(row0 + ny, 0, dims[1]);
+
+    std::vector<std::array<int, 2>> blocks;
+    if (cx0 < cx1 && cy0 < cy1) {
+        for (int yb = cy0 / ybsize; yb <= (cy1 - 1) / ybsize; ++yb) {
+            for (int xb = cx0 / xbsize; xb <= (cx1 - 1) / xbsize; ++xb)
+                blocks.push_back({ xb, yb });
+        }
+    }
 
-    // Setup internal progress callback.
-    struct ProgressData {
-        ProgressData(TaskControl& control) : control(control) {}
-        TaskControl& control;
-        int currentBlock = 0;
-        int totalBlocks = 0;
-    };
+    // Pixels outside the raster keep the no data value. Scale and offset are
+    // applied to the whole window at the end.
+    std::vector<float> result(static_cast<std::size_t>(nx) * ny,
+                              static_cast<float>(p->noDataValue()));
 
-    ProgressData pdata(control);
-    pdata.currentBlock = 0;
-    pdata.totalBlocks = nxblocks * nyblocks;
+    if (!blocks.empty()) {
+        p->band()->AdviseRead(cx0, cy0, cx1 - cx0, cy1 - cy0, cx1 - cx0, cy1 - cy0, GDT_Float32, nullptr);
+    }
 
-    static auto pfn = [](double complete, const char *message, void *data) {
-        auto pd = static_cast<ProgressData *>(data);
-        if (pd->control.interruptRequested())
-            return 0;
+    unsigned int nthreads = p->nthreads_ > 0 ? p->nthreads_ : std::thread::hardware_concurrency();
+    nthreads = static_cast<unsigned int>(std::clamp<std::size_t>(nthreads, 1, std::max<std::size_t>(blocks.size(), 1)));
 
-        double start = (double)pd->currentBlock / (double)pd->totalBlocks;
-        pd->control.progress(start + complete / pd->totalBlocks);
-        return 1;
+    const bool useCache = RasterCache::enabled();
+    std::string cacheSource;
+    std::string cacheProjection;
+    if (useCache) {
+        cacheSource = RasterCache::sourceKey(p->filename_);
+        const char *wkt = p->dataset_->GetProjectionRef();
+        cacheProjection = wkt ? wkt : "";
+    }
+
+    std::atomic<std::size_t> next{0};
+    std::atomic<std::size_t> done{0};
+    std::atomic_bool failed{false};
+
+    static auto pfn = [](double, const char *, void *data) {
+        auto control = static_cast<TaskControl *>(data);
+        return control->interruptRequested() ? 0 : 1;
     };
 
-    // Set nearest neighbor resampling and progress function.
-    GDALRasterIOExtraArg extraArg;
-    INIT_RASTERIO_EXTRA_ARG(extraArg);
-    extraArg.eResampleAlg = GRIORA_NearestNeighbour;
-    extraArg.pfnProgress = pfn;
-    extraArg.pProgressData = &pdata;
+    // Each worker reads through its own dataset handle, as GDAL handles are
+    // not thread safe. The first worker uses the handle of this dataset; the
+    // others open one on the first block not found in the cache.
+    auto worker = [&](unsigned int id) {
+        GDALDatasetUniquePtr handle;
+        GDALRasterBand *band = id == 0 ? p->band() : nullptr;
+
+        // Set nearest neighbor resampling and interrupt function.
+        GDALRasterIOExtraArg extraArg;
+        INIT_RASTERIO_EXTRA_ARG(extraArg);
+        extraArg.eResampleAlg = GRIORA_NearestNeighbour;
+        extraArg.pfnProgress = pfn;
+        extraArg.pProgressData = &control;
+
+        std::vector<float> block;
+        block.reserve(static_cast<std::size_t>(xbsize) * ybsize);
+
+        while (!control.interruptRequested() && !failed) {
+            const std::size_t k = next++;
+            if (k >= blocks.size())
+                return;
+
+            const int xstart = blocks[k][0] * xbsize;
+            const int ystart = blocks[k][1] * ybsize;
+            const int bnx = std::min(xbsize, dims[0] - xstart);
+            const int bny = std::min(ybsize, dims[1] - ystart);
+
+            RasterCache::TileKey key{cacheSource, cacheProjection, blocks[k][0], blocks[k][1], bnx, bny};
+            if (!useCache || !RasterCache::load(key, block)) {
+                if (band == nullptr) {
+                    handle.reset(p->openHandle());
+                    if (!handle || handle->GetRasterCount() != 1) {
+                        failed = true;
+                        return;
+                    }
+                    band = handle->GetRasterBand(1);
+                }
 
-    // Notify driver of upcoming read requests.
-    const GDALDataType dataType = band->GetRasterDataType();
-    band->AdviseRead(xbmin, ybmax, nxbuf, nybuf, nxbuf, nybuf, dataType, nullptr);
+                // Read the block using DirectRasterIO. For WCS, this is faster than
+                // GDALRasterBand::GetLockedBlockRef or GDALRasterBand::ReadBlock.
+                block.resize(static_cast<std::size_t>(bnx) * bny);
+                CPLErr rc = band->RasterIO(GF_Read, xstart, ystart, bnx, bny, block.data(), bnx, bny, GDT_Float32, 0, 0, &extraArg);
+                if (rc != CE_None) {
+                    failed = true;
+                    return;
+                }
 
-    for (int ixb = 0; ixb < nxblocks; ++ixb)
-    {
-        for (int iyb = 0; iyb < nyblocks; ++iyb)
-        {
-            if (control.interruptRequested()) {
-                control.finished();
-                throw std::runtime_error("Canceled");
+                if (useCache)
+                    RasterCache::save(key, block);
             }
 
-            pdata.currentBlock = iyb + ixb * nyblocks;
-            control.message(fmt::format("Reading Block {} of {}", pdata.currentBlock + 1, pdata.totalBlocks));
-
-            // Calculate block index in source raster.
-            const int xb = xbmin / xbsize + ixb;
-            const int yb = ybmax / ybsize + iyb;
-
-            // Read the block using DirectRasterIO. For WCS, this is faster than
-            // GDALRasterBand::GetLockedBlockRef or GDALRasterBand::ReadBlock.
-            std::vector<float> block(xbsize * ybsize);
-            const int xstart = xb * xbsize;
-            const int ystart = yb * ybsize;
-
-            CPLErr rc = band->RasterIO(GF_Read, xstart, ystart, xbsize, ybsize, block.data(), xbsize, ybsize, GDT_Float32, 0, 0, &extraArg);
-            if (rc != CE_None) {
-                control.finished();
-                if (control.interruptRequested())
-                    throw std::runtime_error("Canceled");
-                else
-                    throw std::runtime_error("I/O error");
+            // Copy the rows of the block that fall inside the window.
+            const int x0 = std::max(xstart, cx0);
+            const int x1 = std::min(xstart + bnx, cx1);
+            const int y0 = std::max(ystart, cy0);
+            const int y1 = std::min(ystart + bny, cy1);
+            for (int row = y0; row < y1; ++row) {
+                const float *src = block.data() + static_cast<std::size_t>(row - ystart) * bnx + (x0 - xstart);
+                float *dst = result.data() + static_cast<std::size_t>(row - row0) * nx + (x0 - col0);
+                std::memcpy(dst, src, sizeof(float) * (x1 - x0));
             }
 
-            for (int ix = 0; ix < xbsize; ++ix) {
-                for (int iy = 0; iy < ybsize; ++iy) {
-                    int pos = (ix + ixb * xbsize) + (iy + iyb * ybsize) * nxbuf;
-                    float value = static_cast<float>((block.at(ix + iy * xbsize) * p->scale()) + p->offset());
-                    buffer.at(pos) = value;
-                }
-            }
+            ++done;
+        }
+    };
+
+    std::vector<std::future<void>> futures;
+    for (unsigned int i = 0; i < nthreads; ++i)
+        futures.push_back(std::async(std::launch::async, worker, i));
+
+    // Progress is reported from this thread only.
+    using namespace std::chrono_literals;
+    const std::size_t totalBlocks = blocks.size();
+    for (auto& f : futures) {
+        while (f.wait_for(100ms) != std::future_status::ready) {
+            // A window outside the raster has no blocks to read.
+            if (totalBlocks == 0)
+                continue;
+            control.message(fmt::format("Reading Block {} of {}", done.load() + 1, totalBlocks));
+            control.progress(static_cast<double>(done) / static_cast<double>(totalBlocks));
         }
+        f.get();
     }
 
-    // Copy results to output buffer within source window.
-    //float *start = &buffer.at(nxbuf * yoffset + xoffset);
-    //const GSpacing linespace = sizeof(float) * nxbuf;
-    //band->RasterIO(GF_Write, 0, 0, nx, ny, start, nx, ny, GDT_Float32, 0, linespace);
+    if (control.interruptRequested()) {
+        control.finished();
+        throw std::runtime_error("Canceled");
+    }
+
+    if (failed) {
+        control.finished();
+        throw std::runtime_error("I/O error");
+    }
 
     control.message("Generating DEM");
 
-    std::vector<float> result;
-    result.reserve(window.nx() * window.ny());
-    for (int ix = xoffset; ix < window.nx(); ++ix) {
-        for (int iy = yoffset; iy < window.ny(); ++iy) {
-            result.push_back(buffer.at(ix + iy * xbsize));
-        }
+    const double scale = p->scale();
+    const double offset = p->offset();
+    if (scale != 1 || offset != 0) {
+        for (float& value : result)
+            value = static_cast<float>(value * scale + offset);
     }
 
+    BOOST_LOG_TRIVIAL(info) << fmt::format("Read {} blocks for {} x {} window using {} threads",
+                                           totalBlocks, nx, ny, futures.size());
+
     control.finished();
     return result;
 }
@@ -376,7 +469,114 @@ std::future<std::vector<float>> Dataset::readBlocks(TaskControl& control)
     return std::async(std::launch::async, readBlocksInternal, std::ref(control), this);
 }
 
-void Dataset::exportGeoTIFF(const std::string& filename) const
+GDALDataset * Dataset::acquireHandle() const
+{
+    {
+        std::lock_guard<std::mutex> lock(poolMutex_);
+        if (!pool_.empty()) {
+            GDALDataset *handle = pool_.back();
+            pool_.pop_back();
+            return handle;
+        }
+    }
+
+    GDALDataset *handle = openHandle();
+    if (handle == nullptr || handle->GetRasterCount() != 1) {
+        GDALClose(handle);
+        throw std::runtime_error("Failed to open dataset");
+    }
+
+    return handle;
+}
+
+void Dataset::releaseHandle(GDALDataset *handle) const
+{
+    std::lock_guard<std::mutex> lock(poolMutex_);
+    pool_.push_back(handle);
+}
+
+std::vector<float> Dataset::readWindow(int xoff, int yoff, int nx, int ny) const
+{
+    if (nx <= 0 || ny <= 0)
+        throw std::runtime_error("Invalid window size");
+
+    const auto dims = dimensions();
+    const int cx0 = std::clamp(xoff, 0, dims[0]);
+    const int cx1 = std::clamp(xoff + nx, 0, dims[0]);
+    const int cy0 = std::clamp(yoff, 0, dims[1]);
+    const int cy1 = std::clamp(yoff + ny, 0, dims[1]);
+
+    // Each thread reads through its own handle, as GDAL handles are not
+    // thread safe. Handles are kept for reuse.
+    GDALDataset *handle = acquireHandle();
+    GDALRasterBand *band = handle->GetRasterBand(1);
+
+    const double noData = band->GetNoDataValue();
+    const double scale = band->GetScale();
+    const double offset = band->GetOffset();
+
+    std::vector<float> values(static_cast<std::size_t>(nx) * ny, static_cast<float>(noData));
+
+    CPLErr rc = CE_None;
+    if (cx0 < cx1 && cy0 < cy1 && RasterCache::enabled()) {
+        // Read the natural blocks covering the window, so that tiles are
+        // shared with readBlocks through the raster cache.
+        int xbsize, ybsize;
+        band->GetBlockSize(&xbsize, &ybsize);
+        const char *wkt = handle->GetProjectionRef();
+        RasterCache::TileKey key{RasterCache::sourceKey(filename_), wkt ? wkt : "", 0, 0, 0, 0};
+
+        std::vector<float> block;
+        for (int yb = cy0 / ybsize; yb <= (cy1 - 1) / ybsize && rc == CE_None; ++yb) {
+            for (int xb = cx0 / xbsize; xb <= (cx1 - 1) / xbsize && rc == CE_None; ++xb) {
+                const int xstart = xb * xbsize;
+                const int ystart = yb * ybsize;
+                key.xblock = xb;
+                key.yblock = yb;
+                key.nx = std::min(xbsize, dims[0] - xstart);
+                key.ny = std::min(ybsize, dims[1] - ystart);
+
+                if (!RasterCache::load(key, block)) {
+                    block.resize(static_cast<std::size_t>(key.nx) * key.ny);
+                    rc = band->RasterIO(GF_Read, xstart, ystart, key.nx, key.ny, block.data(),
+                                        key.nx, key.ny, GDT_Float32, 0, 0, nullptr);
+                    if (rc != CE_None)
+                        break;
+                    RasterCache::save(key, block);
+                }
+
+                // Copy the rows of the block that fall inside the window.
+                const int x0 = std::max(xstart, cx0);
+                const int x1 = std::min(xstart + key.nx, cx1);
+                for (int row = std::max(ystart, cy0); row < std::min(ystart + key.ny, cy1); ++row) {
+                    const float *src = block.data() + static_cast<std::size_t>(row - ystart) * key.nx + (x0 - xstart);
+                    float *dst = values.data() + static_cast<std::size_t>(row - yoff) * nx + (x0 - xoff);
+                    std::memcpy(dst, src, sizeof(float) * (x1 - x0));
+                }
+            }
+        }
+    }
+    else if (cx0 < cx1 && cy0 < cy1) {
+        float *start = values.data() + static_cast<std::size_t>(cy0 - yoff) * nx + (cx0 - xoff);
+        const GSpacing lineSpace = static_cast<GSpacing>(sizeof(float)) * nx;
+        rc = band->RasterIO(GF_Read, cx0, cy0, cx1 - cx0, cy1 - cy0, start,
+                            cx1 - cx0, cy1 - cy0, GDT_Float32, 0, lineSpace, nullptr);
+    }
+
+    releaseHandle(handle);
+
+    if (rc != CE_None)
+        throw std::runtime_error("I/O error");
+
+    if (scale != 1 || offset != 0) {
+        for (float& value : values)
+            value = static_cast<float>(value * scale + offset);
+    }
+
+    return values;
+}
+
+void Dataset::exportGeoTIFF(const std::string& filename, const std::vector<float>& values) const
 {
     GDALDriver *driver = DriverManager::instance()->GetDriverByName("GTiff");
     if (driver == nullptr)
@@ -385,20 +585,21 @@ void Dataset::exportGeoTIFF(const std::string& filename) const
     const int nx = window_.nx();
     const int ny = window_.ny();
 
-    if (nx <= 0 || ny <= 0 || nx * ny != values_.size())
+    // Values are the rows of the window, as returned by readBlocks.
+    if (nx <= 0 || ny <= 0 || static_cast<std::size_t>(nx) * ny != values.size())
         throw std::runtime_error("Invalid window size");
 
     GDALDatasetUniquePtr dataset(driver->Create(filename.c_str(), nx, ny, 1, GDT_Float32, nullptr));
     GeoTransform gt = geoTransform();
-    gt.ulx += window_.xmin; // ulx + offset
-    gt.uly -= window_.ymax; // uly + offset
+    gt.ulx += window_.xmin * gt.xres; // ulx + offset
+    gt.uly += window_.ymax * gt.yres; // uly + offset
     dataset->SetGeoTransform(gt.array().data());
     dataset->SetProjection(dataset_->GetProjectionRef());
 
     GDALRasterBand *band = dataset->GetRasterBand(1);
     band->SetUnitType("m");
 
-    float *start = const_cast<float *>(values_.data());
+    float *start = const_cast<float *>(values.data());
     band->RasterIO(GF_Write, 0, 0, nx, ny, start, nx, ny, GDT_Float32, 0, 0);
 }
 
@@ -21,6 +21,7 @@
 #include <array>
 #include <future>
 #include <memory>
+#include <mutex>
 #include <optional>
 #include <string>
 #include <vector>
@@ -99,17 +100,31 @@ public:
     Window window() const;
     Window blockWindow() const;
     void setBoundingBox(std::shared_ptr<PJ> crs, const Projection::ProjectedExtent& bbox);
-    void exportGeoTIFF(const std::string& filename) const;
+    void setThreadCount(unsigned int n);
+    void exportGeoTIFF(const std::string& filename, const std::vector<float>& values) const;
     std::future<std::vector<float>> readBlocks(TaskControl& control);
 
+    // Reads a pixel window, scaled and offset, row by row from the top.
+    // Pixels outside the raster are set to the no data value. Safe to call
+    // from several threads.
+    std::vector<float> readWindow(int xoff, int yoff, int nx, int ny) const;
+
 private:
     static std::vector<float> readBlocksInternal(TaskControl& control, Dataset *p);
-
+    GDALDataset * openHandle() const;
+    GDALDataset * acquireHandle() const;
+    void releaseHandle(GDALDataset *handle) const;
+
+    std::string filename_;
+    std::string drivername_;
+    std::vector<std::string> options_;
+    unsigned int nthreads_ = 0;
     Window window_;
     Window blockWindow_;
     GDALDataset *dataset_;
     GDALRasterBand *band_;
-    std::vector<float> values_;
+    mutable std::mutex poolMutex_;
+    mutable std::vector<GDALDataset *> pool_;
 };
 
 } // namespace Raster
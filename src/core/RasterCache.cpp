@@ -0,0 +1,387 @@
+// Copyright 2020 Dow, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#include "core/RasterCache.h"
+#include "core/MappedFile.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <string_view>
+#include <system_error>
+#include <tuple>
+#include <type_traits>
+
+#include <boost/log/trivial.hpp>
+#include <boost/log/attributes/scoped_attribute.hpp>
+
+#include <fmt/format.h>
+
+#include <zlib.h>
+
+namespace RasterCache {
+
+namespace {
+
+constexpr char CACHE_MAGIC[8] = {'S', 'O', 'F', 'E', 'A', 'D', 'E', 'M'};
+constexpr std::uint32_t CACHE_VERSION = 1;
+constexpr std::uint32_t CACHE_BYTE_ORDER = 0x01020304;
+constexpr char CACHE_EXTENSION[] = ".tile";
+
+// Fraction of the maximum size retained when the cache is trimmed, so that
+// eviction does not run on every save.
+constexpr double TRIM_RATIO = 0.8;
+
+std::mutex stateMutex;
+std::filesystem::path dir;
+std::uint64_t maxBytes = std::uint64_t{1} << 30;
+std::optional<std::uint64_t> currentBytes;
+std::atomic<unsigned int> tmpCounter{0};
+
+//-----------------------------------------------------------------------------
+// Serialization
+//-----------------------------------------------------------------------------
+
+template <typename T>
+void put(std::string& buffer, const T& value)
+{
+    static_assert(std::is_trivially_copyable_v<T>);
+    buffer.append(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+void put(std::string& buffer, const std::string& s)
+{
+    put<std::uint64_t>(buffer, s.size());
+    buffer.append(s);
+}
+
+template <typename T>
+bool get(std::string_view& data, T& value)
+{
+    static_assert(std::is_trivially_copyable_v<T>);
+    if (data.size() < sizeof(T))
+        return false;
+    std::memcpy(&value, data.data(), sizeof(T));
+    data.remove_prefix(sizeof(T));
+    return true;
+}
+
+bool get(std::string_view& data, std::string& s)
+{
+    std::uint64_t n;
+    if (!get(data, n) || data.size() < n)
+        return false;
+    s.assign(data.data(), n);
+    data.remove_prefix(n);
+    return true;
+}
+
+void putKey(std::string& buffer, const TileKey& key)
+{
+    put(buffer, CACHE_MAGIC);
+    put(buffer, CACHE_VERSION);
+    put(buffer, CACHE_BYTE_ORDER);
+    put(buffer, key.source);
+    put(buffer, key.projection);
+    put<std::int32_t>(buffer, key.xblock);
+    put<std::int32_t>(buffer, key.yblock);
+    put<std::int32_t>(buffer, key.nx);
+    put<std::int32_t>(buffer, key.ny);
+}
+
+bool getKey(std::string_view& data, const TileKey& key)
+{
+    char magic[8];
+    std::uint32_t version, byteOrder;
+    std::int32_t xblock, yblock, nx, ny;
+    TileKey cached;
+
+    return get(data, magic) && std::memcmp(magic, CACHE_MAGIC, sizeof(magic)) == 0 &&
+           get(data, version) && version == CACHE_VERSION &&
+           get(data, byteOrder) && byteOrder == CACHE_BYTE_ORDER &&
+           get(data, cached.source) && cached.source == key.source &&
+           get(data, cached.projection) && cached.projection == key.projection &&
+           get(data, xblock) && xblock == key.xblock &&
+           get(data, yblock) && yblock == key.yblock &&
+           get(data, nx) && nx == key.nx &&
+           get(data, ny) && ny == key.ny;
+}
+
+//-----------------------------------------------------------------------------
+// Compression
+//-----------------------------------------------------------------------------
+
+// Group the bytes of each value by significance. Neighboring elevations
+// share their high order bytes, which then compress to long runs.
+std::string shuffle(const std::vector<float>& values)
+{
+    const std::size_t n = values.size();
+    const auto bytes = reinterpret_cast<const unsigned char *>(values.data());
+
+    std::string planes(n * sizeof(float), '\0');
+    for (std::size_t i = 0; i < n; ++i) {
+        for (std::size_t k = 0; k < sizeof(float); ++k)
+            planes[k * n + i] = static_cast<char>(bytes[i * sizeof(float) + k]);
+    }
+    return planes;
+}
+
+void unshuffle(const std::string& planes, std::vector<float>& values)
+{
+    const std::size_t n = values.size();
+    const auto bytes = reinterpret_cast<unsigned char *>(values.data());
+
+    for (std::size_t i = 0; i < n; ++i) {
+        for (std::size_t k = 0; k < sizeof(float); ++k)
+            bytes[i * sizeof(float) + k] = static_cast<unsigned char>(planes[k * n + i]);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Files
+//-----------------------------------------------------------------------------
+
+std::filesystem::path tilePath(const TileKey& key)
+{
+    // The hash only selects the file name; the full key is stored in the
+    // tile and compared on load.
+    const std::string s = key.source + '\n' + key.projection;
+    const auto data = reinterpret_cast<const Bytef *>(s.data());
+    const auto n = static_cast<uInt>(s.size());
+    const std::uint64_t h = (static_cast<std::uint64_t>(crc32(0, data, n)) << 32) | adler32(1, data, n);
+
+    return cacheDirectory() / fmt::format("{:016x}_{}_{}_{}x{}{}", h,
+        key.xblock, key.yblock, key.nx, key.ny, CACHE_EXTENSION);
+}
+
+std::uint64_t scanSize(const std::filesystem::path& root)
+{
+    std::error_code ec;
+    std::uint64_t total = 0;
+    for (std::filesystem::directory_iterator it(root, ec), end; !ec && it != end; it.increment(ec)) {
+        if (it->path().extension() == CACHE_EXTENSION) {
+            auto size = it->file_size(ec);
+            total += ec ? 0 : size;
+        }
+    }
+    return total;
+}
+
+// Remove the least recently used tiles until the cache is below the trim
+// ratio of its maximum size. Called with the state mutex held.
+std::uint64_t trim(const std::filesystem::path& root, std::uint64_t limit)
+{
+    BOOST_LOG_SCOPED_THREAD_TAG("Source", "Terrain")
+
+    using Entry = std::tuple<std::filesystem::file_time_type, std::uint64_t, std::filesystem::path>;
+    std::vector<Entry> entries;
+    std::uint64_t total = 0;
+
+    std::error_code ec;
+    for (std::filesystem::directory_iterator it(root, ec), end; !ec && it != end; it.increment(ec)) {
+        if (it->path().extension() != CACHE_EXTENSION)
+            continue;
+        std::error_code fec;
+        auto size = it->file_size(fec);
+        auto mtime = it->last_write_time(fec);
+        if (fec)
+            continue;
+        entries.emplace_back(mtime, size, it->path());
+        total += size;
+    }
+
+    std::sort(entries.begin(), entries.end());
+
+    const auto target = static_cast<std::uint64_t>(limit * TRIM_RATIO);
+    std::size_t nremoved = 0;
+    for (const auto& [mtime, size, path] : entries) {
+        if (total <= target)
+            break;
+        if (std::filesystem::remove(path, ec)) {
+            total -= size;
+            nremoved++;
+        }
+    }
+
+    BOOST_LOG_TRIVIAL(info) << fmt::format("Removed {} tiles from elevation cache", nremoved);
+
+    return total;
+}
+
+void write(const std::filesystem::path& p, const std::string& contents)
+{
+    BOOST_LOG_SCOPED_THREAD_TAG("Source", "Terrain")
+
+    std::error_code ec;
+    std::filesystem::create_directories(p.parent_path(), ec);
+
+    // Write to a temporary file and rename, so readers never see a
+    // partially written tile.
+    std::filesystem::path tmp = p;
+    tmp += fmt::format(".{}.tmp", tmpCounter++);
+
+    std::ofstream ofs(tmp, std::ios::out | std::ios::binary | std::ios::trunc);
+    ofs.write(contents.data(), static_cast<std::streamsize>(contents.size()));
+    ofs.close();
+
+    if (!ofs) {
+        BOOST_LOG_TRIVIAL(warning) << fmt::format("Failed to write elevation cache: '{}'", tmp.string());
+        std::filesystem::remove(tmp, ec);
+        return;
+    }
+
+    std::filesystem::rename(tmp, p, ec);
+    if (ec) {
+        BOOST_LOG_TRIVIAL(warning) << fmt::format("Failed to write elevation cache: '{}': {}", p.string(), ec.message());
+        std::filesystem::remove(tmp, ec);
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(stateMutex);
+    if (!currentBytes)
+        currentBytes = scanSize(p.parent_path());
+    else
+        *currentBytes += contents.size();
+
+    if (*currentBytes > maxBytes)
+        currentBytes = trim(p.parent_path(), maxBytes);
+}
+
+} // namespace
+
+//-----------------------------------------------------------------------------
+// Settings
+//-----------------------------------------------------------------------------
+
+void setCacheDirectory(const std::filesystem::path& path) noexcept
+{
+    std::lock_guard<std::mutex> lock(stateMutex);
+    dir = path;
+    currentBytes.reset();
+}
+
+std::filesystem::path cacheDirectory() noexcept
+{
+    std::lock_guard<std::mutex> lock(stateMutex);
+    return dir;
+}
+
+bool enabled() noexcept
+{
+    return !cacheDirectory().empty();
+}
+
+void setMaxSize(std::uint64_t bytes) noexcept
+{
+    std::lock_guard<std::mutex> lock(stateMutex);
+    maxBytes = bytes;
+}
+
+std::uint64_t maxSize() noexcept
+{
+    std::lock_guard<std::mutex> lock(stateMutex);
+    return maxBytes;
+}
+
+//-----------------------------------------------------------------------------
+// Tiles
+//-----------------------------------------------------------------------------
+
+std::string sourceKey(const std::string& filename)
+{
+    std::error_code ec;
+    const std::filesystem::path p(filename);
+    if (!std::filesystem::is_regular_file(p, ec))
+        return filename;
+
+    auto ap = std::filesystem::absolute(p, ec);
+    std::string key = ec ? filename : ap.lexically_normal().string();
+
+    auto size = std::filesystem::file_size(p, ec);
+    if (!ec)
+        key += fmt::format("|{}", size);
+
+    auto mtime = std::filesystem::last_write_time(p, ec);
+    if (!ec)
+        key += fmt::format("|{}", mtime.time_since_epoch().count());
+
+    return key;
+}
+
+bool load(const TileKey& key, std::vector<float>& values)
+{
+    if (!enabled() || key.nx <= 0 || key.ny <= 0)
+        return false;
+
+    const auto p = tilePath(key);
+
+    std::string planes;
+    {
+        MappedFile file(p);
+        if (!file.isOpen())
+            return false;
+
+        std::string_view data = file.view();
+        std::uint64_t compressedSize;
+        if (!getKey(data, key) || !get(data, compressedSize) || data.size() != compressedSize)
+            return false;
+
+        planes.resize(static_cast<std::size_t>(key.nx) * key.ny * sizeof(float));
+        uLongf destLen = static_cast<uLongf>(planes.size());
+        int rc = uncompress(reinterpret_cast<Bytef *>(planes.data()), &destLen,
+                            reinterpret_cast<const Bytef *>(data.data()), static_cast<uLong>(data.size()));
+        if (rc != Z_OK || destLen != planes.size())
+            return false;
+    }
+
+    values.resize(static_cast<std::size_t>(key.nx) * key.ny);
+    unshuffle(planes, values);
+
+    // Mark the tile as recently used.
+    std::error_code ec;
+    std::filesystem::last_write_time(p, std::filesystem::file_time_type::clock::now(), ec);
+
+    return true;
+}
+
+void save(const TileKey& key, const std::vector<float>& values)
+{
+    if (!enabled() || key.nx <= 0 || key.ny <= 0 ||
+        values.size() != static_cast<std::size_t>(key.nx) * key.ny)
+        return;
+
+    const std::string planes = shuffle(values);
+
+    uLongf compressedSize = compressBound(static_cast<uLong>(planes.size()));
+    std::string compressed(compressedSize, '\0');
+    int rc = compress2(reinterpret_cast<Bytef *>(compressed.data()), &compressedSize,
+                       reinterpret_cast<const Bytef *>(planes.data()), static_cast<uLong>(planes.size()),
+                       Z_DEFAULT_COMPRESSION);
+    if (rc != Z_OK)
+        return;
+    compressed.resize(compressedSize);
+
+    std::string buffer;
+    buffer.reserve(compressed.size() + key.source.size() + key.projection.size() + 64);
+    putKey(buffer, key);
+    put<std::uint64_t>(buffer, compressed.size());
+    buffer.append(compressed);
+
+    write(tilePath(key), buffer);
+}
+
+} // namespace RasterCache
@@ -0,0 +1,57 @@
+// Copyright 2020 Dow, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// Disk cache of raster blocks. Each tile holds the unscaled values of one
+// block of a source dataset, byte shuffled and compressed with zlib. Tiles
+// are keyed by the source, its projection and the block index. When the
+// cache grows beyond its maximum size, the least recently used tiles are
+// removed. Caching is disabled until a cache directory is set.
+
+namespace RasterCache {
+
+struct TileKey {
+    std::string source;
+    std::string projection;
+    int xblock = 0;
+    int yblock = 0;
+    int nx = 0;
+    int ny = 0;
+};
+
+void setCacheDirectory(const std::filesystem::path& dir) noexcept;
+
+std::filesystem::path cacheDirectory() noexcept;
+
+bool enabled() noexcept;
+
+void setMaxSize(std::uint64_t bytes) noexcept;
+
+std::uint64_t maxSize() noexcept;
+
+// Source key for a dataset. Local files include their size and modification
+// time, so that tiles are not reused after the file changes.
+std::string sourceKey(const std::string& filename);
+
+bool load(const TileKey& key, std::vector<float>& values);
+
+void save(const TileKey& key, const std::vector<float>& values);
+
+} // namespace RasterCache
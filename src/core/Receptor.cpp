@@ -25,8 +25,6 @@
 #include <limits>
 #include <numeric>
 
-#include <boost/numeric/ublas/vector.hpp>
-#include <boost/numeric/ublas/matrix_proxy.hpp>
 #include <fmt/format.h>
 
 //-----------------------------------------------------------------------------
@@ -36,33 +34,133 @@
 ReceptorNodeGroup::ReceptorNodeGroup()
 {}
 
-bool ReceptorNodeGroup::setZElev(int index, double zElev)
+int ReceptorNodeGroup::findNode(double x, double y) const
 {
-    if (index < 0 || index >= nodes.size())
+    std::size_t i = lowerBound(x, y);
+    if (i < nodeCount() && this->x[i] == x && this->y[i] == y)
+        return static_cast<int>(i);
+
+    return -1;
+}
+
+std::size_t ReceptorNodeGroup::lowerBound(double x, double y) const
+{
+    // Binary search on x, then on y within the run of equal x values.
+    auto xlo = std::lower_bound(this->x.begin(), this->x.end(), x);
+    auto xhi = std::upper_bound(xlo, this->x.end(), x);
+    std::size_t first = std::distance(this->x.begin(), xlo);
+    std::size_t last = std::distance(this->x.begin(), xhi);
+
+    auto ylo = std::lower_bound(this->y.begin() + first, this->y.begin() + last, y);
+    return std::distance(this->y.begin(), ylo);
+}
+
+int ReceptorNodeGroup::addNode(const ReceptorNode& node)
+{
+    std::size_t i = lowerBound(node.x, node.y);
+    if (i < nodeCount() && x[i] == node.x && y[i] == node.y)
+        return -1;
+
+    x.insert(x.begin() + i, node.x);
+    y.insert(y.begin() + i, node.y);
+    zElev.insert(zElev.begin() + i, node.zElev);
+    zHill.insert(zHill.begin() + i, node.zHill);
+    zFlag.insert(zFlag.begin() + i, node.zFlag);
+    return static_cast<int>(i);
+}
+
+void ReceptorNodeGroup::addNodes(const std::vector<ReceptorNode>& nodes)
+{
+    // Merge with a single sort instead of repeated insertion. Existing nodes
+    // are placed first so they take precedence over duplicates, as with
+    // std::set::insert.
+    std::vector<ReceptorNode> merged = this->nodes();
+    merged.insert(merged.end(), nodes.begin(), nodes.end());
+    std::stable_sort(merged.begin(), merged.end());
+
+    auto equal = [](const ReceptorNode& a, const ReceptorNode& b) {
+        return a.x == b.x && a.y == b.y;
+    };
+    merged.erase(std::unique(merged.begin(), merged.end(), equal), merged.end());
+
+    const std::size_t n = merged.size();
+    x.resize(n);
+    y.resize(n);
+    zElev.resize(n);
+    zHill.resize(n);
+    zFlag.resize(n);
+
+    for (std::size_t i = 0; i < n; ++i) {
+        x[i] = merged[i].x;
+        y[i] = merged[i].y;
+        zElev[i] = merged[i].zElev;
+        zHill[i] = merged[i].zHill;
+        zFlag[i] = merged[i].zFlag;
+    }
+}
+
+std::vector<ReceptorNode> ReceptorNodeGroup::nodes() const
+{
+    std::vector<ReceptorNode> result;
+    result.reserve(nodeCount());
+
+    for (std::size_t i = 0; i < nodeCount(); ++i)
+        result.push_back(ReceptorNode{x[i], y[i], zElev[i], zHill[i], zFlag[i]});
+
+    return result;
+}
+
+bool ReceptorNodeGroup::setZElev(int index, double value)
+{
+    if (index < 0 || index >= nodeCount())
         return false;
 
-    auto it = std::next(nodes.begin(), index);
-    it->zElev = zElev;
+    zElev[index] = value;
     return true;
 }
 
-bool ReceptorNodeGroup::setZHill(int index, double zHill)
+bool ReceptorNodeGroup::setZHill(int index, double value)
 {
-    if (index < 0 || index >= nodes.size())
+    if (index < 0 || index >= nodeCount())
         return false;
 
-    auto it = std::next(nodes.begin(), index);
-    it->zHill = zHill;
+    zHill[index] = value;
     return true;
 }
 
-bool ReceptorNodeGroup::setZFlag(int index, double zFlag)
+bool ReceptorNodeGroup::setZFlag(int index, double value)
 {
-    if (index < 0 || index >= nodes.size())
+    if (index < 0 || index >= nodeCount())
+        return false;
+
+    zFlag[index] = value;
+    return true;
+}
+
+bool ReceptorNodeGroup::setZElev(const std::vector<double>& values)
+{
+    if (values.size() != nodeCount())
+        return false;
+
+    zElev = values;
+    return true;
+}
+
+bool ReceptorNodeGroup::setZHill(const std::vector<double>& values)
+{
+    if (values.size() != nodeCount())
         return false;
 
-    auto it = std::next(nodes.begin(), index);
-    it->zFlag = zFlag;
+    zHill = values;
+    return true;
+}
+
+bool ReceptorNodeGroup::setZFlag(const std::vector<double>& values)
+{
+    if (values.size() != nodeCount())
+        return false;
+
+    zFlag = values;
     return true;
 }
 
@@ -71,24 +169,29 @@ bool ReceptorNodeGroup::removeNodes(int start, int count)
     if (start < 0 || count < 0 || start + count > nodeCount())
         return false;
 
-    auto it = std::next(nodes.begin(), start);
-    for (int i = 0; i < count; ++i)
-        it = nodes.erase(it);
+    auto erase = [start, count](std::vector<double>& v) {
+        v.erase(v.begin() + start, v.begin() + start + count);
+    };
 
+    erase(x);
+    erase(y);
+    erase(zElev);
+    erase(zHill);
+    erase(zFlag);
     return true;
 }
 
 ReceptorNode ReceptorNodeGroup::getNode(int index) const
 {
-    if (index < 0 || index > nodeCount())
+    if (index < 0 || index >= nodeCount())
         return ReceptorNode();
 
-    return *std::next(nodes.begin(), index);
+    return ReceptorNode{x[index], y[index], zElev[index], zHill[index], zFlag[index]};
 }
 
 std::size_t ReceptorNodeGroup::nodeCount() const
 {
-    return nodes.size();
+    return x.size();
 }
 
 QPolygonF ReceptorNodeGroup::points() const
@@ -96,32 +199,25 @@ QPolygonF ReceptorNodeGroup::points() const
     QPolygonF result;
     result.reserve(nodeCount());
 
-    for (const auto& node : nodes)
-        result.push_back(node.point());
+    for (std::size_t i = 0; i < nodeCount(); ++i)
+        result.push_back(QPointF(x[i], y[i]));
 
     return result;
 }
 
 QRectF ReceptorNodeGroup::boundingRect() const
 {
-    if (nodes.empty())
+    if (x.empty())
         return QRectF();
 
-    double xmin = std::numeric_limits<double>::max();
-    double ymin = std::numeric_limits<double>::max();
-    double xmax = std::numeric_limits<double>::lowest();
-    double ymax = std::numeric_limits<double>::lowest();
-
-    for (const auto& node : nodes) {
-        xmin = std::min(xmin, node.x);
-        ymin = std::min(ymin, node.y);
-        xmax = std::max(xmax, node.x);
-        ymax = std::max(ymax, node.y);
-    }
+    // Nodes are sorted by x.
+    const double xmin = x.front();
+    const double xmax = x.back();
+    const auto [ymin, ymax] = std::minmax_element(y.begin(), y.end());
 
     const double w = xmax - xmin;
-    const double h = ymax - ymin;
-    return QRectF(xmin, ymax, w, h);
+    const double h = *ymax - *ymin;
+    return QRectF(xmin, *ymax, w, h);
 }
 
 std::string ReceptorNodeGroup::format() const
@@ -129,10 +225,10 @@ std::string ReceptorNodeGroup::format() const
     fmt::memory_buffer w;
 
     fmt::format_to(w, "** Discrete Receptor Group {}\n", grpid);
-    for (const auto& node : nodes) {
-        fmt::format_to(w, "   EVALCART {: 10.2f} {: 10.2f} ", node.x, node.y);
+    for (std::size_t i = 0; i < nodeCount(); ++i) {
+        fmt::format_to(w, "   EVALCART {: 10.2f} {: 10.2f} ", x[i], y[i]);
         fmt::format_to(w, "{:>6.2f} {:>6.2f} {:>6.2f} {}\n",
-                node.zElev, node.zHill, node.zFlag, grpid);
+                zElev[i], zHill[i], zFlag[i], grpid);
     }
 
     return fmt::to_string(w);
@@ -150,7 +246,7 @@ ReceptorRingGroup::operator ReceptorNodeGroup() const
     ReceptorNodeGroup ng;
     ng.grpid = grpid;
     ng.color = color;
-    ng.nodes.insert(this->nodes.begin(), this->nodes.end());
+    ng.addNodes(nodes);
     return ng;
 }
 
@@ -208,6 +304,39 @@ bool ReceptorRingGroup::setZFlag(int index, double zFlag)
     return true;
 }
 
+bool ReceptorRingGroup::setZElev(const std::vector<double>& values)
+{
+    if (values.size() != nodes.size())
+        return false;
+
+    for (std::size_t i = 0; i < nodes.size(); ++i)
+        nodes[i].zElev = values[i];
+
+    return true;
+}
+
+bool ReceptorRingGroup::setZHill(const std::vector<double>& values)
+{
+    if (values.size() != nodes.size())
+        return false;
+
+    for (std::size_t i = 0; i < nodes.size(); ++i)
+        nodes[i].zHill = values[i];
+
+    return true;
+}
+
+bool ReceptorRingGroup::setZFlag(const std::vector<double>& values)
+{
+    if (values.size() != nodes.size())
+        return false;
+
+    for (std::size_t i = 0; i < nodes.size(); ++i)
+        nodes[i].zFlag = values[i];
+
+    return true;
+}
+
 bool ReceptorRingGroup::removeNodes(int start, int count)
 {
     if (start != 0 && count != nodeCount())
@@ -317,6 +446,148 @@ std::string ReceptorRingGroup::format() const
     return fmt::to_string(w);
 }
 
+//-----------------------------------------------------------------------------
+// GridMatrix
+//-----------------------------------------------------------------------------
+
+GridMatrix::GridMatrix(SparseMatrix m)
+    : size1_(m.size1()), size2_(m.size2()), sparseValues_(std::move(m))
+{
+    if (sparseValues_.nnz() > DenseThreshold * size1_ * size2_)
+        makeDense();
+}
+
+std::size_t GridMatrix::size1() const
+{
+    return size1_;
+}
+
+std::size_t GridMatrix::size2() const
+{
+    return size2_;
+}
+
+bool GridMatrix::isDense() const
+{
+    return dense_;
+}
+
+double GridMatrix::operator()(std::size_t i, std::size_t j) const
+{
+    if (dense_)
+        return denseValues_[i * size2_ + j];
+
+    return sparseValues_(i, j);
+}
+
+void GridMatrix::set(std::size_t i, std::size_t j, double value)
+{
+    if (dense_) {
+        denseValues_[i * size2_ + j] = value;
+        return;
+    }
+
+    // Each insertion into compressed storage is O(nnz); switch to dense
+    // storage once the matrix is no longer sparse.
+    sparseValues_(i, j) = value;
+    if (sparseValues_.nnz() > DenseThreshold * size1_ * size2_)
+        makeDense();
+}
+
+void GridMatrix::assign(const std::vector<double>& values)
+{
+    if (values.size() != size1_ * size2_)
+        return;
+
+    sparseValues_ = SparseMatrix(size1_, size2_);
+    denseValues_ = values;
+    dense_ = true;
+}
+
+void GridMatrix::resize(std::size_t size1, std::size_t size2)
+{
+    if (dense_) {
+        // Preserve the overlapping values.
+        std::vector<double> values(size1 * size2, 0.0);
+        const std::size_t n1 = std::min(size1, size1_);
+        const std::size_t n2 = std::min(size2, size2_);
+        for (std::size_t i = 0; i < n1; ++i) {
+            std::copy_n(denseValues_.begin() + i * size2_, n2,
+                        values.begin() + i * size2);
+        }
+        denseValues_ = std::move(values);
+    }
+    else {
+        // compressed_matrix::resize does not support preserving values.
+        SparseMatrix m(size1, size2);
+        for (auto it1 = sparseValues_.begin1(); it1 != sparseValues_.end1(); ++it1) {
+            for (auto it2 = it1.begin(); it2 != it1.end(); ++it2) {
+                if (it2.index1() < size1 && it2.index2() < size2)
+                    m.push_back(it2.index1(), it2.index2(), *it2);
+            }
+        }
+        sparseValues_ = std::move(m);
+    }
+
+    size1_ = size1;
+    size2_ = size2;
+}
+
+void GridMatrix::clear()
+{
+    // Zero all values, keeping the dimensions.
+    sparseValues_.clear();
+    denseValues_.clear();
+    dense_ = false;
+}
+
+std::vector<double> GridMatrix::row(std::size_t i) const
+{
+    if (dense_) {
+        auto first = denseValues_.begin() + i * size2_;
+        return std::vector<double>(first, first + size2_);
+    }
+
+    std::vector<double> result(size2_, 0.0);
+    auto it1 = sparseValues_.find1(0, i, 0);
+    if (it1 != sparseValues_.end1() && it1.index1() == i) {
+        for (auto it2 = it1.begin(); it2 != it1.end(); ++it2)
+            result[it2.index2()] = *it2;
+    }
+
+    return result;
+}
+
+GridMatrix::SparseMatrix GridMatrix::sparse() const
+{
+    if (!dense_)
+        return sparseValues_;
+
+    // Elements are appended in row-major order, which is constant time.
+    SparseMatrix m(size1_, size2_);
+    for (std::size_t i = 0; i < size1_; ++i) {
+        for (std::size_t j = 0; j < size2_; ++j) {
+            double value = denseValues_[i * size2_ + j];
+            if (value != 0)
+                m.push_back(i, j, value);
+        }
+    }
+
+    return m;
+}
+
+void GridMatrix::makeDense()
+{
+    denseValues_.assign(size1_ * size2_, 0.0);
+    for (auto it1 = sparseValues_.begin1(); it1 != sparseValues_.end1(); ++it1) {
+        for (auto it2 = it1.begin(); it2 != it1.end(); ++it2)
+            denseValues_[it2.index1() * size2_ + it2.index2()] = *it2;
+    }
+
+    sparseValues_ = SparseMatrix(size1_, size2_);
+    dense_ = true;
+}
+
 //-----------------------------------------------------------------------------
 // ReceptorGridGroup
 //-----------------------------------------------------------------------------
@@ -326,9 +597,8 @@ ReceptorGridGroup::ReceptorGridGroup()
 
 ReceptorGridGroup::operator ReceptorNodeGroup() const
 {
-    ReceptorNodeGroup ng;
-    ng.grpid = grpid;
-    ng.color = color;
+    std::vector<ReceptorNode> nodes;
+    nodes.reserve(nodeCount());
     for (int i=0; i < xCount; ++i) {
         for (int j=0; j < yCount; ++j) {
             ReceptorNode node;
@@ -337,9 +607,14 @@ ReceptorGridGroup::operator ReceptorNodeGroup() const
             node.zElev = zElevM(i, j);
             node.zHill = zHillM(i, j);
             node.zFlag = zFlagM(i, j);
-            ng.nodes.insert(node);
+            nodes.push_back(node);
         }
     }
+
+    ReceptorNodeGroup ng;
+    ng.grpid = grpid;
+    ng.color = color;
+    ng.addNodes(nodes);
     return ng;
 }
 
@@ -387,7 +662,7 @@ bool ReceptorGridGroup::setZElev(int i, int j, double zElev)
     if (i < 0 || j < 0 || i >= xCount || j >= yCount)
         return false;
 
-    zElevM(i, j) = zElev;
+    zElevM.set(i, j, zElev);
     return true;
 }
 
@@ -406,7 +681,7 @@ bool ReceptorGridGroup::setZHill(int i, int j, double zHill)
     if (i < 0 || j < 0 || i >= xCount || j >= yCount)
         return false;
 
-    zHillM(i, j) = zHill;
+    zHillM.set(i, j, zHill);
     return true;
 }
 
@@ -425,7 +700,7 @@ bool ReceptorGridGroup::setZFlag(int i, int j, double zFlag)
     if (i < 0 || j < 0 || i >= xCount || j >= yCount)
         return false;
 
-    zFlagM(i, j) = zFlag;
+    zFlagM.set(i, j, zFlag);
     return true;
 }
 
@@ -439,6 +714,33 @@ bool ReceptorGridGroup::setZFlag(int index, double zFlag)
     return setZFlag(i, j, zFlag);
 }
 
+bool ReceptorGridGroup::setZElev(const std::vector<double>& values)
+{
+    if (values.size() != nodeCount())
+        return false;
+
+    zElevM.assign(values);
+    return true;
+}
+
+bool ReceptorGridGroup::setZHill(const std::vector<double>& values)
+{
+    if (values.size() != nodeCount())
+        return false;
+
+    zHillM.assign(values);
+    return true;
+}
+
+bool ReceptorGridGroup::setZFlag(const std::vector<double>& values)
+{
+    if (values.size() != nodeCount())
+        return false;
+
+    zFlagM.assign(values);
+    return true;
+}
+
 bool ReceptorGridGroup::removeNodes(int start, int count)
 {
     if (start != 0 && count != nodeCount())
@@ -497,43 +799,21 @@ QRectF ReceptorGridGroup::boundingRect() const
 }
 
 void formatMatrix(fmt::memory_buffer& w, const std::string& keyword, const std::string& grpid,
-                  const boost::numeric::ublas::compressed_matrix<double>& m)
+                  const GridMatrix& m)
 {
-    namespace ublas = boost::numeric::ublas;
-
     for (std::size_t i = 0; i < m.size1(); ++i) {
         // Row numbers start at 1, and increase with the y-coordinate.
         fmt::format_to(w, "   GRIDCART {0:<8} {1:} {2:<5}", keyword, grpid, i + 1);
 
-        std::size_t ncols = m.size2();
-        ublas::compressed_vector<double> v(ncols);
-        ublas::noalias(v) = ublas::row(m, i);
-        std::size_t nnz = v.nnz(); // number of non-zero entries
-
         // Write contiguous values in shorthand format.
-        std::size_t repeat = 1;
-        for (std::size_t j = 1; j < ncols; ++j) {
-            if (nnz == 0) {
-                std::size_t nz = ncols - nnz;
-                fmt::format_to(w, "{0:>5}*{1:<6.2f}", nz, 0.0);
-                break;
-            }
-
-            double first = std::as_const(v)[j - 1];
-            double second = std::as_const(v)[j];
-
-            if (first == second) {
+        const std::vector<double> v = m.row(i);
+        std::size_t j = 0;
+        while (j < v.size()) {
+            std::size_t repeat = 1;
+            while (j + repeat < v.size() && v[j + repeat] == v[j])
                 ++repeat;
-            }
-            else {
-                fmt::format_to(w, "{0:>5}*{1:<6.2f}", repeat, first);
-                repeat = 1;
-            }
-
-            if (j == ncols - 1) {
-                fmt::format_to(w, "{0:>5}*{1:<6.2f}", repeat, second);
-                break;
-            }
+            fmt::format_to(w, "{0:>5}*{1:<6.2f}", repeat, v[j]);
+            j += repeat;
         }
 
         fmt::format_to(w, "\n");
@@ -16,7 +16,6 @@
 #pragma once
 
 #include <memory>
-#include <set>
 #include <string>
 #include <vector>
 #include <tuple>
@@ -37,9 +36,9 @@ struct ReceptorNode
 {
     double x;
     double y;
-    mutable double zElev = 0;
-    mutable double zHill = 0;
-    mutable double zFlag = 0;
+    double zElev = 0;
+    double zHill = 0;
+    double zFlag = 0;
 
     QPointF point() const {
         return QPointF{x, y};
@@ -50,10 +49,11 @@ struct ReceptorNode
     }
 };
 
-// Discrete receptors are stored in a std::set in order to prevent duplicates
-// and provide automatic sorting. boost::container::flat_set is an alternative,
-// which would provide faster lookup and iteration at the cost of slower
-// insertions.
+// Discrete receptors are stored as parallel arrays sorted by (x, y). This
+// prevents duplicates and preserves the ordering of the previous std::set
+// storage, while providing constant time access by index and binary search
+// lookup by coordinates. The arrays should only be modified through the
+// member functions, which maintain the ordering.
 
 struct ReceptorNodeGroup
 {
@@ -61,11 +61,24 @@ struct ReceptorNodeGroup
 
     std::string grpid; // arcid or netid; length 8
     QColor color;
-    std::set<ReceptorNode> nodes;
+    std::vector<double> x;
+    std::vector<double> y;
+    std::vector<double> zElev;
+    std::vector<double> zHill;
+    std::vector<double> zFlag;
+
+    int findNode(double x, double y) const;
+    std::size_t lowerBound(double x, double y) const;
+    int addNode(const ReceptorNode& node);
+    void addNodes(const std::vector<ReceptorNode>& nodes);
+    std::vector<ReceptorNode> nodes() const;
 
     bool setZElev(int index, double zElev);
     bool setZHill(int index, double zHill);
     bool setZFlag(int index, double zFlag);
+    bool setZElev(const std::vector<double>& values);
+    bool setZHill(const std::vector<double>& values);
+    bool setZFlag(const std::vector<double>& values);
     bool removeNodes(int start, int count);
     ReceptorNode getNode(int index) const;
     std::size_t nodeCount() const;
@@ -98,6 +111,9 @@ struct ReceptorRingGroup
     bool setZElev(int index, double zElev);
     bool setZHill(int index, double zHill);
     bool setZFlag(int index, double zFlag);
+    bool setZElev(const std::vector<double>& values);
+    bool setZHill(const std::vector<double>& values);
+    bool setZFlag(const std::vector<double>& values);
     bool removeNodes(int start, int count);
     bool updateGeometry();
     ReceptorNode getNode(int index) const;
@@ -107,11 +123,51 @@ struct ReceptorRingGroup
     std::string format() const;
 };
 
+// Matrix of per-node values for receptor grids. Values start out in
+// compressed row storage, which is compact while the matrix is mostly zero.
+// Once the fraction of stored entries exceeds DenseThreshold, or when the
+// whole matrix is assigned at once, the values move to a dense row-major array
+// so that each further update is constant time.
+
+class GridMatrix
+{
+public:
+    using SparseMatrix = boost::numeric::ublas::compressed_matrix<double>;
+
+    static constexpr double DenseThreshold = 0.25;
+
+    GridMatrix() = default;
+    explicit GridMatrix(SparseMatrix m);
+
+    std::size_t size1() const;
+    std::size_t size2() const;
+    bool isDense() const;
+
+    double operator()(std::size_t i, std::size_t j) const;
+    void set(std::size_t i, std::size_t j, double value);
+    void assign(const std::vector<double>& values);
+    void resize(std::size_t size1, std::size_t size2);
+    void clear();
+
+    std::vector<double> row(std::size_t i) const;
+    SparseMatrix sparse() const;
+
+private:
+    void makeDense();
+
+    std::size_t size1_ = 0;
+    std::size_t size2_ = 0;
+    bool dense_ = false;
+    SparseMatrix sparseValues_;
+    std::vector<double> denseValues_;
+};
+
 // Cartesian grid receptor geometry is generated on-demand. Elevations, which
 // may be set for individual receptors, use compressed row storage
-// (boost::numeric::ublas::compressed_matrix). This reduces project file size
-// and provides a convenient method to write the receptor grid specification to
-// the AERMOD runstream using shorthand notation, e.g. "ELEV 1 8*10."
+// (boost::numeric::ublas::compressed_matrix) until the grid fills up, see
+// GridMatrix. This reduces project file size and provides a convenient method
+// to write the receptor grid specification to the AERMOD runstream using
+// shorthand notation, e.g. "ELEV 1 8*10."
 
 struct ReceptorGridGroup
 {
@@ -127,9 +183,9 @@ struct ReceptorGridGroup
     double xDelta = 100.0;
     double yDelta = 100.0;
 
-    boost::numeric::ublas::compressed_matrix<double> zElevM;
-    boost::numeric::ublas::compressed_matrix<double> zHillM;
-    boost::numeric::ublas::compressed_matrix<double> zFlagM;
+    GridMatrix zElevM;
+    GridMatrix zHillM;
+    GridMatrix zFlagM;
 
     bool setDimensions(int nrows, int ncols);
     bool setOrigin(double x, double y);
@@ -140,6 +196,9 @@ struct ReceptorGridGroup
     bool setZHill(int index, double zHill);
     bool setZFlag(int i, int j, double zFlag);
     bool setZFlag(int index, double zFlag);
+    bool setZElev(const std::vector<double>& values);
+    bool setZHill(const std::vector<double>& values);
+    bool setZFlag(const std::vector<double>& values);
     bool removeNodes(int start, int count);
     ReceptorNode getNode(int index) const;
     std::size_t nodeCount() const;
@@ -14,6 +14,7 @@
 //
 
 #include "core/Common.h"
+#include "core/Decomposition.h"
 #include "core/InputFormat.h"
 #include "core/Scenario.h"
 #include "utilities/DateTimeConversion.h"
@@ -190,7 +191,7 @@ inline std::string aermodTimeString(const QDateTime& t)
     return timeStr.toStdString();
 }
 
-std::string Scenario::writeInput() const
+std::string Scenario::writeInput(const InputOptions& opts) const
 {
     std::string krun = "RUN"; // RUNORNOT
 
@@ -354,8 +355,22 @@ std::string Scenario::writeInput() const
     //-------------------------------------------------------------------------
 
     fmt::format_to(w, "RE STARTING\n");
-    for (const auto& group : receptors)
-        fmt::format_to(w, "{}", group);
+    if (opts.receptorSubset.empty()) {
+        for (const auto& group : receptors)
+            fmt::format_to(w, "{}", group);
+    }
+    else {
+        // Write the subset as discrete receptors, in global receptor order.
+        // Grid receptors keep their netid as arcid; the network table is
+        // rebuilt when the postfiles are merged.
+        auto flat = flattenReceptors(receptors);
+        fmt::format_to(w, "** Receptor Subset ({} of {})\n", opts.receptorSubset.size(), flat.size());
+        for (std::size_t i : opts.receptorSubset) {
+            const auto& r = flat.at(i);
+            fmt::format_to(w, "   EVALCART {: 10.2f} {: 10.2f} {:>6.2f} {:>6.2f} {:>6.2f} {}\n",
+                r.node.x, r.node.y, r.node.zElev, r.node.zHill, r.node.zFlag, r.grpid);
+        }
+    }
     fmt::format_to(w, "RE FINISHED\n\n");
 
     //-------------------------------------------------------------------------
@@ -367,16 +382,21 @@ std::string Scenario::writeInput() const
     auto surfaceHeader = meteorology.surfaceFile.header();
     QDateTime minTime = sofea::utilities::convert<QDateTime>(meteorology.surfaceFile.minTime());
     QDateTime maxTime = sofea::utilities::convert<QDateTime>(meteorology.surfaceFile.maxTime());
+    QDateTime startTime = opts.startTime.isValid() ? opts.startTime : minTime;
+    QDateTime endTime = opts.endTime.isValid() ? opts.endTime : maxTime;
     QString startend;
 
-    if (minTime.isValid() && maxTime.isValid())
-        startend = minTime.toString("yy MM dd") + " " + maxTime.toString("yy MM dd");
+    if (startTime.isValid() && endTime.isValid())
+        startend = startTime.toString("yy MM dd") + " " + endTime.toString("yy MM dd");
+
+    std::string surfacePath = opts.surfaceFile.empty() ? meteorology.surfaceFile.absolutePath() : opts.surfaceFile;
+    std::string upperAirPath = opts.upperAirFile.empty() ? meteorology.upperAirFile.absolutePath() : opts.upperAirFile;
 
     fmt::format_to(w, "ME STARTING\n");
-    fmt::format_to(w, "   SURFFILE \"{}\"\n", meteorology.surfaceFile.absolutePath());
-    fmt::format_to(w, "   PROFFILE \"{}\"\n", meteorology.upperAirFile.absolutePath());
-    fmt::format_to(w, "   SURFDATA {} {}\n", surfaceHeader.sfloc, minTime.date().year());
-    fmt::format_to(w, "   UAIRDATA {} {}\n", surfaceHeader.ualoc, maxTime.date().year());
+    fmt::format_to(w, "   SURFFILE \"{}\"\n", surfacePath);
+    fmt::format_to(w, "   PROFFILE \"{}\"\n", upperAirPath);
+    fmt::format_to(w, "   SURFDATA {} {}\n", surfaceHeader.sfloc, startTime.date().year());
+    fmt::format_to(w, "   UAIRDATA {} {}\n", surfaceHeader.ualoc, endTime.date().year());
     fmt::format_to(w, "   PROFBASE {: 6.1f} METERS\n", meteorology.anemometerHeight);
     fmt::format_to(w, "   STARTEND {}\n", startend.toStdString());
     fmt::format_to(w, "   WDROTATE {: 5.1f}\n", meteorology.windRotation);
@@ -408,20 +428,26 @@ std::string Scenario::writeInput() const
     return fmt::to_string(w);
 }
 
-void Scenario::writeInputFile(const std::string& path) const
+void Scenario::writeInputFile(const std::string& path, const InputOptions& opts) const
 {
     std::ofstream ofs(path);
-    ofs << writeInput();
+    ofs << writeInput(opts);
     ofs.close();
 }
 
-void Scenario::writeFluxFile(const std::string& path) const
+void Scenario::writeFluxFile(const std::string& path, const InputOptions& opts) const
 {
     BOOST_LOG_SCOPED_THREAD_TAG("Source", "Model");
 
     QDateTime minTime = sofea::utilities::convert<QDateTime>(meteorology.surfaceFile.minTime());
     QDateTime maxTime = sofea::utilities::convert<QDateTime>(meteorology.surfaceFile.maxTime());
 
+    // Restrict the time grid to the simulation period.
+    if (opts.startTime.isValid() && opts.startTime > minTime)
+        minTime = opts.startTime;
+    if (opts.endTime.isValid() && opts.endTime < maxTime)
+        maxTime = opts.endTime;
+
     if (!minTime.isValid() || !maxTime.isValid()) {
         BOOST_LOG_TRIVIAL(error) << "Invalid time range";
         return; // FIXME: throw an exception or return error status
@@ -472,17 +498,6 @@ void Scenario::writeFluxFile(const std::string& path) const
         exRefFluxMap[fpw] = exRefFlux;
     }
 
-    // Determine the overall number of sources across source groups.
-    int nsrc = 0;
-    for (const SourceGroupPtr sgptr : sourceGroups)
-        nsrc += sgptr->sources.size();
-
-    // Initialize a vector with application started flag for each source.
-    std::vector<bool> started(nsrc, false);
-
-    // Initialize a vector with position in reference flux vector for each source.
-    std::vector<int> index(nsrc, 0);
-
     // Write the flux profile for all sources. Must be in order of hour, then source.
     for (const auto& kv : grid)
     {
@@ -507,22 +522,18 @@ void Scenario::writeFluxFile(const std::string& path) const
                     BOOST_LOG_TRIVIAL(error) << "Failed to locate source flux profile";
                     return; // FIXME: throw an exception
                 }
-                std::vector<double> exRefFlux = exRefFluxMap.at(s.fluxProfile);
+                const std::vector<double>& exRefFlux = exRefFluxMap.at(s.fluxProfile);
 
                 // Determine the number of hours in the expanded flux profile.
-                int n = exRefFlux.size();
-
-                // Calculate flux.
-                double flux;
-                if (kv.first == s.appStart) {
-                    started[isrc] = true;
-                }
-                if (started[isrc] && index[isrc] < n) {
-                    flux = exRefFlux[index[isrc]] * sf;
-                    index[isrc]++;
-                }
-                else {
-                    flux = 0;
+                qint64 n = exRefFlux.size();
+
+                // Calculate flux. The position in the reference flux profile
+                // is the number of hours since the application started, so the
+                // grid may begin after the application start.
+                double flux = 0;
+                qint64 secs = s.appStart.secsTo(kv.first);
+                if (secs >= 0 && secs % 3600 == 0 && secs / 3600 < n) {
+                    flux = exRefFlux[secs / 3600] * sf;
                 }
 
                 // Write the SO HOUREMIS record and increment source counter.
@@ -539,3 +550,36 @@ void Scenario::writeFluxFile(const std::string& path) const
     return;
 }
 
+std::uint64_t Scenario::estimateMemoryUsage(std::size_t nrec) const
+{
+    // Approximate peak working set of one AERMOD run, based on the largest
+    // arrays allocated in modules.f. Fixed overhead covers the executable,
+    // met data buffers and source parameter arrays.
+
+    const std::uint64_t overhead = 64 * 1024 * 1024;
+
+    std::uint64_t nsrc = 0, ngrp = 1; // SRCGROUP ALL
+    for (const SourceGroupPtr& sgptr : sourceGroups) {
+        if (sgptr->sources.size() == 0)
+            continue;
+        nsrc += sgptr->sources.size();
+        ngrp++;
+    }
+
+    std::uint64_t nave = std::max<std::size_t>(1, averagingPeriods.size());
+    std::uint64_t ntyp = 1;
+    if (aermodDryDeposition)
+        ntyp++;
+    if (aermodWetDeposition)
+        ntyp++;
+    if (aermodDryDeposition && aermodWetDeposition)
+        ntyp++;
+
+    std::uint64_t n = nrec;
+    std::uint64_t bytes = overhead;
+    bytes += n * 128;                     // receptor arrays
+    bytes += n * nsrc * ntyp * 8;         // CHI
+    bytes += n * ngrp * nave * ntyp * 21; // AVEVAL, HIVALU, NHIDAT, HCLMSG
+    bytes += n * ngrp * ntyp * 16;        // ANNVAL, SUMANN
+    return bytes;
+}
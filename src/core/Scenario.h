@@ -16,16 +16,36 @@
 #pragma once
 
 #include <array>
+#include <cstdint>
 #include <map>
 #include <memory>
 #include <string>
 #include <vector>
 
+#include <QDateTime>
+
 #include "core/FluxProfile.h"
 #include "core/Meteorology.h"
 #include "core/Receptor.h"
 #include "core/SourceGroup.h"
 
+// Overrides applied when a scenario is split into several AERMOD runs.
+
+struct InputOptions
+{
+    // Global receptor indices (see flattenReceptors); all receptors if empty.
+    std::vector<std::size_t> receptorSubset;
+
+    // Simulation period; the surface file period if invalid.
+    QDateTime startTime;
+    QDateTime endTime;
+
+    // Meteorological files, e.g. trimmed to the simulation period; the
+    // scenario files if empty.
+    std::string surfaceFile;
+    std::string upperAirFile;
+};
+
 struct Scenario
 {
     Scenario();
@@ -33,9 +53,10 @@ struct Scenario
 
     double areaToHectares(double area) const;
     //void resetSurfaceFileInfo();
-    std::string writeInput() const;
-    void writeInputFile(const std::string& path) const;
-    void writeFluxFile(const std::string& path) const;
+    std::string writeInput(const InputOptions& opts = InputOptions()) const;
+    void writeInputFile(const std::string& path, const InputOptions& opts = InputOptions()) const;
+    void writeFluxFile(const std::string& path, const InputOptions& opts = InputOptions()) const;
+    std::uint64_t estimateMemoryUsage(std::size_t nrec) const;
 
     static const std::map<int, std::string> chemicalMap;
 
@@ -485,6 +485,24 @@ void load(Archive& ar, boost::numeric::ublas::compressed_matrix<T, L, IB, IA, TA
     m.set_filled(filled1, filled2);
 }
 
+// External save function for GridMatrix
+template <class Archive>
+void save(Archive& ar, const GridMatrix& m)
+{
+    // Always archived in compressed form, for compatibility with projects
+    // saved before dense storage was added.
+    save(ar, m.sparse());
+}
+
+// External load function for GridMatrix
+template <class Archive>
+void load(Archive& ar, GridMatrix& m)
+{
+    GridMatrix::SparseMatrix sparse;
+    load(ar, sparse);
+    m = GridMatrix(std::move(sparse));
+}
+
 // Resolve ambiguities with Boost Serialization functions in uBLAS.
 template <class Archive, class T, class ALLOC>
 struct specialize<
@@ -655,10 +673,22 @@ void serialize(Archive& archive, ReceptorNodeGroup& rg, const std::uint32_t vers
     // VERSION HISTORY:
     // -
 
+    // Nodes are archived as a sequence of ReceptorNode, which is identical
+    // to the layout of the former std::set storage.
+
     if (version >= 1) {
         archive(cereal::make_nvp("grpid", rg.grpid),
-                cereal::make_nvp("color", rg.color),
-                cereal::make_nvp("nodes", rg.nodes));
+                cereal::make_nvp("color", rg.color));
+
+        if constexpr (std::is_base_of_v<cereal::detail::InputArchiveBase, Archive>) {
+            std::vector<ReceptorNode> nodes;
+            archive(cereal::make_nvp("nodes", nodes));
+            rg.addNodes(nodes);
+        }
+        else {
+            const std::vector<ReceptorNode> nodes = rg.nodes();
+            archive(cereal::make_nvp("nodes", nodes));
+        }
     }
 }
 
@@ -1014,9 +1044,7 @@ void serialize(Archive& archive, Scenario& s, const std::uint32_t version)
                 if (!sgptr->nodes.empty()) {
                     ReceptorNodeGroup ng;
                     ng.grpid = fmt::format("G{:0=3}DISC", isg);
-                    for (const auto& node : sgptr->nodes) {
-                        ng.nodes.insert(node);
-                    }
+                    ng.addNodes(sgptr->nodes);
                     s.receptors.push_back(ng);
                     sgptr->nodes.clear();
                 }
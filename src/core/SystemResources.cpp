@@ -0,0 +1,285 @@
+// Copyright 2020 Dow, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "core/SystemResources.h"
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <Windows.h>
+#include <Psapi.h>
+#else
+#include <cerrno>
+#include <sched.h>
+#include <signal.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+namespace SystemResources {
+
+#ifdef __linux__
+namespace {
+
+// Read a field from /proc/meminfo, in bytes.
+std::uint64_t meminfo(const std::string& field)
+{
+    std::ifstream ifs("/proc/meminfo");
+    std::string key, unit;
+    std::uint64_t value;
+    while (ifs >> key >> value) {
+        std::getline(ifs, unit);
+        if (key == field + ":")
+            return value * 1024; // kB
+    }
+    return 0;
+}
+
+// Read a "key: value" field from a /proc/<pid> file.
+bool procField(const std::string& path, const std::string& field, std::uint64_t& value)
+{
+    std::ifstream ifs(path);
+    std::string line;
+    while (std::getline(ifs, line)) {
+        if (line.compare(0, field.size() + 1, field + ":") != 0)
+            continue;
+        std::istringstream iss(line.substr(field.size() + 1));
+        return static_cast<bool>(iss >> value);
+    }
+    return false;
+}
+
+} // namespace
+#endif
+
+std::uint64_t totalMemory()
+{
+#if defined(_WIN32)
+    MEMORYSTATUSEX status;
+    status.dwLength = sizeof(status);
+    if (GlobalMemoryStatusEx(&status))
+        return status.ullTotalPhys;
+    return 0;
+#elif defined(__linux__)
+    return meminfo("MemTotal");
+#else
+    long pages = sysconf(_SC_PHYS_PAGES);
+    long pageSize = sysconf(_SC_PAGE_SIZE);
+    if (pages < 0 || pageSize < 0)
+        return 0;
+    return static_cast<std::uint64_t>(pages) * static_cast<std::uint64_t>(pageSize);
+#endif
+}
+
+std::uint64_t availableMemory()
+{
+#if defined(_WIN32)
+    MEMORYSTATUSEX status;
+    status.dwLength = sizeof(status);
+    if (GlobalMemoryStatusEx(&status))
+        return status.ullAvailPhys;
+    return 0;
+#elif defined(__linux__)
+    return meminfo("MemAvailable");
+#else
+    return 0;
+#endif
+}
+
+int processorCount()
+{
+    unsigned int n = std::thread::hardware_concurrency();
+    return n > 0 ? static_cast<int>(n) : 1;
+}
+
+bool setProcessAffinity(std::int64_t pid, int cpu)
+{
+    if (cpu < 0)
+        return false;
+
+#if defined(_WIN32)
+    // Processor groups are not supported; affinity is limited to the first 64 processors.
+    if (cpu >= 64)
+        return false;
+
+    HANDLE handle = OpenProcess(PROCESS_SET_INFORMATION | PROCESS_QUERY_INFORMATION,
+                                FALSE, static_cast<DWORD>(pid));
+    if (handle == nullptr)
+        return false;
+
+    DWORD_PTR mask = static_cast<DWORD_PTR>(1) << cpu;
+    BOOL rc = SetProcessAffinityMask(handle, mask);
+    CloseHandle(handle);
+    return rc != 0;
+#elif defined(__linux__)
+    if (cpu >= CPU_SETSIZE)
+        return false;
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return sched_setaffinity(static_cast<pid_t>(pid), sizeof(set), &set) == 0;
+#else
+    (void)pid;
+    return false;
+#endif
+}
+
+bool processMetrics(std::int64_t pid, ProcessMetrics& metrics)
+{
+#if defined(_WIN32)
+    HANDLE handle = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION | PROCESS_VM_READ,
+                                FALSE, static_cast<DWORD>(pid));
+    if (handle == nullptr)
+        return false;
+
+    // FILETIME values are in 100-nanosecond intervals.
+    auto seconds = [](const FILETIME& ft) {
+        ULARGE_INTEGER t;
+        t.LowPart = ft.dwLowDateTime;
+        t.HighPart = ft.dwHighDateTime;
+        return static_cast<double>(t.QuadPart) * 1e-7;
+    };
+
+    bool ok = true;
+    FILETIME creationTime, exitTime, kernelTime, userTime;
+    if (GetProcessTimes(handle, &creationTime, &exitTime, &kernelTime, &userTime)) {
+        metrics.userTime = seconds(userTime);
+        metrics.systemTime = seconds(kernelTime);
+    }
+    else {
+        ok = false;
+    }
+
+    PROCESS_MEMORY_COUNTERS pmc;
+    if (GetProcessMemoryInfo(handle, &pmc, sizeof(pmc)))
+        metrics.peakMemory = pmc.PeakWorkingSetSize;
+
+    IO_COUNTERS io;
+    if (GetProcessIoCounters(handle, &io)) {
+        metrics.bytesRead = io.ReadTransferCount;
+        metrics.bytesWritten = io.WriteTransferCount;
+    }
+
+    CloseHandle(handle);
+    return ok;
+#elif defined(__linux__)
+    const std::string dir = "/proc/" + std::to_string(pid) + "/";
+
+    // Fields after the command name, which may contain spaces.
+    std::ifstream ifs(dir + "stat");
+    std::string stat;
+    if (!std::getline(ifs, stat))
+        return false;
+    auto pos = stat.rfind(')');
+    if (pos == std::string::npos)
+        return false;
+
+    // utime and stime are fields 14 and 15, in clock ticks.
+    std::istringstream iss(stat.substr(pos + 2));
+    std::string skip;
+    for (int i = 3; i < 14; ++i)
+        iss >> skip;
+    unsigned long long utime, stime;
+    if (!(iss >> utime >> stime))
+        return false;
+
+    double ticks = static_cast<double>(sysconf(_SC_CLK_TCK));
+    metrics.userTime = utime / ticks;
+    metrics.systemTime = stime / ticks;
+
+    std::uint64_t hwm;
+    if (procField(dir + "status", "VmHWM", hwm))
+        metrics.peakMemory = hwm * 1024; // kB
+
+    // Requires the same user; leave zero otherwise.
+    procField(dir + "io", "rchar", metrics.bytesRead);
+    procField(dir + "io", "wchar", metrics.bytesWritten);
+    return true;
+#else
+    (void)pid;
+    (void)metrics;
+    return false;
+#endif
+}
+
+bool processExists(std::int64_t pid)
+{
+#if defined(_WIN32)
+    HANDLE handle = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, static_cast<DWORD>(pid));
+    if (handle == nullptr)
+        return false;
+
+    DWORD exitCode = 0;
+    bool running = GetExitCodeProcess(handle, &exitCode) && exitCode == STILL_ACTIVE;
+    CloseHandle(handle);
+    return running;
+#else
+    // Signal 0 checks for existence only; EPERM means another user's process.
+    return kill(static_cast<pid_t>(pid), 0) == 0 || errno == EPERM;
+#endif
+}
+
+std::shared_ptr<void> retainProcess(std::int64_t pid)
+{
+#if defined(_WIN32)
+    HANDLE handle = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, static_cast<DWORD>(pid));
+    if (handle == nullptr)
+        return nullptr;
+
+    return std::shared_ptr<void>(handle, [](HANDLE h) { CloseHandle(h); });
+#else
+    (void)pid;
+    return nullptr;
+#endif
+}
+
+bool childMetrics(ProcessMetrics& metrics)
+{
+#if defined(_WIN32)
+    (void)metrics;
+    return false;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_CHILDREN, &usage) != 0)
+        return false;
+
+    auto seconds = [](const struct timeval& tv) {
+        return static_cast<double>(tv.tv_sec) + static_cast<double>(tv.tv_usec) * 1e-6;
+    };
+
+    metrics.userTime = seconds(usage.ru_utime);
+    metrics.systemTime = seconds(usage.ru_stime);
+#if defined(__APPLE__)
+    metrics.peakMemory = static_cast<std::uint64_t>(usage.ru_maxrss); // bytes
+#else
+    metrics.peakMemory = static_cast<std::uint64_t>(usage.ru_maxrss) * 1024; // kB
+#endif
+    metrics.bytesRead = static_cast<std::uint64_t>(usage.ru_inblock) * 512;
+    metrics.bytesWritten = static_cast<std::uint64_t>(usage.ru_oublock) * 512;
+    return true;
+#endif
+}
+
+} // namespace SystemResources
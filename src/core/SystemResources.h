@@ -0,0 +1,63 @@
+// Copyright 2020 Dow, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+namespace SystemResources {
+
+// Resource usage of a process since it started.
+struct ProcessMetrics
+{
+    double userTime = 0;          // CPU user time in seconds
+    double systemTime = 0;        // CPU system time in seconds
+    std::uint64_t peakMemory = 0; // peak resident set size in bytes
+    std::uint64_t bytesRead = 0;
+    std::uint64_t bytesWritten = 0;
+};
+
+// Installed physical memory in bytes, or zero if unknown.
+std::uint64_t totalMemory();
+
+// Physical memory available to new processes in bytes, or zero if unknown.
+std::uint64_t availableMemory();
+
+// Number of logical processors.
+int processorCount();
+
+// Restrict a process to a single logical processor.
+bool setProcessAffinity(std::int64_t pid, int cpu);
+
+// Query the resource usage of a running process. Returns false if the
+// process does not exist or cannot be queried.
+bool processMetrics(std::int64_t pid, ProcessMetrics& metrics);
+
+// Check whether a process exists. Outside Windows, a process that has exited
+// but has not been waited for still exists.
+bool processExists(std::int64_t pid);
+
+// Keep a process, and so its resource usage, available to processMetrics
+// after it exits, for as long as the returned handle is held. Windows only;
+// returns nullptr elsewhere.
+std::shared_ptr<void> retainProcess(std::int64_t pid);
+
+// Query the total resource usage of the child processes of this process
+// that have exited and been waited for (getrusage(RUSAGE_CHILDREN)). I/O is
+// counted in blocks of 512 bytes. Returns false on Windows.
+bool childMetrics(ProcessMetrics& metrics);
+
+} // namespace SystemResources
@@ -17,6 +17,7 @@
 
 #include <atomic>
 #include <functional>
+#include <string>
 
 struct TaskControl
 {
@@ -58,6 +59,11 @@ struct TaskControl
         interrupt_ = true;
     }
 
+    void resetInterrupt()
+    {
+        interrupt_ = false;
+    }
+
     bool interruptRequested()
     {
         return interrupt_;
@@ -64,6 +64,17 @@
 // UDUnitsInterface.cpp
 //     BOOST_LOG_TRIVIAL(error) << "udunits2: " << buf;
 
+namespace {
+
+std::string hourString(const boost::posix_time::ptime& t)
+{
+    auto date = t.date();
+    return fmt::format("{:04}-{:02}-{:02} {:02}:00", static_cast<int>(date.year()),
+        static_cast<int>(date.month()), static_cast<int>(date.day()), t.time_of_day().hours());
+}
+
+} // namespace
+
 namespace Validation {
 
 ValidateScenario::ValidateScenario(const Scenario& s)
@@ -83,44 +94,72 @@ ValidateScenario::ValidateScenario(const Scenario& s)
 
 void ValidateScenario::validateMeteorology()
 {
-    /*
     namespace fs = std::filesystem;
 
-    if (s_.surfaceFile.empty()) {
-        BOOST_LOG_TRIVIAL(error) << "Surface file is missing";
-    }
-    else {
-        fs::path path(s_.surfaceFile);
-        try {
-            if (!fs::exists(path) || !fs::is_regular_file(path)) {
-                BOOST_LOG_TRIVIAL(error) << "Surface file does not exist; check path";
-            }
+    const Meteorology& m = s_.meteorology;
+
+    auto checkFile = [](const std::string& path, const std::string& label) {
+        if (path.empty()) {
+            BOOST_LOG_TRIVIAL(error) << label << " is missing";
+            return false;
         }
-        catch (fs::filesystem_error& e) {
-            BOOST_LOG_TRIVIAL(error) << "Surface file error: " << e.what();
+        std::error_code ec;
+        if (!fs::is_regular_file(fs::path(path), ec)) {
+            BOOST_LOG_TRIVIAL(error) << label << " does not exist; check path";
+            return false;
         }
+        return true;
+    };
+
+    bool sfcOk = checkFile(m.surfaceFile.path(), "Surface file");
+    bool uaOk = checkFile(m.upperAirFile.path(), "Upper air file");
+    if (!sfcOk || !uaOk)
+        return;
+
+    auto join = m.join();
+    if (join->surface->empty()) {
+        BOOST_LOG_TRIVIAL(error) << "Surface file contains no valid records";
+        return;
     }
+    if (join->upperAir->empty()) {
+        BOOST_LOG_TRIVIAL(error) << "Upper air file contains no valid records";
+        return;
+    }
+
+    if (!join->ordered)
+        BOOST_LOG_TRIVIAL(error) << "Meteorological records are not in chronological order";
 
-    if (s_.upperAirFile.empty()) {
-        BOOST_LOG_TRIVIAL(error) << "Upper air file is missing";
+    // Check for matching records in upper air file
+    if (join->missingProfiles > 0) {
+        auto it = std::find(join->profile.begin(), join->profile.end(), -1);
+        auto first = join->surface->time(static_cast<std::size_t>(it - join->profile.begin()));
+        BOOST_LOG_TRIVIAL(warning) << fmt::format("Upper air file has no profile for {} surface hours; first missing hour is {}",
+            join->missingProfiles, hourString(first));
     }
-    else {
-        try {
-            fs::path path(s_.upperAirFile);
-            if (!fs::exists(path) || !fs::is_regular_file(path)) {
-                BOOST_LOG_TRIVIAL(error) << "Upper air file does not exist; check path";
-            }
-        }
-        catch (fs::filesystem_error& e) {
-            BOOST_LOG_TRIVIAL(error) << "Upper air file error: " << e.what();
-        }
+    if (join->unmatchedProfiles > 0) {
+        BOOST_LOG_TRIVIAL(warning) << fmt::format("Upper air file contains {} hours not in the surface file",
+            join->unmatchedProfiles);
+    }
+
+    // Check for gaps in the surface file
+    if (!join->gaps.empty()) {
+        std::size_t nhours = 0;
+        for (const auto& gap : join->gaps)
+            nhours += static_cast<std::size_t>(gap.second - gap.first + 1);
+        BOOST_LOG_TRIVIAL(warning) << fmt::format("Surface file has {} gaps totaling {} hours; first gap starts at {}",
+            join->gaps.size(), nhours, hourString(HourIndex::toTime(join->gaps.front().first)));
     }
 
-    // Try to parse file
     // Check for calm/missing hours exceed 10% threshold
-    // Check for matching records in upper air file
+    for (const auto& month : join->months) {
+        double fraction = static_cast<double>(month.calm + month.missing) / static_cast<double>(month.hours);
+        if (fraction > 0.1) {
+            BOOST_LOG_TRIVIAL(warning) << fmt::format("Calm and missing hours exceed 10% in {:04}-{:02} ({:.1f}%: {} calm, {} missing)",
+                month.year, month.month, fraction * 100, month.calm, month.missing);
+        }
+    }
+
     // Check for PROFBASE (anemometer elevation) below source or receptor elevations
-    */
 }
 
 void ValidateScenario::validateFluxProfiles()
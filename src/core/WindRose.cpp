@@ -0,0 +1,96 @@
+// Copyright 2020 Dow, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#include "core/WindRose.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+WindRose::WindRose(std::shared_ptr<const SurfaceData> data, int directionBins,
+                   int speedBins, double speedMin, double speedMax)
+    : data_(std::move(data)),
+      directionAxis_(static_cast<unsigned>(directionBins), 0.0, 360.0),
+      speedAxis_(static_cast<unsigned>(speedBins), speedMin, speedMax)
+{
+    // Direction bins include overflow; speed bins include underflow and overflow.
+    stride_ = speedAxis_.size() + 2;
+    ncells_ = static_cast<std::size_t>((directionAxis_.size() + 1) * stride_);
+    if (ncells_ >= InvalidCell)
+        throw std::invalid_argument("WindRose: too many bins");
+
+    const std::size_t n = data_->size();
+    cell_.resize(n);
+    prefix_.assign((n / BlockSize + 1) * ncells_, 0);
+
+    std::vector<std::uint32_t> running(ncells_, 0);
+    for (std::size_t k = 0; k < n; ++k) {
+        if (k % BlockSize == 0)
+            std::copy(running.begin(), running.end(), prefix_.begin() + (k / BlockSize) * ncells_);
+
+        if (data_->calm(k) || data_->missing(k)) {
+            cell_[k] = InvalidCell;
+            continue;
+        }
+
+        int i = directionAxis_.index(data_->wdir[k]);
+        int j = speedAxis_.index(data_->wspd[k]);
+        auto c = static_cast<std::uint16_t>(i * stride_ + j + 1);
+        cell_[k] = c;
+        running[c]++;
+    }
+
+    if (n % BlockSize == 0)
+        std::copy(running.begin(), running.end(), prefix_.begin() + (n / BlockSize) * ncells_);
+}
+
+void WindRose::accumulate(std::size_t first, std::size_t last, Counts& result) const
+{
+    for (std::size_t k = first; k < last; ++k) {
+        if (cell_[k] != InvalidCell)
+            result.cells[cell_[k]]++;
+    }
+}
+
+WindRose::Counts WindRose::counts(std::size_t first, std::size_t last) const
+{
+    Counts result;
+    result.cells.assign(ncells_, 0);
+    result.stride = stride_;
+
+    last = std::min(last, cell_.size());
+    if (first >= last)
+        return result;
+
+    // Whole blocks inside the range.
+    std::size_t b0 = (first + BlockSize - 1) / BlockSize;
+    std::size_t b1 = last / BlockSize;
+
+    if (b0 >= b1) {
+        accumulate(first, last, result);
+    }
+    else {
+        const std::uint32_t *p0 = prefix_.data() + b0 * ncells_;
+        const std::uint32_t *p1 = prefix_.data() + b1 * ncells_;
+        for (std::size_t c = 0; c < ncells_; ++c)
+            result.cells[c] = p1[c] - p0[c];
+
+        accumulate(first, b0 * BlockSize, result);
+        accumulate(b1 * BlockSize, last, result);
+    }
+
+    for (auto count : result.cells)
+        result.valid += count;
+
+    return result;
+}
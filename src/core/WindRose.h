@@ -0,0 +1,76 @@
+// Copyright 2020 Dow, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <boost/histogram/axis/regular.hpp>
+
+#include "core/Meteorology.h"
+
+// Joint wind direction and wind speed frequencies over a range of surface
+// records. Cumulative bin counts are stored at fixed record intervals, so a
+// range query costs O(bins + BlockSize) regardless of the range length.
+
+class WindRose
+{
+public:
+    using DirectionAxis = boost::histogram::axis::circular<>;
+    using SpeedAxis = boost::histogram::axis::regular<>;
+
+    struct Counts
+    {
+        // Frequency for direction bin i in [0, size] and speed bin j in
+        // [-1, size], including the overflow bins of both axes.
+        std::uint32_t at(int i, int j) const {
+            return cells[static_cast<std::size_t>(i * stride + j + 1)];
+        }
+
+        std::vector<std::uint32_t> cells;
+        std::size_t valid = 0; // non-calm, non-missing records
+        int stride = 0;
+    };
+
+    WindRose(std::shared_ptr<const SurfaceData> data, int directionBins,
+             int speedBins, double speedMin, double speedMax);
+
+    const DirectionAxis& directionAxis() const {
+        return directionAxis_;
+    }
+
+    const SpeedAxis& speedAxis() const {
+        return speedAxis_;
+    }
+
+    // Frequencies for records in [first, last).
+    Counts counts(std::size_t first, std::size_t last) const;
+
+private:
+    static constexpr std::size_t BlockSize = 64;
+    static constexpr std::uint16_t InvalidCell = 0xFFFF;
+
+    void accumulate(std::size_t first, std::size_t last, Counts& result) const;
+
+    std::shared_ptr<const SurfaceData> data_;
+    DirectionAxis directionAxis_;
+    SpeedAxis speedAxis_;
+    int stride_;
+    std::size_t ncells_;
+    std::vector<std::uint16_t> cell_;       // bin per record
+    std::vector<std::uint32_t> prefix_;     // counts before each block
+};
@@ -22,8 +22,10 @@
 #include "AppStyle.h"
 #include "MainWindow.h"
 #include "core/Common.h"
+#include "core/MeteorologyCache.h"
 #include "core/Projection.h"
 #include "core/Raster.h"
+#include "core/RasterCache.h"
 
 int main(int argc, char *argv[])
 {
@@ -77,6 +79,15 @@ int main(int argc, char *argv[])
     Projection::setSearchPath(projDataPath.toStdString());
     Projection::setCacheDirectory(appCachePath.toStdString());
 
+    QString metCachePath = QDir::cleanPath(appCachePath + QDir::separator() + "meteorology");
+    MeteorologyCache::setCacheDirectory(metCachePath.toStdString());
+
+    // Elevation tile cache; the size limit is in megabytes.
+    QString demCachePath = QDir::cleanPath(appCachePath + QDir::separator() + "elevation");
+    demCachePath = settings.value("ElevationCacheDirectory", demCachePath).toString();
+    RasterCache::setCacheDirectory(demCachePath.toStdString());
+    RasterCache::setMaxSize(settings.value("ElevationCacheSize", 1024).toULongLong() << 20);
+
     QString gdalDataPath = QDir::cleanPath(appPath + QDir::separator() + SOFEA_GDAL_DATA_PATH);
     Raster::setConfigOption("GDAL_DATA", gdalDataPath.toStdString());
 
@@ -13,6 +13,7 @@
 // limitations under the License.
 //
 
+#ifdef _WIN32
 #ifndef NOMINMAX
 #define NOMINMAX
 #endif
@@ -22,20 +23,166 @@
 #endif
 
 #include <Windows.h> // DebugActiveProcess
+#else
+#include <signal.h> // kill
+#endif
 
+#include "IPCMessage.h"
 #include "IPCServer.h"
 #include "ProcessModel.h"
+#include "StatusChannel.h"
+#include "analysis/Merge.h"
 #include "core/Common.h"
+#include "core/Decomposition.h"
+#include "core/MeteorologySubset.h"
 #include "core/Scenario.h"
+#include "core/SystemResources.h"
+#include "utilities/DateTimeConversion.h"
 
 #include <QCoreApplication>
 #include <QDebug>
 #include <QDir>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QProcessEnvironment>
+#include <QRegularExpression>
 #include <QTimer>
 #include <QThread>
 
 #include <cmath>
 #include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+#include <boost/log/trivial.hpp>
+#include <boost/log/attributes/scoped_attribute.hpp>
+
+#include <fmt/format.h>
+
+namespace {
+
+// Merge the postfiles of a decomposed job, given in task order. Time
+// segments are stitched for each receptor chunk before the chunks are merged.
+void mergePostfiles(const std::vector<std::string>& inputs,
+                    const std::vector<std::vector<std::size_t>>& chunks,
+                    const std::vector<bool>& networks,
+                    std::size_t nsegs, const std::string& dir, const std::string& output)
+{
+    std::size_t nparts = inputs.size() / nsegs;
+
+    std::vector<std::string> partFiles;
+    if (nsegs > 1) {
+        for (std::size_t c = 0; c < nparts; ++c) {
+            auto first = inputs.begin() + static_cast<std::ptrdiff_t>(c * nsegs);
+            std::vector<std::string> segFiles(first, first + static_cast<std::ptrdiff_t>(nsegs));
+            std::string partFile = output;
+            if (nparts > 1)
+                partFile = (std::filesystem::path(dir) / fmt::format("postfile_part{:0=2}.nc", c + 1)).string();
+            ncpost::merge_time(segFiles, partFile);
+            partFiles.push_back(partFile);
+        }
+    }
+    else {
+        partFiles = inputs;
+    }
+
+    if (nparts > 1) {
+        ncpost::merge_receptors(partFiles, chunks, output, networks);
+
+        // Remove intermediate files.
+        if (nsegs > 1) {
+            std::error_code ec;
+            for (const auto& partFile : partFiles)
+                std::filesystem::remove(partFile, ec);
+        }
+    }
+}
+
+// Write the meteorological files trimmed to the simulation period of opts
+// into dir, and point opts at them. The scenario files are used if the
+// period is not set or the files cannot be written.
+void trimMeteorology(const Scenario& s, InputOptions& opts, const QString& dir, const QString& name)
+{
+    using namespace boost::icl;
+    using boost::posix_time::ptime;
+
+    if (!opts.startTime.isValid() || !opts.endTime.isValid())
+        return;
+
+    MeteorologySubset::HourSet windows;
+    windows += discrete_interval<ptime>::closed(
+        sofea::utilities::convert<ptime>(opts.startTime),
+        sofea::utilities::convert<ptime>(opts.endTime));
+
+    QString sfcPath = QDir::cleanPath(dir + QDir::separator() + name + ".sfc");
+    QString pflPath = QDir::cleanPath(dir + QDir::separator() + name + ".pfl");
+
+    if (MeteorologySubset::writeFiles(s.meteorology, windows, sfcPath.toStdString(), pflPath.toStdString())) {
+        opts.surfaceFile = sfcPath.toStdString();
+        opts.upperAirFile = pflPath.toStdString();
+    }
+    else {
+        BOOST_LOG_TRIVIAL(warning) << "Failed to trim meteorological files; using the original files";
+    }
+}
+
+} // namespace
+
+int ProcessModel::Job::progress() const
+{
+    int sum = 0;
+    for (const auto& task : tasks)
+        sum += task.progress;
+    return sum;
+}
+
+int ProcessModel::Job::maxProgress() const
+{
+    int sum = 0;
+    for (const auto& task : tasks)
+        sum += task.maxProgress;
+    return sum;
+}
+
+bool ProcessModel::Job::isActive() const
+{
+    if (inputs.valid() || merge.valid())
+        return true;
+
+    return std::any_of(tasks.begin(), tasks.end(), [](const Task& task) {
+        return !task.finished;
+    });
+}
+
+bool ProcessModel::Job::hasPendingTasks() const
+{
+    return std::any_of(tasks.begin(), tasks.end(), [](const Task& task) {
+        return task.process == nullptr && !task.finished;
+    });
+}
+
+qint64 ProcessModel::Job::elapsedTime() const
+{
+    return timer.isValid() ? elapsed + timer.elapsed() : elapsed;
+}
+
+SystemResources::ProcessMetrics ProcessModel::Job::metrics() const
+{
+    // Peak memory is the largest of any task; other values are summed.
+    SystemResources::ProcessMetrics sum;
+    for (const auto& task : tasks) {
+        sum.userTime += task.metrics.userTime;
+        sum.systemTime += task.metrics.systemTime;
+        sum.peakMemory = std::max(sum.peakMemory, task.metrics.peakMemory);
+        sum.bytesRead += task.metrics.bytesRead;
+        sum.bytesWritten += task.metrics.bytesWritten;
+    }
+    return sum;
+}
 
 ProcessModel::ProcessModel(QObject *parent)
     : QAbstractTableModel(parent)
@@ -45,13 +192,28 @@ ProcessModel::ProcessModel(QObject *parent)
 
     ipc_ = new IPCServer(this);
 
+    SystemResources::childMetrics(childUsage_);
+
     connect(timer_, &QTimer::timeout, this, &ProcessModel::onTimeout);
-    connect(ipc_, &IPCServer::messageReceived, this, &ProcessModel::onMessageReceived);
+    connect(this, &ProcessModel::inputsPrepared, this, &ProcessModel::onInputsPrepared, Qt::QueuedConnection);
 
+#ifdef _WIN32
     ipc_->start();
+#endif
     timer_->start();
 }
 
+ProcessModel::~ProcessModel()
+{
+    // Input workers signal this object on completion.
+    for (auto& job : data_) {
+        if (job.worker.valid())
+            job.worker.wait();
+    }
+    for (auto& worker : orphanWorkers_)
+        worker.wait();
+}
+
 QString ProcessModel::workingDirectory() const
 {
     return workingDir_;
@@ -62,6 +224,99 @@ void ProcessModel::setWorkingDirectory(const QString& path)
     workingDir_ = path;
 }
 
+int ProcessModel::receptorPartitions() const
+{
+    return receptorPartitions_;
+}
+
+void ProcessModel::setReceptorPartitions(int n)
+{
+    // Applies to jobs started after the change.
+    receptorPartitions_ = std::max(1, n);
+}
+
+int ProcessModel::timeSegments() const
+{
+    return timeSegments_;
+}
+
+void ProcessModel::setTimeSegments(int k)
+{
+    // Applies to jobs started after the change.
+    timeSegments_ = std::max(1, k);
+}
+
+int ProcessModel::segmentOverlap() const
+{
+    return segmentOverlap_;
+}
+
+void ProcessModel::setSegmentOverlap(int days)
+{
+    // Minimum overlap between time segments, e.g. the longest rolling window
+    // used in analysis. The longest averaging period is always included.
+    segmentOverlap_ = std::max(0, days);
+}
+
+bool ProcessModel::narrowPeriod() const
+{
+    return narrowPeriod_;
+}
+
+void ProcessModel::setNarrowPeriod(bool on)
+{
+    // Limit the simulation to the period with emissions, plus the segment
+    // overlap and the longest averaging period. Applies to jobs started
+    // after the change.
+    narrowPeriod_ = on;
+}
+
+bool ProcessModel::trimMetFiles() const
+{
+    return trimMetFiles_;
+}
+
+void ProcessModel::setTrimMetFiles(bool on)
+{
+    // Copy the simulated hours of the meteorological files into the job
+    // directory. Applies to jobs started after the change.
+    trimMetFiles_ = on;
+}
+
+int ProcessModel::maxConcurrency() const
+{
+    return maxConcurrency_ > 0 ? maxConcurrency_ : QThread::idealThreadCount();
+}
+
+void ProcessModel::setMaxConcurrency(int n)
+{
+    // Zero uses the number of logical processors.
+    maxConcurrency_ = std::max(0, n);
+    schedule();
+}
+
+bool ProcessModel::memoryAware() const
+{
+    return memoryAware_;
+}
+
+void ProcessModel::setMemoryAware(bool on)
+{
+    memoryAware_ = on;
+    schedule();
+}
+
+bool ProcessModel::cpuAffinity() const
+{
+    return cpuAffinity_;
+}
+
+void ProcessModel::setCpuAffinity(bool on)
+{
+    // Applies to processes started after the change.
+    cpuAffinity_ = on;
+}
+
 void ProcessModel::addScenario(Scenario *s)
 {
     // Check for duplicates.
@@ -98,7 +353,7 @@ void ProcessModel::removeScenario(Scenario *s)
 
 void ProcessModel::startJob(int row)
 {
-    if (row < 0 || row > rowCount())
+    if (row < 0 || row >= rowCount())
         return;
 
     auto& job = data_.at(static_cast<std::size_t>(row));
@@ -110,11 +365,8 @@ void ProcessModel::startJob(int row)
     }
 
     // Do nothing if the job is already running.
-    if (job.process != nullptr) {
-        auto state = job.process->state();
-        if (state == QProcess::Starting || state == QProcess::Running)
-            return;
-    }
+    if (job.isActive())
+        return;
 
     job.queued = true;
     job.status = "Queued";
@@ -122,61 +374,87 @@ void ProcessModel::startJob(int row)
     auto progressIndex = this->index(row, Column::Progress);
     emit dataChanged(statusIndex, progressIndex);
 
-    startProcess(row);
+    schedule();
 }
 
 void ProcessModel::suspendJob(int row)
 {
-    if (row < 0 || row > rowCount())
+    if (row < 0 || row >= rowCount())
         return;
 
     auto& job = data_.at(static_cast<std::size_t>(row));
 
-    if (job.process != nullptr && job.process->state() == QProcess::Running && !job.paused)
+    if (job.paused)
+        return;
+
+    bool suspended = false;
+    for (auto& task : job.tasks)
     {
-        auto state = job.process->state();
-        if (state != QProcess::Running)
-            return;
+        if (task.process == nullptr || task.process->state() != QProcess::Running)
+            continue;
 
-        DWORD pid = static_cast<DWORD>(job.process->processId());
+#ifdef _WIN32
+        DWORD pid = static_cast<DWORD>(task.process->processId());
         BOOL rc = DebugActiveProcess(pid);
-        if (rc != 0) {
-            job.status = "Paused";
-            job.paused = true;
-            job.elapsed += job.timer.elapsed();
-            job.timer.invalidate();
-            auto statusIndex = this->index(row, Column::Status);
-            auto progressIndex = this->index(row, Column::Progress);
-            emit dataChanged(statusIndex, progressIndex);
-        }
+        if (rc != 0)
+            suspended = true;
+#else
+        if (kill(static_cast<pid_t>(task.process->processId()), SIGSTOP) == 0)
+            suspended = true;
+#endif
+    }
+
+    if (suspended) {
+        job.status = "Paused";
+        job.paused = true;
+        job.elapsed += job.timer.elapsed();
+        job.timer.invalidate();
+        auto statusIndex = this->index(row, Column::Status);
+        auto progressIndex = this->index(row, Column::Progress);
+        emit dataChanged(statusIndex, progressIndex);
     }
 }
 
 void ProcessModel::resumeJob(int row)
 {
-    if (row < 0 || row > rowCount())
+    if (row < 0 || row >= rowCount())
         return;
 
     auto& job = data_.at(static_cast<std::size_t>(row));
 
-    if (job.process != nullptr && job.process->state() == QProcess::Running && job.paused)
+    if (!job.paused)
+        return;
+
+    bool resumed = false;
+    for (auto& task : job.tasks)
     {
-        DWORD pid = static_cast<DWORD>(job.process->processId());
+        if (task.process == nullptr || task.process->state() != QProcess::Running)
+            continue;
+
+#ifdef _WIN32
+        DWORD pid = static_cast<DWORD>(task.process->processId());
         BOOL rc = DebugActiveProcessStop(pid);
-        if (rc != 0) {
-            job.status = "Running";
-            job.paused = false;
-            job.timer.start();
-            auto statusIndex = this->index(row, Column::Status);
-            auto progressIndex = this->index(row, Column::Progress);
-            emit dataChanged(statusIndex, progressIndex);
-        }
+        if (rc != 0)
+            resumed = true;
+#else
+        if (kill(static_cast<pid_t>(task.process->processId()), SIGCONT) == 0)
+            resumed = true;
+#endif
+    }
+
+    if (resumed) {
+        job.status = "Running";
+        job.paused = false;
+        job.timer.start();
+        auto statusIndex = this->index(row, Column::Status);
+        auto progressIndex = this->index(row, Column::Progress);
+        emit dataChanged(statusIndex, progressIndex);
     }
 }
 
 void ProcessModel::stopJob(int row)
 {
-    if (row < 0 || row > rowCount())
+    if (row < 0 || row >= rowCount())
         return;
 
     auto& job = data_.at(static_cast<std::size_t>(row));
@@ -184,15 +462,39 @@ void ProcessModel::stopJob(int row)
     // Remove job from queue to prevent restart on finished() signal.
     job.queued = false;
 
-    if (job.process != nullptr && job.process->state() == QProcess::Running)
+    // Cancel tasks which have not been launched.
+    bool cancelled = false;
+    for (auto& task : job.tasks) {
+        if (task.process == nullptr && !task.finished) {
+            task.finished = true;
+            task.failed = true;
+            cancelled = true;
+        }
+    }
+
+    // Without a live process there is no finished() signal to end the job.
+    bool live = std::any_of(job.tasks.begin(), job.tasks.end(), [](const Task& t) {
+        return t.process != nullptr && t.process->state() != QProcess::NotRunning;
+    });
+
+    if (cancelled && !live) {
+        job.status = "Stopped";
+        finishJob(row);
+        return;
+    }
+
+    for (auto& task : job.tasks)
     {
+        if (task.process == nullptr || task.process->state() != QProcess::Running)
+            continue;
+
         // Console applications on Windows that do not run an event loop,
         // or whose event loop does not handle the WM_CLOSE message, can
         // only be terminated by calling kill().
-        job.process->kill();
+        task.process->kill();
 
         // Wait until finished signal or one second as a precaution.
-        job.process->waitForFinished(1000);
+        task.process->waitForFinished(1000);
     }
 }
 
@@ -205,7 +507,7 @@ int ProcessModel::rowCount(const QModelIndex &parent) const
 int ProcessModel::columnCount(const QModelIndex &parent) const
 {
     Q_UNUSED(parent);
-    return 6;
+    return 13;
 }
 
 QVariant ProcessModel::data(const QModelIndex &index, int role) const
@@ -228,8 +530,7 @@ QVariant ProcessModel::data(const QModelIndex &index, int role) const
         case Column::Started:
             return job.started.isValid() ? job.started.toString("yyyy-MM-dd hh:mm:ss") : QVariant();
         case Column::Elapsed: {
-            auto msec = job.timer.isValid() ? job.elapsed + job.timer.elapsed() :
-                                              job.elapsed;
+            auto msec = job.elapsedTime();
             auto sec = msec / 1000;
             auto min = (sec / 60) % 60;
             auto hr = (sec / 3600);
@@ -240,10 +541,27 @@ QVariant ProcessModel::data(const QModelIndex &index, int role) const
         }
         case Column::Progress:
         {
-            double percent = (double)job.progress / (double)job.maxProgress;
+            int maxProgress = job.maxProgress();
+            if (maxProgress == 0)
+                return 0;
+            double percent = (double)job.progress() / (double)maxProgress;
             int progress = std::clamp<int>(std::lround(percent * 100), 0, 100);
             return progress;
         }
+        case Column::Priority:
+            return job.priority;
+        case Column::InputTime:
+            return job.started.isValid() ? QString::number(job.inputTime / 1000.0, 'f', 1) : QVariant();
+        case Column::UserTime:
+            return job.tasks.empty() ? QVariant() : QString::number(job.metrics().userTime, 'f', 1);
+        case Column::SystemTime:
+            return job.tasks.empty() ? QVariant() : QString::number(job.metrics().systemTime, 'f', 1);
+        case Column::PeakMemory:
+            return job.tasks.empty() ? QVariant() : QString::number(job.metrics().peakMemory / 1048576.0, 'f', 1);
+        case Column::BytesRead:
+            return job.tasks.empty() ? QVariant() : QString::number(job.metrics().bytesRead / 1048576.0, 'f', 1);
+        case Column::BytesWritten:
+            return job.tasks.empty() ? QVariant() : QString::number(job.metrics().bytesWritten / 1048576.0, 'f', 1);
         case Column::Path:
             return job.path;
         default: return QVariant();
@@ -261,6 +579,36 @@ QVariant ProcessModel::data(const QModelIndex &index, int role) const
     return QVariant();
 }
 
+bool ProcessModel::setData(const QModelIndex &index, const QVariant &value, int role)
+{
+    if (!index.isValid() || role != Qt::EditRole)
+        return false;
+
+    if (index.row() >= rowCount() || index.row() < 0)
+        return false;
+
+    auto& job = data_.at(index.row());
+
+    switch (index.column()) {
+    case Column::Status:
+        job.status = value.toString();
+        break;
+    case Column::Priority:
+        job.priority = value.toInt();
+        break;
+    default:
+        return false;
+    }
+
+    emit dataChanged(index, index);
+
+    // Priority changes apply to the jobs and tasks waiting in queue.
+    if (index.column() == Column::Priority)
+        schedule();
+
+    return true;
+}
+
 QVariant ProcessModel::headerData(int section, Qt::Orientation orientation, int role) const
 {
     if (role == Qt::DisplayRole && orientation == Qt::Horizontal) {
@@ -270,6 +618,13 @@ QVariant ProcessModel::headerData(int section, Qt::Orientation orientation, int
         case Column::Started:  return tr("Started");
         case Column::Elapsed:  return tr("Elapsed");
         case Column::Progress: return tr("Progress");
+        case Column::Priority: return tr("Priority");
+        case Column::InputTime:    return tr("Input (s)");
+        case Column::UserTime:     return tr("User CPU (s)");
+        case Column::SystemTime:   return tr("System CPU (s)");
+        case Column::PeakMemory:   return tr("Peak Memory (MB)");
+        case Column::BytesRead:    return tr("Read (MB)");
+        case Column::BytesWritten: return tr("Written (MB)");
         case Column::Path:     return tr("Path");
         default: return QVariant();
         }
@@ -283,6 +638,9 @@ Qt::ItemFlags ProcessModel::flags(const QModelIndex &index) const
     if (!index.isValid())
         return Qt::NoItemFlags;
 
+    if (index.column() == Column::Priority)
+        return QAbstractTableModel::flags(index) | Qt::ItemIsEditable;
+
     return QAbstractTableModel::flags(index);
 }
 
@@ -295,6 +653,9 @@ bool ProcessModel::removeRows(int row, int count, const QModelIndex &)
     for (int i = row; i < row + count; ++i)
         stopJob(i);
 
+    for (int i = row; i < row + count; ++i)
+        releaseJob(data_[i]);
+
     beginRemoveRows(QModelIndex(), row, row + count - 1);
     auto it0 = std::next(data_.begin(), row);
     auto it1 = std::next(it0, count);
@@ -340,30 +701,30 @@ bool ProcessModel::moveRows(const QModelIndex &, int sourceFirst, int count,
     return true;
 }
 
-void ProcessModel::startProcess(int i)
+
+void ProcessModel::prepareJob(int i)
 {
     if (i >= rowCount() || i < 0)
         return;
 
     auto& job = data_.at(static_cast<std::size_t>(i));
 
-    // Keep in queue if the maximum thread count has been reached.
-    int maxThreads = QThread::idealThreadCount();
-    if (maxThreads >= 0 && activeJobs_ >= maxThreads)
-        return;
-
     QDateTime timestamp = QDateTime::currentDateTime();
 
-    job.status = "Initializing";
+    job.status = "Preparing Inputs";
     job.started = timestamp;
     job.timer.start();
     job.elapsed = 0;
-    job.queued = false;
+    releaseJob(job);
+    job.receptorChunks.clear();
+    job.networkReceptors.clear();
+    job.timeSegments.clear();
     emit dataChanged(index(i, 0), index(i, columnCount() - 1));
 
     // Create the output directory.
     auto s = job.scenario;
     if (!s) {
+        job.queued = false;
         job.status = "Scenario Removed";
         auto statusIndex = this->index(i, Column::Status);
         emit dataChanged(statusIndex, statusIndex);
@@ -373,156 +734,590 @@ void ProcessModel::startProcess(int i)
     job.subDir = QString::fromStdString(s->name) + "_" + timestamp.toString("yyyyMMddhhmmsszzz");
     QDir outputDir(workingDir_);
     if (!outputDir.mkdir(job.subDir)) {
-        setData(index(i, Column::Status), processErrorString(QProcess::WriteError));
+        job.queued = false;
+        setData(index(i, Column::Status), processErrorString(QProcess::WriteError), Qt::EditRole);
         return;
     }
 
     job.path = QDir::cleanPath(workingDir_ + QDir::separator() + job.subDir);
 
-    // Generate the input files.
-    QString fluxPath = QDir::cleanPath(job.path + QDir::separator() + "flux.dat");
-    QString inputPath = QDir::cleanPath(job.path + QDir::separator() + "aermod.inp");
-    s->writeFluxFile(fluxPath.toStdString());
-    s->writeInputFile(inputPath.toStdString());
+    // The worker writes from a copy, so the scenario can be edited or
+    // removed while inputs are generated.
+    auto snapshot = std::make_shared<const Scenario>(*s);
+    QString path = job.path;
+    int partitions = receptorPartitions_;
+    int segments = timeSegments_;
+    int overlapDays = segmentOverlap_;
+    bool narrow = narrowPeriod_;
+    bool trim = trimMetFiles_;
+
+    auto promise = std::make_shared<std::promise<Preparation>>();
+    job.inputs = promise->get_future().share();
+    job.worker = std::async(std::launch::async, [=]() {
+        BOOST_LOG_SCOPED_THREAD_TAG("Source", "Model");
+        try {
+            QElapsedTimer inputTimer;
+            inputTimer.start();
+            auto prep = prepareInputs(*snapshot, path, partitions, segments, overlapDays, narrow, trim);
+            prep.inputTime = inputTimer.elapsed();
+            promise->set_value(std::move(prep));
+        }
+        catch (const std::exception& e) {
+            BOOST_LOG_TRIVIAL(error) << "Failed to write input files: " << e.what();
+            promise->set_exception(std::current_exception());
+        }
+        emit inputsPrepared();
+    }).share();
+}
+
+void ProcessModel::releaseJob(Job& job)
+{
+    // The last reference to a future from std::async blocks until the task
+    // completes, so background work is kept until onTimeout finds it ready.
+    if (job.worker.valid())
+        orphanWorkers_.push_back(job.worker);
+    if (job.merge.valid())
+        orphanMerges_.push_back(job.merge);
+    job.worker = std::shared_future<void>();
+    job.merge = std::shared_future<bool>();
+
+    for (auto& task : job.tasks) {
+        if (task.process != nullptr) {
+            task.process->disconnect(this);
+            task.process->deleteLater();
+        }
+    }
+    job.tasks.clear();
+}
+
+ProcessModel::Preparation ProcessModel::prepareInputs(const Scenario& s, const QString& path,
+    int partitions, int segments, int overlapDays, bool narrow, bool trim)
+{
+    Preparation prep;
 
     // Get number of records in surface file for progress calculation.
-    job.maxProgress = s->meteorology.surfaceFile.totalHours();
+    int totalHours = s.meteorology.surfaceFile.totalHours();
+
+    // Overlap must cover the longest averaging period.
+    int overlap = overlapDays * 24;
+    for (int period : s.averagingPeriods)
+        overlap = std::max(overlap, period);
+
+    // Simulation period, optionally narrowed to the emission period.
+    InputOptions base;
+    QDateTime minTime = sofea::utilities::convert<QDateTime>(s.meteorology.surfaceFile.minTime());
+    QDateTime maxTime = sofea::utilities::convert<QDateTime>(s.meteorology.surfaceFile.maxTime());
+    if (narrow) {
+        TimeSegment period = emissionPeriod(s, overlap);
+        if (period.start.isValid() && period.end.isValid()) {
+            minTime = base.startTime = period.start;
+            maxTime = base.endTime = period.end;
+            totalHours = static_cast<int>(minTime.secsTo(maxTime) / 3600 + 1);
+            BOOST_LOG_TRIVIAL(info) << "Simulation period narrowed to "
+                                    << minTime.toString(Qt::ISODate).toStdString() << " - "
+                                    << maxTime.toString(Qt::ISODate).toStdString();
+        }
+        else {
+            BOOST_LOG_TRIVIAL(warning) << "No emissions within the meteorological period; using the full period";
+        }
+    }
+
+    // Partition the receptor domain and the simulation period.
+    if (partitions > 1) {
+        auto flat = flattenReceptors(s.receptors);
+        prep.receptorChunks = partitionReceptors(flat, partitions);
+        for (const auto& r : flat)
+            prep.networkReceptors.push_back(r.network);
+    }
+
+    if (segments > 1)
+        prep.timeSegments = partitionPeriod(minTime, maxTime, segments, overlap);
+
+    std::size_t nparts = std::max<std::size_t>(1, prep.receptorChunks.size());
+    std::size_t nsegs = std::max<std::size_t>(1, prep.timeSegments.size());
+
+    // Generate the input files.
+    if (nparts * nsegs == 1) {
+        QString fluxPath = QDir::cleanPath(path + QDir::separator() + "flux.dat");
+        QString inputPath = QDir::cleanPath(path + QDir::separator() + "aermod.inp");
+        if (trim)
+            trimMeteorology(s, base, path, "aermet");
+        s.writeFluxFile(fluxPath.toStdString(), base);
+        s.writeInputFile(inputPath.toStdString(), base);
+
+        Task task;
+        task.path = path;
+        task.maxProgress = totalHours;
+        task.memory = s.estimateMemoryUsage(receptorCount(s.receptors));
+        prep.tasks.push_back(task);
+        return prep;
+    }
+
+    // Write one hourly emissions file, and optionally one pair of trimmed
+    // meteorological files, per time segment.
+    std::vector<QString> fluxPaths;
+    std::vector<InputOptions> segmentOpts;
+    for (std::size_t t = 0; t < nsegs; ++t) {
+        InputOptions opts = base;
+        QString fluxFile = "flux.dat";
+        QString metFile = "aermet";
+        if (nsegs > 1) {
+            opts.startTime = prep.timeSegments[t].start;
+            opts.endTime = prep.timeSegments[t].end;
+            fluxFile = QString("flux_seg%1.dat").arg(t + 1, 2, 10, QChar('0'));
+            metFile = QString("aermet_seg%1").arg(t + 1, 2, 10, QChar('0'));
+        }
+        if (trim)
+            trimMeteorology(s, opts, path, metFile);
+        QString fluxPath = QDir::cleanPath(path + QDir::separator() + fluxFile);
+        s.writeFluxFile(fluxPath.toStdString(), opts);
+        fluxPaths.push_back(fluxPath);
+        segmentOpts.push_back(opts);
+    }
+
+    // Each combination of receptor chunk and time segment is run in a subdirectory.
+    QDir jobDir(path);
+    for (std::size_t c = 0; c < nparts; ++c) {
+        for (std::size_t t = 0; t < nsegs; ++t) {
+            QString partName = QString("part%1").arg(c + 1, 2, 10, QChar('0'));
+            QString segName = QString("seg%1").arg(t + 1, 2, 10, QChar('0'));
+            QString taskDir = nsegs == 1 ? partName :
+                              nparts == 1 ? segName : partName + "_" + segName;
+
+            if (!jobDir.mkdir(taskDir))
+                throw std::runtime_error("Failed to create directory " + taskDir.toStdString());
+
+            // AERMOD reads the hourly emissions file from the working directory.
+            QString taskPath = QDir::cleanPath(path + QDir::separator() + taskDir);
+            QFile::copy(fluxPaths[t], QDir::cleanPath(taskPath + QDir::separator() + "flux.dat"));
+
+            InputOptions opts = segmentOpts[t];
+            Task task;
+            task.path = taskPath;
+            task.maxProgress = totalHours;
+
+            if (nparts > 1)
+                opts.receptorSubset = prep.receptorChunks[c];
+
+            task.memory = s.estimateMemoryUsage(nparts > 1 ? prep.receptorChunks[c].size()
+                                                           : receptorCount(s.receptors));
+
+            if (nsegs > 1) {
+                const auto& segment = prep.timeSegments[t];
+                task.maxProgress = static_cast<int>(segment.start.secsTo(segment.end) / 3600 + 1);
+            }
+
+            QString inputPath = QDir::cleanPath(taskPath + QDir::separator() + "aermod.inp");
+            s.writeInputFile(inputPath.toStdString(), opts);
+            prep.tasks.push_back(task);
+        }
+    }
+
+    return prep;
+}
+
+void ProcessModel::onInputsPrepared()
+{
+    bool ready = false;
+
+    for (int row = 0; row < rowCount(); ++row) {
+        auto& job = data_[row];
+        if (!job.inputs.valid())
+            continue;
+        if (job.inputs.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            continue;
+
+        auto inputs = job.inputs;
+        job.inputs = std::shared_future<Preparation>();
+
+        try {
+            const auto& prep = inputs.get();
+
+            if (job.queued) {
+                // Tasks are launched by the scheduler.
+                job.tasks = prep.tasks;
+                job.receptorChunks = prep.receptorChunks;
+                job.networkReceptors = prep.networkReceptors;
+                job.timeSegments = prep.timeSegments;
+                job.inputTime = prep.inputTime;
+                job.status = "Ready";
+                ready = true;
+            }
+            else {
+                // Stopped while generating inputs.
+                job.elapsed += job.timer.elapsed();
+                job.timer.invalidate();
+                job.status = "Stopped";
+            }
+        }
+        catch (const std::exception&) {
+            job.elapsed += job.timer.elapsed();
+            job.timer.invalidate();
+            job.status = processErrorString(QProcess::WriteError);
+        }
+
+        job.queued = false;
+
+        auto statusIndex = index(row, Column::Status);
+        emit dataChanged(statusIndex, statusIndex);
+    }
+
+    if (ready)
+        schedule();
+}
+
+void ProcessModel::launchTasks(int row)
+{
+    auto& job = data_.at(static_cast<std::size_t>(row));
 
-    // Create the process.
     QString exePath = QDir::cleanPath(QCoreApplication::applicationDirPath() + QDir::separator() + AERMOD_EXE);
-    job.process = new QProcess(this);
-    job.process->setProgram(exePath);
-    job.process->setWorkingDirectory(job.path);
 
-    connect(job.process, &QProcess::started,
-            this, &ProcessModel::onProcessStarted);
-    connect(job.process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
-            this, &ProcessModel::onProcessFinished);
-    connect(job.process, &QProcess::stateChanged,
-            this, &ProcessModel::onProcessStateChanged);
-    connect(job.process, &QProcess::errorOccurred,
-            this, &ProcessModel::onProcessErrorOccurred);
+    for (auto& task : job.tasks)
+    {
+        if (task.process != nullptr || task.finished)
+            continue;
+
+        // Keep remaining tasks pending until resources are available.
+        if (!canAdmit(task.memory))
+            break;
+
+        if (cpuAffinity_)
+            task.cpu = freeProcessor();
+
+        // Create the process.
+        task.process = new QProcess(this);
+        task.process->setProgram(exePath);
+        task.process->setWorkingDirectory(task.path);
+
+#ifndef _WIN32
+        // Progress and error messages are read from a shared memory ring
+        // where the named pipe is not available. The console is the
+        // fallback; keep gfortran from buffering it when stdout is a pipe.
+        QProcessEnvironment env = QProcessEnvironment::systemEnvironment();
+        env.insert("GFORTRAN_UNBUFFERED_PRECONNECTED", "y");
+        task.channel = StatusChannel::create();
+        if (task.channel)
+            env.insert(IPCMessage::RING_ENV_VAR, QString::fromStdString(task.channel->name()));
+        task.process->setProcessEnvironment(env);
+#endif
+
+        connect(task.process, &QProcess::started,
+                this, &ProcessModel::onProcessStarted);
+        connect(task.process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
+                this, &ProcessModel::onProcessFinished);
+        connect(task.process, &QProcess::stateChanged,
+                this, &ProcessModel::onProcessStateChanged);
+        connect(task.process, &QProcess::errorOccurred,
+                this, &ProcessModel::onProcessErrorOccurred);
+
+        // Start the process.
+        task.process->start();
+    }
+}
+
+void ProcessModel::schedule()
+{
+    // Collect jobs waiting for inputs or resources.
+    std::vector<int> rows;
+    int preparing = 0;
+    for (int row = 0; row < rowCount(); ++row) {
+        const auto& job = data_[row];
+        if (job.inputs.valid()) {
+            preparing++;
+            continue;
+        }
+        if (job.paused)
+            continue;
+        if (job.queued || job.hasPendingTasks())
+            rows.push_back(row);
+    }
+
+    // Higher priority first; ties are broken by queue position.
+    std::stable_sort(rows.begin(), rows.end(), [&](int a, int b) {
+        return data_[a].priority > data_[b].priority;
+    });
+
+    for (int row : rows) {
+        auto& job = data_[row];
+
+        // Inputs are generated ahead of time, independent of free slots.
+        if (job.queued) {
+            if (preparing < maxPreparations_) {
+                prepareJob(row);
+                preparing++;
+            }
+            continue;
+        }
+
+        launchTasks(row);
 
-    // Start the process.
-    job.process->start();
+        // Preserve strict ordering: lower priority jobs must not overtake a
+        // job that could not be admitted.
+        if (job.hasPendingTasks())
+            break;
+    }
+}
+
+void ProcessModel::finishJob(int row)
+{
+    auto& job = data_.at(static_cast<std::size_t>(row));
+
+    bool failed = std::any_of(job.tasks.begin(), job.tasks.end(), [](const Task& task) {
+        return task.failed;
+    });
+
+    if (job.tasks.size() > 1 && !failed)
+    {
+        // Merge the partial postfiles in the background.
+        std::vector<std::string> inputs;
+        for (const auto& task : job.tasks)
+            inputs.push_back(QDir::cleanPath(task.path + QDir::separator() + "postfile.nc").toStdString());
+        std::string output = QDir::cleanPath(job.path + QDir::separator() + "postfile.nc").toStdString();
+        auto chunks = job.receptorChunks;
+        auto networks = job.networkReceptors;
+        std::size_t nsegs = std::max<std::size_t>(1, job.timeSegments.size());
+        std::string dir = job.path.toStdString();
+
+        job.merge = std::async(std::launch::async, [=]() {
+            BOOST_LOG_SCOPED_THREAD_TAG("Source", "Model");
+            try {
+                mergePostfiles(inputs, chunks, networks, nsegs, dir, output);
+                return true;
+            }
+            catch (const std::exception& e) {
+                BOOST_LOG_TRIVIAL(error) << "Failed to merge postfiles: " << e.what();
+                return false;
+            }
+        }).share();
+
+        job.status = "Merging";
+    }
+    else
+    {
+        // Stop the timer.
+        job.elapsed += job.timer.elapsed();
+        job.timer.invalidate();
+
+        if (job.tasks.size() > 1)
+            job.status = "Stopped";
+
+        writeMetricsFile(row);
+    }
+
+    auto statusIndex = index(row, Column::Status);
+    emit dataChanged(statusIndex, statusIndex);
 }
 
 void ProcessModel::onTimeout()
 {
+    // Check for completed postfile merges.
+    for (int row = 0; row < rowCount(); ++row) {
+        auto& job = data_[row];
+        if (!job.merge.valid())
+            continue;
+        if (job.merge.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            continue;
+
+        job.status = job.merge.get() ? "Finished" : "Merge Failed";
+        job.merge = std::shared_future<bool>();
+        job.elapsed += job.timer.elapsed();
+        job.timer.invalidate();
+        writeMetricsFile(row);
+
+        auto statusIndex = index(row, Column::Status);
+        emit dataChanged(statusIndex, statusIndex);
+    }
+
+    // Release background work of removed jobs once it has completed.
+    auto isReady = [](const auto& future) {
+        return future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    };
+    orphanWorkers_.erase(std::remove_if(orphanWorkers_.begin(), orphanWorkers_.end(), isReady),
+                         orphanWorkers_.end());
+    orphanMerges_.erase(std::remove_if(orphanMerges_.begin(), orphanMerges_.end(), isReady),
+                        orphanMerges_.end());
+
+    pollProgress();
+    sampleMetrics();
+
     QModelIndex first = index(0, Column::Elapsed);
-    QModelIndex last = index(rowCount() - 1, Column::Elapsed);
+    QModelIndex last = index(rowCount() - 1, Column::BytesWritten);
     emit dataChanged(first, last);
+
+    // Admit queued work as memory becomes available.
+    schedule();
 }
 
-void ProcessModel::onMessageReceived(quint32 pid, quint32 msg)
+void ProcessModel::pollProgress()
 {
-    auto it = pidToIndex_.find(pid);
-    if (it == pidToIndex_.end())
-        return;
+#ifdef _WIN32
+    // Messages are coalesced between polls; only the latest hour count of
+    // each process is used.
+    auto progress = ipc_->takeProgress();
+#endif
 
-    int row = it->second;
-    auto& job = data_.at(static_cast<std::size_t>(it->second));
+    bool changed = false;
+    for (auto& job : data_) {
+        for (auto& task : job.tasks) {
+            if (task.process == nullptr || task.finished)
+                continue;
+
+#ifdef _WIN32
+            int hours = -1;
+            if (progress.contains(task.pid))
+                hours = static_cast<int>(progress.value(task.pid));
+#else
+            // Console progress is used until the ring carries a message.
+            int hours = -1;
+            if (task.channel) {
+                std::string dir = QDir(workingDir_).relativeFilePath(task.path).toStdString();
+                hours = task.channel->poll(dir);
+            }
+            if (hours >= 0)
+                task.ringProgress = true;
+
+            int consoleHours = readConsoleProgress(task);
+            if (!task.ringProgress)
+                hours = consoleHours;
+#endif
 
-    // Skip update if progress cannot be calculated.
-    if (job.maxProgress == 0)
-        return;
+            // Skip update if progress cannot be calculated.
+            if (hours < 0 || task.maxProgress == 0)
+                continue;
 
-    job.progress = msg;
-    auto progressIndex = index(row, Column::Progress);
-    emit dataChanged(progressIndex, progressIndex);
+            task.progress = hours;
+            changed = true;
+        }
+    }
 
-    updateTotalProgress();
+    if (changed) {
+        QModelIndex first = index(0, Column::Progress);
+        QModelIndex last = index(rowCount() - 1, Column::Progress);
+        emit dataChanged(first, last);
+        updateTotalProgress();
+    }
+}
+
+int ProcessModel::readConsoleProgress(Task& task)
+{
+    // Without the named pipe or the status ring, progress is taken from the
+    // AERMOD console, which reports the start of each day of met data
+    // processed, e.g. "+Now Processing Data For Day No.  32 of 2019". The
+    // hours of all days before the current one are complete.
+    static const QRegularExpression re(R"(Now Processing Data For Day No\.\s*(\d+)\s+of\s+(\d+))");
+
+    task.output.append(task.process->readAllStandardOutput());
+
+    int hours = -1;
+    int start = 0;
+    int end;
+    while ((end = task.output.indexOf('\n', start)) >= 0) {
+        QString line = QString::fromLatin1(task.output.mid(start, end - start));
+        start = end + 1;
+
+        auto match = re.match(line);
+        if (!match.hasMatch())
+            continue;
+
+        QByteArray day = match.captured(1).toLatin1() + '/' + match.captured(2).toLatin1();
+        if (day != task.day) {
+            task.day = day;
+            task.days++;
+        }
+        hours = std::min((task.days - 1) * 24, task.maxProgress);
+    }
+    task.output.remove(0, start);
+
+    return hours;
 }
 
 void ProcessModel::onProcessStarted()
 {
     QProcess *process = qobject_cast<QProcess *>(QObject::sender());
-    auto it = std::find_if(data_.begin(), data_.end(), [&](const auto& job) {
-        return job.process == process;
-    });
-
-    if (it == data_.end())
+    auto [row, task] = findTask(process);
+    if (task == nullptr)
         return;
 
-    int row = static_cast<int>(std::distance(data_.begin(), it));
-
     // Emit progress signal.
     updateTotalProgress();
 
-    // Update the PID maps.
-    qint64 pid = process->processId();
-    pidToIndex_[pid] = row;
-    indexToPid_[row] = pid;
-
     // Send output directory to IPC server for logging.
-    ipc_->addPid(pid, it->subDir.toStdString());
-
-    activeJobs_++;
+    task->pid = process->processId();
+    task->handle = SystemResources::retainProcess(task->pid);
+    QString dir = QDir(workingDir_).relativeFilePath(task->path);
+    ipc_->addPid(task->pid, dir.toStdString());
+
+    if (task->cpu >= 0 && !SystemResources::setProcessAffinity(task->pid, task->cpu)) {
+        BOOST_LOG_SCOPED_THREAD_TAG("Source", "Model");
+        BOOST_LOG_TRIVIAL(warning) << "Failed to set processor affinity for process " << task->pid;
+    }
 }
 
 void ProcessModel::onProcessFinished(int exitCode, QProcess::ExitStatus exitStatus)
 {
     QProcess *process = qobject_cast<QProcess *>(QObject::sender());
-    auto it = std::find_if(data_.begin(), data_.end(), [&](const auto& job) {
-        return job.process == process;
-    });
-
-    if (it == data_.end())
+    auto [row, task] = findTask(process);
+    if (task == nullptr)
         return;
 
-    int row = static_cast<int>(std::distance(data_.begin(), it));
+    task->finished = true;
+    task->failed = (exitStatus != QProcess::NormalExit || exitCode != 0);
 
-    // Stop the timer.
-    it->elapsed += it->timer.elapsed();
-    it->timer.invalidate();
+    // Usage since the last timer sample would be lost otherwise.
+    sampleFinalMetrics(*task);
 
     // Update progress.
-    if (it->maxProgress > 0) {
-        if (process->exitStatus() == QProcess::NormalExit) {
-            it->progress = it->maxProgress;
-            auto progressIndex = index(row, Column::Progress);
-            emit dataChanged(progressIndex, progressIndex);
-        }
-        if (process->exitStatus() == QProcess::CrashExit) {
-            it->progress = 0;
-            auto progressIndex = index(row, Column::Progress);
-            emit dataChanged(progressIndex, progressIndex);
-        }
+    if (task->maxProgress > 0) {
+        task->progress = task->failed ? 0 : task->maxProgress;
+        auto progressIndex = index(row, Column::Progress);
+        emit dataChanged(progressIndex, progressIndex);
     }
 
     // Emit progress signal.
     updateTotalProgress();
 
-    // Update the PID maps.
-    qint64 pid = indexToPid_[row];
-    pidToIndex_.erase(pid);
-    indexToPid_.erase(row);
-    ipc_->removePid(pid);
+    ipc_->removePid(task->pid);
 
-    activeJobs_--;
-
-    // Start the next job in queue.
-    for (auto&& job : data_) {
-        if (job.queued) {
-            startProcess(row);
-            break;
-        }
+    // Log any remaining messages before the channel is released.
+    if (task->channel) {
+        task->channel->poll(QDir(workingDir_).relativeFilePath(task->path).toStdString());
+        task->channel.reset();
     }
+
+    task->output.clear();
+
+    // Stop the timer or merge output once all tasks have finished.
+    auto& job = data_.at(static_cast<std::size_t>(row));
+    bool finished = std::all_of(job.tasks.begin(), job.tasks.end(), [](const Task& t) {
+        return t.finished;
+    });
+
+    if (finished)
+        finishJob(row);
+
+    // Start the next task or job in queue.
+    schedule();
 }
 
 void ProcessModel::onProcessStateChanged(QProcess::ProcessState state)
 {
     QProcess *process = qobject_cast<QProcess *>(QObject::sender());
-    auto it = std::find_if(data_.begin(), data_.end(), [&](const auto& job) {
-        return job.process == process;
-    });
-
-    if (it == data_.end())
+    auto [row, task] = findTask(process);
+    if (task == nullptr)
         return;
 
-    it->status = processStateString(state);
+    auto& job = data_.at(static_cast<std::size_t>(row));
+
+    if (job.tasks.size() == 1) {
+        job.status = processStateString(state);
+    }
+    else if (state != QProcess::NotRunning) {
+        int running = static_cast<int>(std::count_if(job.tasks.begin(), job.tasks.end(), [](const Task& t) {
+            return t.process != nullptr && t.process->state() != QProcess::NotRunning;
+        }));
+        job.status = QString("Running (%1/%2)").arg(running).arg(job.tasks.size());
+    }
 
-    int row = static_cast<int>(std::distance(data_.begin(), it));
     auto statusIndex = index(row, Column::Status);
     emit dataChanged(statusIndex, statusIndex);
 }
@@ -530,32 +1325,251 @@ void ProcessModel::onProcessStateChanged(QProcess::ProcessState state)
 void ProcessModel::onProcessErrorOccurred(QProcess::ProcessError error)
 {
     QProcess *process = qobject_cast<QProcess *>(QObject::sender());
-    auto it = std::find_if(data_.begin(), data_.end(), [&](const auto& job) {
-        return job.process == process;
-    });
-
-    if (it == data_.end())
+    auto [row, task] = findTask(process);
+    if (task == nullptr)
         return;
 
-    it->status = processErrorString(error);
+    auto& job = data_.at(static_cast<std::size_t>(row));
+
+    // The finished() signal is not emitted if the process failed to start.
+    if (error == QProcess::FailedToStart && !task->finished) {
+        task->finished = true;
+        task->failed = true;
+        task->channel.reset();
+        bool finished = std::all_of(job.tasks.begin(), job.tasks.end(), [](const Task& t) {
+            return t.finished;
+        });
+        if (finished)
+            finishJob(row);
+    }
+
+    job.status = processErrorString(error);
 
-    int row = static_cast<int>(std::distance(data_.begin(), it));
     auto statusIndex = index(row, Column::Status);
     emit dataChanged(statusIndex, statusIndex);
+
+    if (error == QProcess::FailedToStart)
+        schedule();
+}
+
+int ProcessModel::activeTaskCount() const
+{
+    int count = 0;
+    for (const auto& job : data_) {
+        for (const auto& task : job.tasks) {
+            if (task.process != nullptr && !task.finished)
+                count++;
+        }
+    }
+    return count;
+}
+
+bool ProcessModel::canAdmit(std::uint64_t memory) const
+{
+    int running = activeTaskCount();
+    if (running >= maxConcurrency())
+        return false;
+
+    // Always admit one task so that oversized jobs still run.
+    if (!memoryAware_ || running == 0)
+        return true;
+
+    std::uint64_t total = SystemResources::totalMemory();
+    std::uint64_t available = SystemResources::availableMemory();
+    if (total == 0)
+        return true;
+
+    // Estimated usage of running tasks, which may not have reached their peak.
+    std::uint64_t committed = 0;
+    for (const auto& job : data_) {
+        for (const auto& task : job.tasks) {
+            if (task.process != nullptr && !task.finished)
+                committed += task.memory;
+        }
+    }
+
+    // Keep a reserve for the application and the operating system.
+    std::uint64_t reserve = total / 10;
+    return committed + memory + reserve <= total &&
+           (available == 0 || memory + reserve <= available);
+}
+
+int ProcessModel::freeProcessor() const
+{
+    int ncpu = SystemResources::processorCount();
+    std::vector<bool> used(static_cast<std::size_t>(std::max(ncpu, 1)), false);
+    for (const auto& job : data_) {
+        for (const auto& task : job.tasks) {
+            if (task.process != nullptr && !task.finished &&
+                task.cpu >= 0 && task.cpu < ncpu)
+                used[task.cpu] = true;
+        }
+    }
+
+    auto it = std::find(used.begin(), used.end(), false);
+    return it != used.end() ? static_cast<int>(std::distance(used.begin(), it)) : -1;
+}
+
+void ProcessModel::sampleMetrics()
+{
+    // Usage is sampled while a process runs, and once more when it exits.
+    for (auto& job : data_) {
+        for (auto& task : job.tasks) {
+            if (task.process == nullptr || task.finished || task.pid == 0)
+                continue;
+            SystemResources::processMetrics(task.pid, task.metrics);
+        }
+    }
+}
+
+void ProcessModel::sampleFinalMetrics(Task& task)
+{
+#ifdef _WIN32
+    // The retained handle keeps the process object after it exits.
+    if (task.handle)
+        SystemResources::processMetrics(task.pid, task.metrics);
+    task.handle.reset();
+#else
+    // The process has already been reaped by QProcess, so its usage is the
+    // increase in the usage of exited children since the last process
+    // finished. QProcess may reap several children before their finished
+    // signals are delivered; the increase belongs to this process only if no
+    // other running task has gone, and the last sample is kept otherwise.
+    // Block I/O is a lower bound of the bytes sampled from /proc.
+    SystemResources::ProcessMetrics usage;
+    if (!SystemResources::childMetrics(usage))
+        return;
+
+    bool exclusive = true;
+    for (const auto& job : data_) {
+        for (const auto& other : job.tasks) {
+            if (&other == &task || other.finished || other.process == nullptr || other.pid == 0)
+                continue;
+            if (!SystemResources::processExists(other.pid))
+                exclusive = false;
+        }
+    }
+
+    if (exclusive) {
+        auto& m = task.metrics;
+        m.userTime = std::max(m.userTime, usage.userTime - childUsage_.userTime);
+        m.systemTime = std::max(m.systemTime, usage.systemTime - childUsage_.systemTime);
+        m.bytesRead = std::max(m.bytesRead, usage.bytesRead - childUsage_.bytesRead);
+        m.bytesWritten = std::max(m.bytesWritten, usage.bytesWritten - childUsage_.bytesWritten);
+
+        // The peak is the largest of any child; an increase is this process.
+        if (usage.peakMemory > childUsage_.peakMemory)
+            m.peakMemory = std::max(m.peakMemory, usage.peakMemory);
+    }
+
+    childUsage_ = usage;
+#endif
+}
+
+void ProcessModel::writeMetricsFile(int row) const
+{
+    const auto& job = data_.at(static_cast<std::size_t>(row));
+    if (job.path.isEmpty())
+        return;
+
+    auto toJson = [](const SystemResources::ProcessMetrics& m, QJsonObject& obj) {
+        obj["userTime"] = m.userTime;
+        obj["systemTime"] = m.systemTime;
+        obj["peakMemory"] = static_cast<double>(m.peakMemory);
+        obj["bytesRead"] = static_cast<double>(m.bytesRead);
+        obj["bytesWritten"] = static_cast<double>(m.bytesWritten);
+    };
+
+    QJsonObject obj;
+    obj["name"] = job.scenario ? QString::fromStdString(job.scenario->name) : QString();
+    obj["status"] = job.status;
+    obj["started"] = job.started.toString(Qt::ISODate);
+    obj["elapsed"] = job.elapsedTime() / 1000.0;
+    obj["inputTime"] = job.inputTime / 1000.0;
+    toJson(job.metrics(), obj);
+
+    QJsonArray tasks;
+    for (const auto& task : job.tasks) {
+        QJsonObject taskObj;
+        taskObj["path"] = QDir(job.path).relativeFilePath(task.path);
+        taskObj["failed"] = task.failed;
+        taskObj["estimatedMemory"] = static_cast<double>(task.memory);
+        toJson(task.metrics, taskObj);
+        tasks.append(taskObj);
+    }
+    obj["tasks"] = tasks;
+
+    QFile file(QDir::cleanPath(job.path + QDir::separator() + "job_metrics.json"));
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        BOOST_LOG_SCOPED_THREAD_TAG("Source", "Model");
+        BOOST_LOG_TRIVIAL(warning) << "Failed to write " << file.fileName().toStdString();
+        return;
+    }
+
+    file.write(QJsonDocument(obj).toJson());
+}
+
+bool ProcessModel::exportMetrics(const QString& path) const
+{
+    std::ofstream ofs(path.toStdString());
+    if (!ofs)
+        return false;
+
+    auto quoted = [](const QString& str) {
+        QString escaped = str;
+        escaped.replace("\"", "\"\"");
+        return "\"" + escaped.toStdString() + "\"";
+    };
+
+    ofs << "Name,Status,Started,Elapsed (s),Input (s),User CPU (s),System CPU (s),"
+           "Peak Memory (bytes),Bytes Read,Bytes Written,Processes,Path\n";
+
+    for (const auto& job : data_) {
+        if (!job.started.isValid())
+            continue;
+
+        auto m = job.metrics();
+        QString name = job.scenario ? QString::fromStdString(job.scenario->name) : QString();
+        ofs << quoted(name) << ','
+            << quoted(job.status) << ','
+            << job.started.toString(Qt::ISODate).toStdString() << ','
+            << fmt::format("{:.3f},{:.3f},{:.3f},{:.3f},", job.elapsedTime() / 1000.0,
+                           job.inputTime / 1000.0, m.userTime, m.systemTime)
+            << m.peakMemory << ','
+            << m.bytesRead << ','
+            << m.bytesWritten << ','
+            << job.tasks.size() << ','
+            << quoted(job.path) << '\n';
+    }
+
+    return static_cast<bool>(ofs);
+}
+
+std::pair<int, ProcessModel::Task *> ProcessModel::findTask(const QProcess *process)
+{
+    for (std::size_t row = 0; row < data_.size(); ++row) {
+        for (auto& task : data_[row].tasks) {
+            if (task.process == process)
+                return {static_cast<int>(row), &task};
+        }
+    }
+    return {-1, nullptr};
 }
 
 void ProcessModel::updateTotalProgress()
 {
-    // Calculate aggregate progress for all active jobs.
+    // Calculate aggregate progress for all active tasks.
     int sumProgress = 0, sumMaxProgress = 0;
     for (const auto& job : data_) {
-        if (job.process && job.process->state() == QProcess::Running) {
-            sumProgress += job.progress;
-            sumMaxProgress += job.maxProgress;
+        for (const auto& task : job.tasks) {
+            if (task.process && task.process->state() == QProcess::Running) {
+                sumProgress += task.progress;
+                sumMaxProgress += task.maxProgress;
+            }
         }
     }
 
-    double percent = (double)sumProgress / (double)sumMaxProgress;
+    double percent = sumMaxProgress > 0 ? (double)sumProgress / (double)sumMaxProgress : 0;
     int totalProgress = std::clamp<int>(std::lround(percent * 100), 0, 100);
     emit progressValueChanged(totalProgress);
 }
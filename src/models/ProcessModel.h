@@ -16,17 +16,24 @@
 #pragma once
 
 #include <QAbstractTableModel>
+#include <QByteArray>
 #include <QDateTime>
 #include <QElapsedTimer>
 #include <QProcess>
 #include <QString>
 #include <QVariant>
 
-#include <map>
+#include <cstdint>
+#include <future>
 #include <memory>
+#include <utility>
 #include <vector>
 
+#include "core/Decomposition.h"
+#include "core/SystemResources.h"
+
 class IPCServer;
+class StatusChannel;
 class Scenario;
 
 QT_BEGIN_NAMESPACE
@@ -39,6 +46,7 @@ class ProcessModel : public QAbstractTableModel
 
 public:
     explicit ProcessModel(QObject *parent = nullptr);
+    ~ProcessModel() override;
 
     enum Column {
         Name,
@@ -46,21 +54,46 @@ public:
         Started,
         Elapsed,
         Progress,
+        Priority,
+        InputTime,
+        UserTime,
+        SystemTime,
+        PeakMemory,
+        BytesRead,
+        BytesWritten,
         Path
     };
 
     QString workingDirectory() const;
     void setWorkingDirectory(const QString& path);
+    int receptorPartitions() const;
+    void setReceptorPartitions(int n);
+    int timeSegments() const;
+    void setTimeSegments(int k);
+    int segmentOverlap() const;
+    void setSegmentOverlap(int days);
+    bool narrowPeriod() const;
+    void setNarrowPeriod(bool on);
+    bool trimMetFiles() const;
+    void setTrimMetFiles(bool on);
+    int maxConcurrency() const;
+    void setMaxConcurrency(int n);
+    bool memoryAware() const;
+    void setMemoryAware(bool on);
+    bool cpuAffinity() const;
+    void setCpuAffinity(bool on);
     void addScenario(Scenario *s);
     void removeScenario(Scenario *s);
     void startJob(int row);
     void suspendJob(int row);
     void resumeJob(int row);
     void stopJob(int row);
+    bool exportMetrics(const QString& path) const;
 
     int rowCount(const QModelIndex &parent = QModelIndex()) const override;
     int columnCount(const QModelIndex &parent = QModelIndex()) const override;
     QVariant data(const QModelIndex &index, int role) const override;
+    bool setData(const QModelIndex &index, const QVariant &value, int role) override;
     QVariant headerData(int section, Qt::Orientation orientation, int role) const override;
     Qt::ItemFlags flags(const QModelIndex &index) const override;
     bool removeRows(int row, int count, const QModelIndex &index = QModelIndex()) override;
@@ -69,41 +102,114 @@ public:
 
 signals:
     void progressValueChanged(int value);
+    void inputsPrepared();
 
 private slots:
-    void startProcess(int row);
+    void onInputsPrepared();
     void onTimeout();
-    void onMessageReceived(quint32 pid, quint32 msg);
     void onProcessStarted();
     void onProcessFinished(int exitCode, QProcess::ExitStatus exitStatus);
     void onProcessStateChanged(QProcess::ProcessState state);
     void onProcessErrorOccurred(QProcess::ProcessError error);
 
 private:
+    // A job runs one or more AERMOD processes (tasks). When the receptor
+    // domain or the simulation period is partitioned, each task writes its
+    // own postfile, and these are merged into the job directory once all
+    // tasks have finished. Tasks are ordered by receptor chunk, then by
+    // time segment.
+
+    struct Task {
+        QProcess *process = nullptr;
+        QString path;
+        qint64 pid = 0;
+        int progress = 0;
+        int maxProgress = 0;
+        bool finished = false;
+        bool failed = false;
+        std::uint64_t memory = 0; // estimated peak memory
+        int cpu = -1;             // processor affinity
+        SystemResources::ProcessMetrics metrics;
+        std::shared_ptr<void> handle; // keeps metrics after exit (Windows)
+        std::shared_ptr<StatusChannel> channel; // Linux only
+        bool ringProgress = false; // progress received from the channel
+        QByteArray output;        // unparsed console output
+        QByteArray day;           // day being processed
+        int days = 0;             // days started
+    };
+
+    // Input files and tasks generated by a worker thread.
+    struct Preparation {
+        std::vector<Task> tasks;
+        std::vector<std::vector<std::size_t>> receptorChunks;
+        std::vector<bool> networkReceptors;
+        std::vector<TimeSegment> timeSegments;
+        qint64 inputTime = 0; // msec
+    };
+
     struct Job {
         Scenario *scenario = nullptr;
-        QProcess *process = nullptr;
         QString status;
         QString subDir;
         QString path;
         QDateTime started;
         QElapsedTimer timer;
         qint64 elapsed = 0;
+        qint64 inputTime = 0; // msec
         bool queued = false;
         bool paused = false;
-        int progress = 0;
-        int maxProgress = 0;
+        int priority = 0;
+        std::vector<Task> tasks;
+        std::vector<std::vector<std::size_t>> receptorChunks;
+        std::vector<bool> networkReceptors;
+        std::vector<TimeSegment> timeSegments;
+        std::shared_future<Preparation> inputs;
+        std::shared_future<void> worker;
+        std::shared_future<bool> merge;
+
+        int progress() const;
+        int maxProgress() const;
+        bool isActive() const;
+        bool hasPendingTasks() const;
+        qint64 elapsedTime() const;
+        SystemResources::ProcessMetrics metrics() const;
     };
 
+    void prepareJob(int row);
+    void releaseJob(Job& job);
+    static Preparation prepareInputs(const Scenario& s, const QString& path,
+                                     int partitions, int segments, int overlapDays,
+                                     bool narrow, bool trim);
+    void schedule();
+    void launchTasks(int row);
+    void finishJob(int row);
+    bool canAdmit(std::uint64_t memory) const;
+    int activeTaskCount() const;
+    int freeProcessor() const;
+    void pollProgress();
+    static int readConsoleProgress(Task& task);
+    void sampleMetrics();
+    void sampleFinalMetrics(Task& task);
+    void writeMetricsFile(int row) const;
+    std::pair<int, Task *> findTask(const QProcess *process);
     void updateTotalProgress();
     static QString processStateString(const QProcess::ProcessState state);
     static QString processErrorString(const QProcess::ProcessError error);
 
-    int activeJobs_ = 0;
+    int receptorPartitions_ = 1;
+    int timeSegments_ = 1;
+    int segmentOverlap_ = 0;
+    bool narrowPeriod_ = false;
+    bool trimMetFiles_ = false;
+    int maxConcurrency_ = 0;
+    bool memoryAware_ = true;
+    bool cpuAffinity_ = false;
+    int maxPreparations_ = 2;
     QTimer *timer_;
     IPCServer *ipc_;
+    SystemResources::ProcessMetrics childUsage_; // of exited children
     QString workingDir_;
     std::vector<Job> data_;
-    std::map<qint64, int> pidToIndex_;
-    std::map<int, qint64> indexToPid_;
+    std::vector<std::shared_future<void>> orphanWorkers_;
+    std::vector<std::shared_future<bool>> orphanMerges_;
 };
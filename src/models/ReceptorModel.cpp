@@ -75,19 +75,15 @@ void ReceptorModel::addReceptor(const QModelIndex& parent, const ReceptorNode& n
     ReceptorNodeGroup& group = boost::get<ReceptorNodeGroup>(variant);
 
     // Do nothing if node already exists.
-    auto it = group.nodes.find(node);
-    if (it != group.nodes.end())
+    if (group.findNode(node.x, node.y) >= 0)
         return;
 
     // Determine where the node will be inserted.
-    int row = rowCount(parent);
-    auto lower = group.nodes.lower_bound(node);
-    if (lower != group.nodes.end())
-        row = static_cast<int>(std::distance(group.nodes.begin(), lower));
+    int row = static_cast<int>(group.lowerBound(node.x, node.y));
 
     // Insert the new node.
     beginInsertRows(parent, row, row);
-    group.nodes.emplace_hint(lower, node);
+    group.addNode(node);
     endInsertRows();
 }
 
@@ -165,6 +161,28 @@ void ReceptorModel::updateZFlag(const QModelIndex& index, double zFlag)
     emit dataChanged(zFlagIndex, zFlagIndex);
 }
 
+bool ReceptorModel::updateElevations(const QModelIndex& index, const std::vector<double>& zElev, const std::vector<double>& zHill,
+                                     const std::vector<double>& zFlag)
+{
+    // Replaces the elevations of every receptor in the group, with a single
+    // notification for the affected range.
+    if (!index.isValid() || index.internalId() != 0)
+        return false;
+
+    ReceptorGroup& group = groupFromIndex(index);
+    if (!boost::apply_visitor(SetReceptorGroupElevations(zElev, zHill, zFlag), group))
+        return false;
+
+    int n = rowCount(index);
+    if (n > 0) {
+        QModelIndex topLeft = this->index(0, Column::Z, index);
+        QModelIndex bottomRight = this->index(n - 1, zFlag.empty() ? Column::ZHill : Column::ZFlag, index);
+        emit dataChanged(topLeft, bottomRight);
+    }
+
+    return true;
+}
+
 ReceptorGroup& ReceptorModel::groupFromIndex(const QModelIndex& index)
 {
     int groupIndex = (index.internalId() == 0) ?
@@ -52,6 +52,8 @@ public:
     void updateZElev(const QModelIndex& index, double zElev);
     void updateZHill(const QModelIndex& index, double zHill);
     void updateZFlag(const QModelIndex& index, double zFlag);
+    bool updateElevations(const QModelIndex& index, const std::vector<double>& zElev, const std::vector<double>& zHill,
+                          const std::vector<double>& zFlag = {});
     ReceptorGroup& groupFromIndex(const QModelIndex& index);
 
     QModelIndex index(int row, int column, const QModelIndex& parent = QModelIndex()) const override;
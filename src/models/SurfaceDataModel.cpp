@@ -0,0 +1,309 @@
+// Copyright 2020 Dow, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#include "SurfaceDataModel.h"
+#include "core/Meteorology.h"
+#include "utilities/DateTimeConversion.h"
+
+#include <algorithm>
+#include <numeric>
+
+#include <QString>
+
+namespace {
+
+template <typename T>
+void sortIndices(std::vector<std::uint32_t>& order, const std::vector<T>& values)
+{
+    std::stable_sort(order.begin(), order.end(), [&values](std::uint32_t a, std::uint32_t b) {
+        return values[a] < values[b];
+    });
+}
+
+} // namespace
+
+SurfaceDataModel::SurfaceDataModel(QObject *parent)
+    : QAbstractTableModel(parent)
+{}
+
+void SurfaceDataModel::setSurfaceData(std::shared_ptr<const SurfaceData> data)
+{
+    data_ = std::move(data);
+    for (auto& order : orders_)
+        order.clear();
+
+    first_ = 0;
+    last_ = data_ ? data_->size() : 0;
+    rebuild();
+}
+
+void SurfaceDataModel::setFilter(Filter filter)
+{
+    if (filter == filter_)
+        return;
+
+    filter_ = filter;
+    refilter();
+}
+
+void SurfaceDataModel::setRecordRange(std::size_t first, std::size_t last)
+{
+    std::size_t n = data_ ? data_->size() : 0;
+    last = std::min(last, n);
+    first = std::min(first, last);
+    if (first == first_ && last == last_)
+        return;
+
+    first_ = first;
+    last_ = last;
+    refilter();
+}
+
+std::size_t SurfaceDataModel::recordIndex(int row) const
+{
+    return rows_.at(row);
+}
+
+std::size_t SurfaceDataModel::filteredCount() const
+{
+    return rows_.size();
+}
+
+bool SurfaceDataModel::accept(std::size_t i) const
+{
+    if (i < first_ || i >= last_)
+        return false;
+
+    switch (filter_) {
+    case ValidHours:   return !data_->calm(i) && !data_->missing(i);
+    case CalmHours:    return data_->calm(i);
+    case MissingHours: return data_->missing(i);
+    default:           return true;
+    }
+}
+
+const std::vector<std::uint32_t>& SurfaceDataModel::ascendingOrder(int column)
+{
+    // Permutations are computed once per column and reused for both sort
+    // orders and for every filter.
+    auto& order = orders_[column];
+    if (!order.empty() || !data_ || data_->empty())
+        return order;
+
+    order.resize(data_->size());
+    std::iota(order.begin(), order.end(), 0);
+
+    switch (column) {
+    case Time:               sortIndices(order, data_->hour); break;
+    case WindSpeed:          sortIndices(order, data_->wspd); break;
+    case WindDirection:      sortIndices(order, data_->wdir); break;
+    case Temperature:        sortIndices(order, data_->t);    break;
+    case MoninObukhovLength: sortIndices(order, data_->mol);  break;
+    case Status:             sortIndices(order, data_->flags); break;
+    default: break;
+    }
+
+    return order;
+}
+
+void SurfaceDataModel::filterRows(std::vector<std::uint32_t>& rows)
+{
+    rows.clear();
+    if (!data_ || data_->empty())
+        return;
+
+    // Records are in time order, so only the record range is visited when
+    // unsorted or sorted by time. Other orders are filtered in full.
+    if (sortColumn_ < 0 || (sortColumn_ == Time && sortOrder_ == Qt::AscendingOrder)) {
+        for (std::size_t i = first_; i < last_; ++i) {
+            if (accept(i))
+                rows.push_back(static_cast<std::uint32_t>(i));
+        }
+        return;
+    }
+
+    if (sortColumn_ == Time) {
+        for (std::size_t i = last_; i-- > first_;) {
+            if (accept(i))
+                rows.push_back(static_cast<std::uint32_t>(i));
+        }
+        return;
+    }
+
+    const auto& order = ascendingOrder(sortColumn_);
+    auto append = [this, &rows](std::uint32_t i) {
+        if (accept(i))
+            rows.push_back(i);
+    };
+    if (sortOrder_ == Qt::AscendingOrder)
+        std::for_each(order.begin(), order.end(), append);
+    else
+        std::for_each(order.rbegin(), order.rend(), append);
+}
+
+void SurfaceDataModel::rebuild()
+{
+    beginResetModel();
+
+    filterRows(rows_);
+    loaded_ = static_cast<int>(std::min<std::size_t>(rows_.size(), BatchSize));
+
+    endResetModel();
+}
+
+void SurfaceDataModel::refilter()
+{
+    // The sort order is unchanged, so the loaded rows are updated in place
+    // and rows are only inserted or removed at the end, without a reset.
+    std::vector<std::uint32_t> rows;
+    filterRows(rows);
+    const int loaded = static_cast<int>(std::min<std::size_t>(rows.size(), std::max(loaded_, BatchSize)));
+
+    if (loaded < loaded_) {
+        beginRemoveRows(QModelIndex(), loaded, loaded_ - 1);
+        rows_ = std::move(rows);
+        loaded_ = loaded;
+        endRemoveRows();
+    }
+    else if (loaded > loaded_) {
+        beginInsertRows(QModelIndex(), loaded_, loaded - 1);
+        rows_ = std::move(rows);
+        loaded_ = loaded;
+        endInsertRows();
+    }
+    else {
+        rows_ = std::move(rows);
+    }
+
+    if (loaded_ > 0)
+        emit dataChanged(index(0, 0), index(loaded_ - 1, ColumnCount - 1));
+}
+
+int SurfaceDataModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.isValid())
+        return 0;
+
+    return loaded_;
+}
+
+int SurfaceDataModel::columnCount(const QModelIndex &parent) const
+{
+    if (parent.isValid())
+        return 0;
+
+    return ColumnCount;
+}
+
+QVariant SurfaceDataModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= loaded_)
+        return QVariant();
+
+    const std::size_t i = rows_[index.row()];
+
+    if (role == Qt::DisplayRole) {
+        switch (index.column()) {
+        case Time:
+            return sofea::utilities::convert<QDateTime>(data_->time(i))
+                .toString("yyyy-MM-dd HH:mm");
+        case WindSpeed:
+            return QString::number(data_->wspd[i], 'f', 2);
+        case WindDirection:
+            return QString::number(data_->wdir[i], 'f', 1);
+        case Temperature:
+            return QString::number(data_->t[i], 'f', 1);
+        case MoninObukhovLength:
+            return QString::number(data_->mol[i], 'f', 1);
+        case Status:
+            if (data_->calm(i))
+                return tr("Calm");
+            if (data_->missing(i))
+                return tr("Missing");
+            return QVariant();
+        default:
+            return QVariant();
+        }
+    }
+    else if (role == Qt::TextAlignmentRole) {
+        switch (index.column()) {
+        case Time:
+        case Status:
+            return int(Qt::AlignLeft | Qt::AlignVCenter);
+        default:
+            return int(Qt::AlignRight | Qt::AlignVCenter);
+        }
+    }
+
+    return QVariant();
+}
+
+QVariant SurfaceDataModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole)
+        return QAbstractTableModel::headerData(section, orientation, role);
+
+    switch (section) {
+    case Time:               return tr("Time");
+    case WindSpeed:          return tr("Wind Speed (m/s)");
+    case WindDirection:      return tr("Wind Direction (\u00b0)");
+    case Temperature:        return tr("Temperature (K)");
+    case MoninObukhovLength: return tr("M-O Length (m)");
+    case Status:             return tr("Status");
+    default:                 return QVariant();
+    }
+}
+
+Qt::ItemFlags SurfaceDataModel::flags(const QModelIndex &index) const
+{
+    if (!index.isValid())
+        return Qt::NoItemFlags;
+
+    return Qt::ItemIsEnabled | Qt::ItemIsSelectable;
+}
+
+void SurfaceDataModel::sort(int column, Qt::SortOrder order)
+{
+    if (column < 0 || column >= ColumnCount)
+        column = -1;
+    if (column == sortColumn_ && order == sortOrder_)
+        return;
+
+    sortColumn_ = column;
+    sortOrder_ = order;
+    rebuild();
+}
+
+bool SurfaceDataModel::canFetchMore(const QModelIndex &parent) const
+{
+    if (parent.isValid())
+        return false;
+
+    return static_cast<std::size_t>(loaded_) < rows_.size();
+}
+
+void SurfaceDataModel::fetchMore(const QModelIndex &parent)
+{
+    if (parent.isValid())
+        return;
+
+    const int remaining = static_cast<int>(rows_.size()) - loaded_;
+    const int count = std::min(remaining, BatchSize);
+    if (count <= 0)
+        return;
+
+    beginInsertRows(QModelIndex(), loaded_, loaded_ + count - 1);
+    loaded_ += count;
+    endInsertRows();
+}
@@ -0,0 +1,88 @@
+// Copyright 2020 Dow, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <QAbstractTableModel>
+#include <QVariant>
+
+struct SurfaceData;
+
+// Read-only table of surface records backed by a columnar store. Cells are
+// formatted on demand, sorting and filtering are applied to a permutation of
+// record indices, and rows are exposed to views in batches via fetchMore().
+class SurfaceDataModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    explicit SurfaceDataModel(QObject *parent = nullptr);
+
+    enum Column {
+        Time,
+        WindSpeed,
+        WindDirection,
+        Temperature,
+        MoninObukhovLength,
+        Status,
+        ColumnCount
+    };
+
+    enum Filter {
+        AllHours,
+        ValidHours,
+        CalmHours,
+        MissingHours
+    };
+
+    void setSurfaceData(std::shared_ptr<const SurfaceData> data);
+    void setFilter(Filter filter);
+    void setRecordRange(std::size_t first, std::size_t last);
+    std::size_t recordIndex(int row) const;
+    std::size_t filteredCount() const;
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role) const override;
+    Qt::ItemFlags flags(const QModelIndex &index) const override;
+    void sort(int column, Qt::SortOrder order = Qt::AscendingOrder) override;
+    bool canFetchMore(const QModelIndex &parent) const override;
+    void fetchMore(const QModelIndex &parent) override;
+
+private:
+    static constexpr int BatchSize = 1000;
+
+    bool accept(std::size_t i) const;
+    const std::vector<std::uint32_t>& ascendingOrder(int column);
+    void filterRows(std::vector<std::uint32_t>& rows);
+    void rebuild();
+    void refilter();
+
+    std::shared_ptr<const SurfaceData> data_;
+    std::array<std::vector<std::uint32_t>, ColumnCount> orders_;
+    std::vector<std::uint32_t> rows_;
+    int loaded_ = 0;
+
+    Filter filter_ = AllHours;
+    std::size_t first_ = 0;
+    std::size_t last_ = 0;
+    int sortColumn_ = -1;
+    Qt::SortOrder sortOrder_ = Qt::AscendingOrder;
+};